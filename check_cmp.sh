@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Runs the comparison and thread safety tools, which exit with a
+# nonzero status when the differences exceed their thresholds. Run
+# after compile.sh, which installs the binaries under bin/; the
+# Debug branch of compile.sh also turns on -Wextra -Wshadow.
+
+bindir=${bindir:-$(pwd)/bin}
+
+workdir=$(mktemp -d)
+trap "rm -rf ${workdir}" EXIT
+
+nfail=0
+# Runs a tool, printing its output and whether it passed
+check() {
+    name=$1
+    shift
+    (cd ${workdir} && ${bindir}/${name} "$@" > ${workdir}/${name}.out 2>&1)
+    status=$?
+    cat ${workdir}/${name}.out
+    if [[ ${status} -ne 0 ]]; then
+        echo "${name}: FAILED"
+        nfail=$((nfail+1))
+    else
+        echo "${name}: passed"
+    fi
+    echo
+}
+
+check legendre_cmp
+check polynomial_cmp
+check atomic_erfc_cmp
+check atomic_banded_cmp
+check atomic_threadtest
+# Open shell densities with the singly occupied alpha orbital in pi and delta
+check diatomic_dftcmp --mocc=1
+check diatomic_dftcmp --mocc=2
+
+echo "${nfail} checks failed"
+exit ${nfail}
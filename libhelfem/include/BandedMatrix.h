@@ -0,0 +1,95 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#ifndef BANDED_BANDEDMATRIX_H
+#define BANDED_BANDEDMATRIX_H
+
+#include <armadillo>
+
+namespace helfem {
+  namespace banded {
+    /**
+     * Symmetric banded matrix, such as the radial matrices of a
+     * finite element basis, in which functions only couple within
+     * an element. Only the lower band is stored, in the LAPACK
+     * layout: element (i,j) with j <= i <= j+kd is stored at
+     * (i-j, j) of a (kd+1) x N array.
+     */
+    class BandedMatrix {
+      /// Size of the matrix
+      size_t N;
+      /// Number of subdiagonals
+      size_t kd;
+      /// Lower band storage
+      arma::mat ab;
+
+    public:
+      /// Dummy constructor
+      BandedMatrix();
+      /// Constructor for zero matrix
+      BandedMatrix(size_t N, size_t kd);
+      /// Constructor from a dense symmetric matrix; elements outside the band are ignored
+      BandedMatrix(const arma::mat & M, size_t kd);
+      /// Destructor
+      ~BandedMatrix();
+
+      /// Size of the matrix
+      size_t get_N() const;
+      /// Number of subdiagonals
+      size_t get_kd() const;
+      /// Lower band storage
+      const arma::mat & band() const;
+      /// Lower band storage
+      arma::mat & band();
+
+      /// Get element; elements outside the band are zero
+      double operator()(size_t i, size_t j) const;
+      /// Add a dense symmetric block whose first row and column is ofs
+      void add_block(size_t ofs, const arma::mat & blk);
+
+      /// Increment by another matrix of the same shape
+      BandedMatrix & operator+=(const BandedMatrix & rh);
+      /// Scale matrix
+      BandedMatrix & operator*=(double fac);
+
+      /// Get the dense matrix
+      arma::mat dense() const;
+      /// Compute the product with a dense matrix
+      arma::mat multiply(const arma::mat & X) const;
+    };
+
+    /// Sum of matrices of the same shape
+    BandedMatrix operator+(const BandedMatrix & lh, const BandedMatrix & rh);
+    /// Scaled matrix
+    BandedMatrix operator*(double fac, const BandedMatrix & M);
+
+    /// Cholesky decomposition M = L L^T; the lower triangular factor is returned in banded storage
+    BandedMatrix chol(const BandedMatrix & M);
+    /// Solve M X = B given the Cholesky factor of M
+    arma::mat chol_solve(const BandedMatrix & L, const arma::mat & B);
+    /// Solve M X = B for symmetric positive definite M
+    arma::mat solve(const BandedMatrix & M, const arma::mat & B);
+
+    /// Eigendecomposition of a symmetric banded matrix
+    void eig_sym(arma::vec & E, arma::mat & C, const BandedMatrix & M);
+    /// Generalized eigendecomposition F C = S C E with C^T S C = 1
+    void eig_gsym(arma::vec & E, arma::mat & C, const BandedMatrix & F, const BandedMatrix & S);
+
+    /// Form half-inverse of overlap matrix, using either the Cholesky or the symmetric orthogonalization; verbose prints out the condition number
+    arma::mat invh(const BandedMatrix & S, bool chol, bool verbose=true);
+  }
+}
+
+#endif
@@ -16,9 +16,11 @@
 #ifndef ATOMIC_BASIS_RADIALBASIS_H
 #define ATOMIC_BASIS_RADIALBASIS_H
 
+#include "BandedMatrix.h"
 #include "ModelPotential.h"
 #include "PolynomialBasis.h"
 #include <armadillo>
+#include <memory>
 
 namespace helfem {
   namespace atomic {
@@ -30,8 +32,10 @@ namespace helfem {
         /// Quadrature weights
         arma::vec wq;
 
-        /// Polynomial basis
-        const polynomial_basis::PolynomialBasis *poly;
+        /// Polynomial basis, shared between copies
+        std::shared_ptr<const polynomial_basis::PolynomialBasis> poly;
+        /// Element variants of the polynomial basis: interior, first, last, and first and last
+        std::vector<std::shared_ptr<const polynomial_basis::PolynomialBasis> > poly_variants;
         /// Primitive polynomial basis functions evaluated on the quadrature
         /// grid
         arma::mat bf;
@@ -42,12 +46,39 @@ namespace helfem {
         /// Element boundary values
         arma::vec bval;
 
+        /// Products of the primitive basis functions at the quadrature points: <Nq x Nprim^2>
+        arma::mat bf_prod;
+        /// Primitive basis functions at the sub-interval quadrature points of the in-element inner integrals: <Nq^2 x Nprim>
+        arma::mat sub_bf;
+        /// Reference element moment operators of the in-element inner integrals: <Nq x Nprim^2> for powers 0, ..., Lmax
+        std::vector<arma::mat> inner_moments;
+        /// Indices of the element's product functions in the full primitive product basis
+        arma::uvec product_indices(size_t iel) const;
+
+        /// Damping functions of the erfc expansion tabulated at the quadrature points: <(Lmax+1) * Nel>
+        std::vector<arma::mat> erfc_Dtab;
+        /// Range separation parameter of the tabulation
+        double erfc_tab_mu;
+        /// Maximal L of the tabulation
+        int erfc_tab_Lmax;
+
+        /// Basis function values at the quadrature points of each element, including the 1/r factor
+        std::vector<arma::mat> el_bf;
+        /// Basis function derivatives at the quadrature points of each element
+        std::vector<arma::mat> el_df;
+        /// Basis function second derivatives at the quadrature points of each element
+        std::vector<arma::mat> el_lf;
+        /// Radial quadrature weights of each element
+        std::vector<arma::vec> el_wrad;
+        /// Radial quadrature points of each element
+        std::vector<arma::vec> el_r;
+        /// Tabulate the element basis function tables
+        void form_element_tables();
+
         /// Used basis function indices in element
         arma::uvec basis_indices(size_t iel) const;
         /// Get basis functions in element
-        polynomial_basis::PolynomialBasis *
-        get_basis(const polynomial_basis::PolynomialBasis *poly,
-                  size_t iel) const;
+        const polynomial_basis::PolynomialBasis &element_poly(size_t iel) const;
 
       public:
         /// Dummy constructor
@@ -56,13 +87,6 @@ namespace helfem {
         RadialBasis(const polynomial_basis::PolynomialBasis *poly, int n_quad,
                     const arma::vec &bval);
 
-        /// Explicit copy constructor because of shared pointer
-        RadialBasis(const RadialBasis &rh);
-        /// Explicit assignment operator because of shared pointer
-        RadialBasis &operator=(const RadialBasis &rh);
-        /// Explicit destructor because of shared pointer
-        ~RadialBasis();
-
         /// Add an element boundary
         void add_boundary(double r);
 
@@ -110,6 +134,14 @@ namespace helfem {
         arma::mat bessel_il_integral(int L, double lambda, size_t iel) const;
         /// Compute Bessel k_L integral
         arma::mat bessel_kl_integral(int L, double lambda, size_t iel) const;
+        /// Compute the radial integrals of all channels, given by the columns of V evaluated at get_r(iel), with a single matrix product
+        std::vector<arma::mat> channel_integrals(const arma::mat &V, size_t iel) const;
+        /// Compute the r^L and r^(-L-1) integrals for L=0, ..., Lmax in one go
+        void multipole_integrals(int Lmax, size_t iel, std::vector<arma::mat> &rL,
+                                 std::vector<arma::mat> &rm1L) const;
+        /// Compute the Bessel i_L and k_L integrals for L=0, ..., Lmax in one go
+        void bessel_integrals(int Lmax, double lambda, size_t iel, std::vector<arma::mat> &iL,
+                              std::vector<arma::mat> &kL) const;
 
         /// Compute overlap matrix in element
         arma::mat overlap(size_t iel) const;
@@ -126,10 +158,31 @@ namespace helfem {
         /// Compute off-center nuclear attraction matrix in element
         arma::mat nuclear_offcenter(size_t iel, double Rhalf, int L) const;
 
+        /// Bandwidth of the assembled radial matrices
+        size_t bandwidth() const;
+        /// Assemble radial matrix from symmetric element matrices
+        banded::BandedMatrix assemble(const std::vector<arma::mat> &elmat) const;
+        /// Assemble radial matrix elements r^n (overlap is n=0, nuclear is n=-1)
+        banded::BandedMatrix radial_integral(int n) const;
+        /// Assemble overlap matrix
+        banded::BandedMatrix overlap() const;
+        /// Assemble primitive kinetic energy matrix (excluding l part)
+        banded::BandedMatrix kinetic() const;
+        /// Assemble l part of kinetic energy matrix
+        banded::BandedMatrix kinetic_l() const;
+        /// Assemble nuclear attraction matrix
+        banded::BandedMatrix nuclear() const;
+        /// Assemble model potential matrix
+        banded::BandedMatrix model_potential(const modelpotential::ModelPotential *nuc) const;
+
+        /// Tabulate the reference element operators of the in-element integrals up to Lmax
+        void tabulate_twoe(int Lmax);
         /// Compute primitive two-electron integral
         arma::mat twoe_integral(int L, size_t iel) const;
         /// Compute primitive Yukawa-screened two-electron integral
         arma::mat yukawa_integral(int L, double lambda, size_t iel) const;
+        /// Tabulate the erfc expansion for all elements up to Lmax; reused by erfc_integral for the same mu
+        void tabulate_erfc(int Lmax, double mu);
         /// Compute primitive complementary error function two-electron integral
         arma::mat erfc_integral(int L, double lambda, size_t iel,
                                 size_t jel) const;
@@ -146,16 +199,16 @@ namespace helfem {
         /// Compute projection
         arma::mat overlap(const RadialBasis &rh) const;
 
-        /// Evaluate basis functions at quadrature points
-        arma::mat get_bf(size_t iel) const;
-        /// Evaluate derivatives of basis functions at quadrature points
-        arma::mat get_df(size_t iel) const;
-        /// Evaluate second derivatives of basis functions at quadrature points
-        arma::mat get_lf(size_t iel) const;
-        /// Get quadrature weights
-        arma::vec get_wrad(size_t iel) const;
-        /// Get r values
-        arma::vec get_r(size_t iel) const;
+        /// Basis functions at quadrature points (tabulated, no copy)
+        const arma::mat & get_bf(size_t iel) const;
+        /// Derivatives of basis functions at quadrature points (tabulated, no copy)
+        const arma::mat & get_df(size_t iel) const;
+        /// Second derivatives of basis functions at quadrature points (tabulated, no copy)
+        const arma::mat & get_lf(size_t iel) const;
+        /// Get quadrature weights (tabulated, no copy)
+        const arma::vec & get_wrad(size_t iel) const;
+        /// Get r values (tabulated, no copy)
+        const arma::vec & get_r(size_t iel) const;
 
         /// Evaluate nuclear density
         double nuclear_density(const arma::mat &P) const;
@@ -21,21 +21,28 @@
 
 #define __HELFEM_VERSION__ "${LIBHELFEM_VERSION}"
 
+/**
+ * Thread safety: libhelfem keeps no mutable global state, and
+ * verbosity is requested per call. Distinct objects can be
+ * constructed and used concurrently from several threads, and the
+ * const member functions of a shared object, such as the integral
+ * routines of RadialBasis, can be called concurrently. Copies of a
+ * RadialBasis share its immutable polynomial basis. Non-const member
+ * functions (add_boundary, tabulate_twoe, tabulate_erfc) must not be
+ * called while the same object is used by another thread.
+ */
 namespace helfem {
   /**
-   * Global boolean indicating whether the library is in verbose or non-verbose
-   * mode. * By default, the library is in the non-verbose mode.
-   *
-   * This variable is not part of the public API. The verbosity should be
-   * enabled or disabled using helfem::set_verbosity.
-   */
-  extern bool verbose;
-
-  /**
-   * Set the global verbosity flag for the libhelfem library.
+   * Formerly set the global verbosity flag of the library. The flag
+   * has been removed to make the library reentrant; verbosity is now
+   * requested per call with the verbose argument of
+   * utils::get_grid, utils::invh and polynomial_basis::get_basis.
+   * This function only remains for source compatibility and does not
+   * affect the output of the library.
    *
-   * @param verbose whether to enable or disable verbosity.
+   * @param verbosity ignored
    */
+  [[deprecated("pass the verbose argument of get_grid, invh and get_basis instead")]]
   void set_verbosity(bool verbosity);
 
   std::string version();
@@ -49,13 +56,39 @@ namespace helfem {
      *        1 for quadratic grid
      *        2 for generalized polynomial grid with exponent zexp
      *        3 for generalized exponential grid with parameter zexp
+     *
+     * If verbose is set, the type of the grid is printed out.
+     */
+    arma::vec get_grid(double rmax, int num_el, int igrid, double zexp, bool verbose=false);
+
+    /**
+     * Calculates the half-inverse of a matrix. If verbose is set, the
+     * smallest eigenvalue and the condition number are printed out.
+     */
+    arma::mat invh(arma::mat S, bool chol, bool verbose=true);
+
+    /**
+     * Largest difference of val from ref relative to the largest
+     * element of ref in absolute value, max|ref-val| / max|ref|. The
+     * difference is absolute if ref is zero, and infinite if the
+     * shapes of the matrices differ.
+     */
+    double max_rel_diff(const arma::mat & ref, const arma::mat & val);
+
+    /**
+     * Largest elementwise relative difference |ref-val| / |ref|, for
+     * quantities that span many orders of magnitude. Elements where
+     * ref is zero, subnormal or not finite, or where val has
+     * underflowed, are skipped; a NaN or infinite val where ref is
+     * finite gives an infinite difference, as do differing shapes.
      */
-    arma::vec get_grid(double rmax, int num_el, int igrid, double zexp);
+    double max_pointwise_rel_diff(const arma::mat & ref, const arma::mat & val);
 
     /**
-     * Calculates the half-inverse of a matrix.
+     * Exit status of a comparison test: prints out a failure message
+     * and returns 1 if fail is set, otherwise returns 0.
      */
-    arma::mat invh(arma::mat S, bool chol);
+    int test_status(bool fail);
   } // namespace utils
 } // namespace helfem
 
@@ -69,8 +102,8 @@ namespace helfem {
 
 namespace helfem {
   namespace polynomial_basis {
-    /// Get the wanted basis
-    PolynomialBasis *get_basis(int primbas, int Nnodes);
+    /// Get the wanted basis; if verbose is set, the basis is described on output
+    PolynomialBasis *get_basis(int primbas, int Nnodes, bool verbose=true);
   } // namespace polynomial_basis
 } // namespace helfem
 
@@ -0,0 +1,317 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "helfem/BandedMatrix.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+// LAPACK routines for banded matrices
+extern "C" {
+  void dpbtrf_(const char *uplo, const arma::blas_int *n, const arma::blas_int *kd, double *ab, const arma::blas_int *ldab, arma::blas_int *info);
+  void dpbtrs_(const char *uplo, const arma::blas_int *n, const arma::blas_int *kd, const arma::blas_int *nrhs, const double *ab, const arma::blas_int *ldab, double *b, const arma::blas_int *ldb, arma::blas_int *info);
+  void dtbtrs_(const char *uplo, const char *trans, const char *diag, const arma::blas_int *n, const arma::blas_int *kd, const arma::blas_int *nrhs, const double *ab, const arma::blas_int *ldab, double *b, const arma::blas_int *ldb, arma::blas_int *info);
+  void dsbevd_(const char *jobz, const char *uplo, const arma::blas_int *n, const arma::blas_int *kd, double *ab, const arma::blas_int *ldab, double *w, double *z, const arma::blas_int *ldz, double *work, const arma::blas_int *lwork, arma::blas_int *iwork, const arma::blas_int *liwork, arma::blas_int *info);
+  void dsbgvd_(const char *jobz, const char *uplo, const arma::blas_int *n, const arma::blas_int *ka, const arma::blas_int *kb, double *ab, const arma::blas_int *ldab, double *bb, const arma::blas_int *ldbb, double *w, double *z, const arma::blas_int *ldz, double *work, const arma::blas_int *lwork, arma::blas_int *iwork, const arma::blas_int *liwork, arma::blas_int *info);
+}
+
+namespace helfem {
+  namespace banded {
+    BandedMatrix::BandedMatrix() : N(0), kd(0) {
+    }
+
+    BandedMatrix::BandedMatrix(size_t N_, size_t kd_) : N(N_), kd(kd_) {
+      ab.zeros(kd+1,N);
+    }
+
+    BandedMatrix::BandedMatrix(const arma::mat & M, size_t kd_) : N(M.n_rows), kd(kd_) {
+      if(M.n_rows != M.n_cols) {
+        std::ostringstream oss;
+        oss << "Matrix is not square: " << M.n_rows << " x " << M.n_cols << "!\n";
+        throw std::logic_error(oss.str());
+      }
+      ab.zeros(kd+1,N);
+      for(size_t j=0;j<N;j++)
+        for(size_t i=j;i<std::min(N,j+kd+1);i++)
+          ab(i-j,j)=M(i,j);
+    }
+
+    BandedMatrix::~BandedMatrix() {
+    }
+
+    size_t BandedMatrix::get_N() const {
+      return N;
+    }
+
+    size_t BandedMatrix::get_kd() const {
+      return kd;
+    }
+
+    const arma::mat & BandedMatrix::band() const {
+      return ab;
+    }
+
+    arma::mat & BandedMatrix::band() {
+      return ab;
+    }
+
+    double BandedMatrix::operator()(size_t i, size_t j) const {
+      if(i<j)
+        std::swap(i,j);
+      if(i-j>kd)
+        return 0.0;
+      return ab(i-j,j);
+    }
+
+    void BandedMatrix::add_block(size_t ofs, const arma::mat & blk) {
+      if(blk.n_rows != blk.n_cols || blk.n_rows > kd+1 || ofs+blk.n_rows > N) {
+        std::ostringstream oss;
+        oss << "Cannot add " << blk.n_rows << " x " << blk.n_cols << " block at " << ofs << " to matrix of size " << N << " with " << kd << " subdiagonals!\n";
+        throw std::logic_error(oss.str());
+      }
+      for(size_t j=0;j<blk.n_cols;j++)
+        for(size_t i=j;i<blk.n_rows;i++)
+          ab(i-j,ofs+j)+=blk(i,j);
+    }
+
+    BandedMatrix & BandedMatrix::operator+=(const BandedMatrix & rh) {
+      if(N != rh.N || kd != rh.kd) {
+        std::ostringstream oss;
+        oss << "Shape mismatch: " << N << " x " << kd << " vs " << rh.N << " x " << rh.kd << "!\n";
+        throw std::logic_error(oss.str());
+      }
+      ab+=rh.ab;
+      return *this;
+    }
+
+    BandedMatrix & BandedMatrix::operator*=(double fac) {
+      ab*=fac;
+      return *this;
+    }
+
+    arma::mat BandedMatrix::dense() const {
+      arma::mat M(N,N);
+      M.zeros();
+      for(size_t j=0;j<N;j++)
+        for(size_t i=j;i<std::min(N,j+kd+1);i++) {
+          M(i,j)=ab(i-j,j);
+          M(j,i)=ab(i-j,j);
+        }
+      return M;
+    }
+
+    arma::mat BandedMatrix::multiply(const arma::mat & X) const {
+      if(X.n_rows != N) {
+        std::ostringstream oss;
+        oss << "Cannot multiply matrix of size " << N << " with " << X.n_rows << " x " << X.n_cols << " matrix!\n";
+        throw std::logic_error(oss.str());
+      }
+      arma::mat Y(N,X.n_cols);
+      Y.zeros();
+      for(size_t k=0;k<X.n_cols;k++)
+        for(size_t j=0;j<N;j++) {
+          // Diagonal
+          Y(j,k)+=ab(0,j)*X(j,k);
+          // and the two triangles
+          for(size_t i=j+1;i<std::min(N,j+kd+1);i++) {
+            Y(i,k)+=ab(i-j,j)*X(j,k);
+            Y(j,k)+=ab(i-j,j)*X(i,k);
+          }
+        }
+      return Y;
+    }
+
+    BandedMatrix operator+(const BandedMatrix & lh, const BandedMatrix & rh) {
+      BandedMatrix M(lh);
+      M+=rh;
+      return M;
+    }
+
+    BandedMatrix operator*(double fac, const BandedMatrix & M) {
+      BandedMatrix R(M);
+      R*=fac;
+      return R;
+    }
+
+    BandedMatrix chol(const BandedMatrix & M) {
+      // Band is overwritten by the factor
+      BandedMatrix L(M);
+
+      char uplo='L';
+      arma::blas_int n(L.get_N());
+      arma::blas_int kd(L.get_kd());
+      arma::blas_int ldab(L.band().n_rows);
+      arma::blas_int info;
+      dpbtrf_(&uplo, &n, &kd, L.band().memptr(), &ldab, &info);
+      if(info != 0) {
+        std::ostringstream oss;
+        oss << "Banded Cholesky decomposition failed, info = " << info << "!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      return L;
+    }
+
+    arma::mat chol_solve(const BandedMatrix & L, const arma::mat & B) {
+      arma::mat X(B);
+      if(X.n_rows != L.get_N()) {
+        std::ostringstream oss;
+        oss << "Right-hand side has " << X.n_rows << " rows, expected " << L.get_N() << "!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      char uplo='L';
+      arma::blas_int n(L.get_N());
+      arma::blas_int kd(L.get_kd());
+      arma::blas_int nrhs(X.n_cols);
+      arma::blas_int ldab(L.band().n_rows);
+      arma::blas_int ldb(X.n_rows);
+      arma::blas_int info;
+      dpbtrs_(&uplo, &n, &kd, &nrhs, L.band().memptr(), &ldab, X.memptr(), &ldb, &info);
+      if(info != 0) {
+        std::ostringstream oss;
+        oss << "Banded Cholesky solve failed, info = " << info << "!\n";
+        throw std::logic_error(oss.str());
+      }
+      return X;
+    }
+
+    arma::mat solve(const BandedMatrix & M, const arma::mat & B) {
+      return chol_solve(chol(M),B);
+    }
+
+    void eig_sym(arma::vec & E, arma::mat & C, const BandedMatrix & M) {
+      arma::mat ab(M.band());
+      E.zeros(M.get_N());
+      C.zeros(M.get_N(),M.get_N());
+
+      char jobz='V';
+      char uplo='L';
+      arma::blas_int n(M.get_N());
+      arma::blas_int kd(M.get_kd());
+      arma::blas_int ldab(ab.n_rows);
+      arma::blas_int ldz(std::max<arma::blas_int>(n,1));
+      arma::blas_int info;
+
+      // Workspace query
+      double wquery;
+      arma::blas_int iwquery;
+      arma::blas_int lwork(-1), liwork(-1);
+      dsbevd_(&jobz, &uplo, &n, &kd, ab.memptr(), &ldab, E.memptr(), C.memptr(), &ldz, &wquery, &lwork, &iwquery, &liwork, &info);
+      lwork=(arma::blas_int) wquery;
+      liwork=iwquery;
+      std::vector<double> work(lwork);
+      std::vector<arma::blas_int> iwork(liwork);
+
+      dsbevd_(&jobz, &uplo, &n, &kd, ab.memptr(), &ldab, E.memptr(), C.memptr(), &ldz, &work[0], &lwork, &iwork[0], &liwork, &info);
+      if(info != 0) {
+        std::ostringstream oss;
+        oss << "Banded eigendecomposition failed, info = " << info << "!\n";
+        throw std::logic_error(oss.str());
+      }
+    }
+
+    void eig_gsym(arma::vec & E, arma::mat & C, const BandedMatrix & F, const BandedMatrix & S) {
+      if(F.get_N() != S.get_N() || F.get_kd() < S.get_kd()) {
+        std::ostringstream oss;
+        oss << "Incompatible matrices in generalized eigenproblem: " << F.get_N() << " x " << F.get_kd() << " vs " << S.get_N() << " x " << S.get_kd() << "!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      arma::mat ab(F.band());
+      arma::mat bb(S.band());
+      E.zeros(F.get_N());
+      C.zeros(F.get_N(),F.get_N());
+
+      char jobz='V';
+      char uplo='L';
+      arma::blas_int n(F.get_N());
+      arma::blas_int ka(F.get_kd());
+      arma::blas_int kb(S.get_kd());
+      arma::blas_int ldab(ab.n_rows);
+      arma::blas_int ldbb(bb.n_rows);
+      arma::blas_int ldz(std::max<arma::blas_int>(n,1));
+      arma::blas_int info;
+
+      // Workspace query
+      double wquery;
+      arma::blas_int iwquery;
+      arma::blas_int lwork(-1), liwork(-1);
+      dsbgvd_(&jobz, &uplo, &n, &ka, &kb, ab.memptr(), &ldab, bb.memptr(), &ldbb, E.memptr(), C.memptr(), &ldz, &wquery, &lwork, &iwquery, &liwork, &info);
+      lwork=(arma::blas_int) wquery;
+      liwork=iwquery;
+      std::vector<double> work(lwork);
+      std::vector<arma::blas_int> iwork(liwork);
+
+      dsbgvd_(&jobz, &uplo, &n, &ka, &kb, ab.memptr(), &ldab, bb.memptr(), &ldbb, E.memptr(), C.memptr(), &ldz, &work[0], &lwork, &iwork[0], &liwork, &info);
+      if(info != 0) {
+        std::ostringstream oss;
+        oss << "Banded generalized eigendecomposition failed, info = " << info << "!\n";
+        throw std::logic_error(oss.str());
+      }
+    }
+
+    arma::mat invh(const BandedMatrix & S, bool chol, bool verbose) {
+      size_t N(S.get_N());
+      size_t kd(S.get_kd());
+
+      // Get the basis function norms
+      arma::vec bfnormlz(arma::pow(S.band().row(0).t(),-0.5));
+      // Go to normalized basis
+      BandedMatrix Snorm(S);
+      for(size_t j=0;j<N;j++)
+        for(size_t i=j;i<std::min(N,j+kd+1);i++)
+          Snorm.band()(i-j,j)*=bfnormlz(i)*bfnormlz(j);
+
+      // Half-inverse is
+      arma::mat Sinvh;
+      if(chol) {
+        // S = L L^T, so the inverse of the upper factor L^T is
+        // obtained from the triangular banded solve L^T X = 1
+        BandedMatrix L(banded::chol(Snorm));
+        Sinvh.eye(N,N);
+
+        char uplo='L';
+        char trans='T';
+        char diag='N';
+        arma::blas_int n(N);
+        arma::blas_int nkd(kd);
+        arma::blas_int nrhs(N);
+        arma::blas_int ldab(L.band().n_rows);
+        arma::blas_int ldb(std::max<arma::blas_int>(n,1));
+        arma::blas_int info;
+        dtbtrs_(&uplo, &trans, &diag, &n, &nkd, &nrhs, L.band().memptr(), &ldab, Sinvh.memptr(), &ldb, &info);
+        if(info != 0) {
+          std::ostringstream oss;
+          oss << "Banded triangular solve failed, info = " << info << "!\n";
+          throw std::logic_error(oss.str());
+        }
+      } else {
+        arma::vec Sval;
+        arma::mat Svec;
+        eig_sym(Sval,Svec,Snorm);
+        if(verbose)
+          printf("Smallest eigenvalue of overlap matrix is % e, condition number %e\n",Sval(0),Sval(Sval.n_elem-1)/Sval(0));
+
+        Sinvh=Svec*arma::diagmat(arma::pow(Sval,-0.5))*arma::trans(Svec);
+      }
+
+      Sinvh=arma::diagmat(bfnormlz)*Sinvh;
+      return Sinvh;
+    }
+  }
+}
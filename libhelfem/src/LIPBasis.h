@@ -25,6 +25,8 @@ namespace helfem {
     class LIPBasis: public PolynomialBasis {
       /// Control nodes
       arma::vec x0;
+      /// Normalization weights 1/prod_{j!=i} (x0_i-x0_j)
+      arma::vec w0;
       /// Indices of enabled functions
       arma::uvec enabled;
     public:
@@ -26,13 +26,6 @@ namespace helfem {
       int lmax;
       /// Transformation matrix
       arma::mat T;
-
-      /// Evaluate Legendre polynomials
-      arma::mat f_eval(const arma::vec & x) const;
-      /// Evaluate Legendre polynomials' derivatives
-      arma::mat df_eval(const arma::vec & x) const;
-      /// Evaluate Legendre polynomials' second derivatives
-      arma::mat lf_eval(const arma::vec & x) const;
     public:
       /// Constructor
       LegendreBasis(int nfuncs, int id);
@@ -17,6 +17,10 @@
 #include "RadialPotential.h"
 #include "chebyshev.h"
 #include "quadrature.h"
+#include "erfc_expn.h"
+#include "utils.h"
+#include <sstream>
+#include <stdexcept>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -25,43 +29,53 @@
 namespace helfem {
 namespace atomic {
 namespace basis {
-RadialBasis::RadialBasis() {}
+RadialBasis::RadialBasis() : erfc_tab_mu(0.0), erfc_tab_Lmax(-1) {}
 
 RadialBasis::RadialBasis(const polynomial_basis::PolynomialBasis *poly_, int n_quad,
                          const arma::vec &bval_) {
   // Polynomial basis
-  poly = poly_->copy();
+  poly.reset(poly_->copy());
+  // and its element variants
+  poly_variants.resize(4);
+  for (size_t iv = 0; iv < poly_variants.size(); iv++) {
+    polynomial_basis::PolynomialBasis *p(poly_->copy());
+    if (iv & 1)
+      p->drop_first();
+    if (iv & 2)
+      p->drop_last();
+    poly_variants[iv].reset(p);
+  }
 
   // Get quadrature rule
   chebyshev::chebyshev(n_quad, xq, wq);
   for (size_t i = 0; i < xq.n_elem; i++) {
-    if (!std::isfinite(xq[i]))
-      printf("xq[%i]=%e\n", (int)i, xq[i]);
-    if (!std::isfinite(wq[i]))
-      printf("wq[%i]=%e\n", (int)i, wq[i]);
+    if (!std::isfinite(xq[i]) || !std::isfinite(wq[i])) {
+      std::ostringstream oss;
+      oss << "Non-finite quadrature node " << i << ": x = " << xq[i] << ", w = " << wq[i] << "!\n";
+      throw std::logic_error(oss.str());
+    }
   }
 
   // Evaluate polynomials at quadrature points
   poly->eval(xq, bf, df);
+  // and at the sub-interval points of the inner integrals
+  sub_bf = quadrature::inner_subinterval_basis(xq, poly.get());
+  // Products of the primitive functions for the batched radial integrals
+  bf_prod.zeros(bf.n_rows, bf.n_cols * bf.n_cols);
+  for (size_t fi = 0; fi < bf.n_cols; fi++)
+    for (size_t fj = 0; fj < bf.n_cols; fj++)
+      bf_prod.col(fi * bf.n_cols + fj) = bf.col(fi) % bf.col(fj);
 
   // Element boundaries
   bval = bval_;
-}
+  // Per-element basis function tables
+  form_element_tables();
 
-RadialBasis::RadialBasis(const RadialBasis &rh) { *this = rh; }
-
-RadialBasis &RadialBasis::operator=(const RadialBasis &rh) {
-  xq = rh.xq;
-  wq = rh.wq;
-  poly = rh.poly->copy();
-  bf = rh.bf;
-  df = rh.df;
-  bval = rh.bval;
-  return *this;
+  // No erfc tabulation yet
+  erfc_tab_mu = 0.0;
+  erfc_tab_Lmax = -1;
 }
 
-RadialBasis::~RadialBasis() { delete poly; }
-
 void RadialBasis::add_boundary(double r) {
   // Check that r is not in bval
   bool in_bval = false;
@@ -75,6 +89,11 @@ void RadialBasis::add_boundary(double r) {
     newbval.subvec(0, bval.n_elem - 1) = bval;
     newbval(bval.n_elem) = r;
     bval = arma::sort(newbval, "ascend");
+    form_element_tables();
+
+    // Element tabulation is no longer valid
+    erfc_Dtab.clear();
+    erfc_tab_Lmax = -1;
   }
 }
 
@@ -104,15 +123,13 @@ arma::mat RadialBasis::get_basis(const arma::mat &bas, size_t iel) const {
   return bas.cols(idx);
 }
 
-polynomial_basis::PolynomialBasis *
-RadialBasis::get_basis(const polynomial_basis::PolynomialBasis *polynom, size_t iel) const {
-  polynomial_basis::PolynomialBasis *p(polynom->copy());
+const polynomial_basis::PolynomialBasis &RadialBasis::element_poly(size_t iel) const {
+  size_t iv = 0;
   if (iel == 0)
-    p->drop_first();
+    iv += 1;
   if (iel == bval.n_elem - 2)
-    p->drop_last();
-
-  return p;
+    iv += 2;
+  return *poly_variants[iv];
 }
 
 size_t RadialBasis::get_noverlap() const { return poly->get_noverlap(); }
@@ -177,6 +194,65 @@ arma::mat RadialBasis::bessel_kl_integral(int L, double lambda, size_t iel) cons
   return quadrature::bessel_kl_integral(Rmin, Rmax, L, lambda, xq, wq, get_basis(bf, iel));
 }
 
+std::vector<arma::mat> RadialBasis::channel_integrals(const arma::mat &V, size_t iel) const {
+  if (V.n_rows != xq.n_elem) {
+    std::ostringstream oss;
+    oss << "Channel table has " << V.n_rows << " rows, expected " << xq.n_elem << "!\n";
+    throw std::logic_error(oss.str());
+  }
+
+  // Weights of the element
+  double rlen((bval(iel + 1) - bval(iel)) / 2);
+  arma::mat wV(V);
+  for (size_t ich = 0; ich < V.n_cols; ich++)
+    wV.col(ich) %= rlen * wq;
+
+  // All channels for all primitive function pairs at once: <Nprim^2 x Nch>
+  arma::mat ints(arma::trans(bf_prod) * wV);
+
+  // Pick out the element's functions
+  arma::uvec pidx(product_indices(iel));
+  size_t N(Nprim(iel));
+  std::vector<arma::mat> ret(V.n_cols);
+  for (size_t ich = 0; ich < V.n_cols; ich++) {
+    arma::vec chint(ints.col(ich));
+    ret[ich] = arma::reshape(chint(pidx), N, N);
+  }
+  return ret;
+}
+
+void RadialBasis::multipole_integrals(int Lmax, size_t iel, std::vector<arma::mat> &rL,
+                                      std::vector<arma::mat> &rm1L) const {
+  const arma::vec &r(get_r(iel));
+
+  // Table of r^L and r^(-L-1)
+  arma::mat V(r.n_elem, 2 * (Lmax + 1));
+  for (int L = 0; L <= Lmax; L++) {
+    V.col(L) = arma::pow(r, L);
+    V.col(Lmax + 1 + L) = arma::pow(r, -L - 1);
+  }
+
+  std::vector<arma::mat> ints(channel_integrals(V, iel));
+  rL.assign(ints.begin(), ints.begin() + Lmax + 1);
+  rm1L.assign(ints.begin() + Lmax + 1, ints.end());
+}
+
+void RadialBasis::bessel_integrals(int Lmax, double lambda, size_t iel, std::vector<arma::mat> &iL,
+                                   std::vector<arma::mat> &kL) const {
+  const arma::vec &r(get_r(iel));
+
+  // Table of i_L(lambda r) and k_L(lambda r)
+  arma::mat V(r.n_elem, 2 * (Lmax + 1));
+  for (int L = 0; L <= Lmax; L++) {
+    V.col(L) = utils::bessel_il(r * lambda, L);
+    V.col(Lmax + 1 + L) = utils::bessel_kl(r * lambda, L);
+  }
+
+  std::vector<arma::mat> ints(channel_integrals(V, iel));
+  iL.assign(ints.begin(), ints.begin() + Lmax + 1);
+  kL.assign(ints.begin() + Lmax + 1, ints.end());
+}
+
 arma::mat RadialBasis::radial_integral(const RadialBasis &rh, int n, bool lhder,
                                        bool rhder) const {
   modelpotential::RadialPotential rad(n);
@@ -330,28 +406,129 @@ arma::mat RadialBasis::nuclear_offcenter(size_t iel, double Rhalf, int L) const
     throw std::logic_error("Nucleus placed within element!\n");
 }
 
+size_t RadialBasis::bandwidth() const {
+  // Functions only couple within an element
+  return max_Nprim() - 1;
+}
+
+banded::BandedMatrix RadialBasis::assemble(const std::vector<arma::mat> &elmat) const {
+  if (elmat.size() != Nel()) {
+    std::ostringstream oss;
+    oss << "Got " << elmat.size() << " element matrices for " << Nel() << " elements!\n";
+    throw std::logic_error(oss.str());
+  }
+
+  banded::BandedMatrix M(Nbf(), bandwidth());
+  for (size_t iel = 0; iel < Nel(); iel++) {
+    size_t ifirst, ilast;
+    get_idx(iel, ifirst, ilast);
+    M.add_block(ifirst, elmat[iel]);
+  }
+  return M;
+}
+
+banded::BandedMatrix RadialBasis::radial_integral(int n) const {
+  std::vector<arma::mat> elmat(Nel());
+  for (size_t iel = 0; iel < Nel(); iel++)
+    elmat[iel] = radial_integral(n, iel);
+  return assemble(elmat);
+}
+
+banded::BandedMatrix RadialBasis::overlap() const { return radial_integral(0); }
+
+banded::BandedMatrix RadialBasis::kinetic() const {
+  std::vector<arma::mat> elmat(Nel());
+  for (size_t iel = 0; iel < Nel(); iel++)
+    elmat[iel] = kinetic(iel);
+  return assemble(elmat);
+}
+
+banded::BandedMatrix RadialBasis::kinetic_l() const {
+  std::vector<arma::mat> elmat(Nel());
+  for (size_t iel = 0; iel < Nel(); iel++)
+    elmat[iel] = kinetic_l(iel);
+  return assemble(elmat);
+}
+
+banded::BandedMatrix RadialBasis::nuclear() const {
+  std::vector<arma::mat> elmat(Nel());
+  for (size_t iel = 0; iel < Nel(); iel++)
+    elmat[iel] = nuclear(iel);
+  return assemble(elmat);
+}
+
+banded::BandedMatrix
+RadialBasis::model_potential(const modelpotential::ModelPotential *nuc) const {
+  std::vector<arma::mat> elmat(Nel());
+  for (size_t iel = 0; iel < Nel(); iel++)
+    elmat[iel] = model_potential(nuc, iel);
+  return assemble(elmat);
+}
+
+arma::uvec RadialBasis::product_indices(size_t iel) const {
+  arma::uvec idx(basis_indices(iel));
+  size_t Nprim(bf.n_cols);
+
+  arma::uvec pidx(idx.n_elem * idx.n_elem);
+  for (size_t fi = 0; fi < idx.n_elem; fi++)
+    for (size_t fj = 0; fj < idx.n_elem; fj++)
+      pidx(fi * idx.n_elem + fj) = idx(fi) * Nprim + idx(fj);
+  return pidx;
+}
+
+void RadialBasis::tabulate_twoe(int Lmax) {
+  for (int k = inner_moments.size(); k <= Lmax; k++)
+    inner_moments.push_back(quadrature::inner_moment(xq, wq, sub_bf, k));
+}
+
 arma::mat RadialBasis::twoe_integral(int L, size_t iel) const {
   double Rmin(bval(iel));
   double Rmax(bval(iel + 1));
 
-  // Integral by quadrature
-  polynomial_basis::PolynomialBasis *p(get_basis(poly, iel));
-  arma::mat tei(quadrature::twoe_integral(Rmin, Rmax, xq, wq, p, L));
-  delete p;
+  if ((size_t)L < inner_moments.size()) {
+    // Assemble from the reference element operators
+    arma::uvec pidx(product_indices(iel));
+    return quadrature::twoe_integral(Rmin, Rmax, xq, wq, bf, inner_moments, L).submat(pidx, pidx);
+  }
 
-  return tei;
+  // Integral by quadrature
+  return quadrature::twoe_integral(Rmin, Rmax, xq, wq, &element_poly(iel), L);
 }
 
 arma::mat RadialBasis::yukawa_integral(int L, double lambda, size_t iel) const {
   double Rmin(bval(iel));
   double Rmax(bval(iel + 1));
 
-  // Integral by quadrature
-  polynomial_basis::PolynomialBasis *p(get_basis(poly, iel));
-  arma::mat tei(quadrature::yukawa_integral(Rmin, Rmax, xq, wq, p, L, lambda));
-  delete p;
+  // Integral by quadrature, reusing the basis functions at the
+  // sub-interval points
+  arma::uvec pidx(product_indices(iel));
+  return quadrature::yukawa_integral(Rmin, Rmax, xq, wq, bf, sub_bf, L, lambda).submat(pidx, pidx);
+}
 
-  return tei;
+void RadialBasis::tabulate_erfc(int Lmax, double mu) {
+  // Reuse the existing tabulation
+  if (erfc_Dtab.size() && mu == erfc_tab_mu && Lmax <= erfc_tab_Lmax)
+    return;
+
+  // The erfc integrals use Chebyshev points with the element's
+  // quadrature order
+  arma::vec x, w;
+  chebyshev::chebyshev(xq.n_elem, x, w);
+
+  size_t Nelem(Nel());
+  erfc_Dtab.resize((Lmax + 1) * Nelem);
+#ifdef _OPENMP
+#pragma omp parallel for collapse(2)
+#endif
+  for (int L = 0; L <= Lmax; L++)
+    for (size_t iel = 0; iel < Nelem; iel++) {
+      double rmid(0.5 * (bval(iel + 1) + bval(iel)));
+      double rlen(0.5 * (bval(iel + 1) - bval(iel)));
+      arma::vec r(rmid * arma::ones<arma::vec>(x.n_elem) + rlen * x);
+      erfc_Dtab[L * Nelem + iel] = atomic::erfc_expn::Dnk_table(L, mu * r);
+    }
+  erfc_tab_mu = mu;
+  erfc_tab_Lmax = Lmax;
 }
 
 arma::mat RadialBasis::erfc_integral(int L, double mu, size_t iel, size_t kel) const {
@@ -402,9 +579,23 @@ arma::mat RadialBasis::erfc_integral(int L, double mu, size_t iel, size_t kel) c
   // and basis function values
   arma::mat kbf(poly->eval(xk));
 
+  // Damping functions: tabulated ones at the element quadrature points
+  // if available, otherwise compute them here
+  size_t Nelem(Nel());
+  bool tab(erfc_Dtab.size() && mu == erfc_tab_mu && L <= erfc_tab_Lmax);
+  arma::mat Di, Dk;
+  if (tab)
+    Di = erfc_Dtab[L * Nelem + iel];
+  else
+    Di = atomic::erfc_expn::Dnk_table(L, mu * (0.5 * (Rmaxi + Rmini) * arma::ones<arma::vec>(xi.n_elem) + 0.5 * (Rmaxi - Rmini) * xi));
+  if (tab && Nint == 1)
+    Dk = erfc_Dtab[L * Nelem + kel];
+  else
+    Dk = atomic::erfc_expn::Dnk_table(L, mu * (0.5 * (Rmaxk + Rmink) * arma::ones<arma::vec>(xk.n_elem) + 0.5 * (Rmaxk - Rmink) * xk));
+
   // Evaluate integral
-  arma::mat tei(quadrature::erfc_integral(Rmini, Rmaxi, get_basis(ibf, iel), xi, wi, Rmink,
-                                          Rmaxk, get_basis(kbf, kel), xk, wk, L, mu));
+  arma::mat tei(quadrature::erfc_integral(Rmini, Rmaxi, get_basis(ibf, iel), xi, wi, Di, Rmink,
+                                          Rmaxk, get_basis(kbf, kel), xk, wk, Dk, L, mu));
   // Symmetrize just to be sure, since quadrature points were
   // different
   if (iel == kel)
@@ -418,99 +609,65 @@ arma::mat RadialBasis::spherical_potential(size_t iel) const {
   double Rmax(bval(iel + 1));
 
   // Integral by quadrature
-  polynomial_basis::PolynomialBasis *p(get_basis(poly, iel));
-  arma::mat pot(quadrature::spherical_potential(Rmin, Rmax, xq, wq, p));
-  delete p;
-
-  return pot;
-}
-
-arma::mat RadialBasis::get_bf(size_t iel) const {
-  // Element function values at quadrature points are
-  arma::mat val(get_basis(bf, iel));
-
-  // but we also need to put in the 1/r factor
-  double rmin(bval(iel));
-  double rmax(bval(iel + 1));
-  double rmid = (rmax + rmin) / 2;
-  double rlen = (rmax - rmin) / 2;
-  arma::vec r(rmid * arma::ones<arma::vec>(xq.n_elem) + rlen * xq);
-  for (size_t j = 0; j < val.n_cols; j++)
-    for (size_t i = 0; i < val.n_rows; i++)
-      val(i, j) /= r(i);
-
-  return val;
+  return quadrature::spherical_potential(Rmin, Rmax, xq, wq, &element_poly(iel));
 }
 
-arma::mat RadialBasis::get_df(size_t iel) const {
-  // Element function values at quadrature points are
-  arma::mat fval(get_basis(bf, iel));
-  arma::mat dval(get_basis(df, iel));
-
-  // Calculate r values
-  double rmin(bval(iel));
-  double rmax(bval(iel + 1));
-  double rmid = (rmax + rmin) / 2;
-  double rlen = (rmax - rmin) / 2;
-  arma::vec r(rmid * arma::ones<arma::vec>(xq.n_elem) + rlen * xq);
-
-  // Derivative is then
-  arma::mat der(fval);
-  for (size_t j = 0; j < fval.n_cols; j++)
-    for (size_t i = 0; i < fval.n_rows; i++)
-      // Get one rlen from derivative
-      der(i, j) = dval(i, j) / (rlen * r(i)) - fval(i, j) / (r(i) * r(i));
-
-  return der;
-}
-
-arma::mat RadialBasis::get_lf(size_t iel) const {
-  // Element function values at quadrature points are
-  arma::mat fval(get_basis(bf, iel));
-  arma::mat dval(get_basis(df, iel));
-
+void RadialBasis::form_element_tables() {
+  // Primitive second derivatives at the quadrature points
   arma::mat lf;
   poly->eval_lapl(xq, lf);
-  arma::mat lval(get_basis(lf, iel));
 
-  // Calculate r values
-  double rmin(bval(iel));
-  double rmax(bval(iel + 1));
-  double rmid = (rmax + rmin) / 2;
-  double rlen = (rmax - rmin) / 2;
-  arma::vec r(rmid * arma::ones<arma::vec>(xq.n_elem) + rlen * xq);
-
-  // Laplacian is then
-  arma::mat lapl(fval);
-  for (size_t j = 0; j < fval.n_cols; j++)
-    for (size_t i = 0; i < fval.n_rows; i++)
-      // Get one rlen from each derivative
-      lapl(i, j) = lval(i, j) / (rlen * rlen * r(i)) -
-                   2.0 * dval(i, j) / (rlen * r(i) * r(i)) +
-                   2.0 * fval(i, j) / (r(i) * r(i) * r(i));
+  size_t nel(Nel());
+  el_bf.resize(nel);
+  el_df.resize(nel);
+  el_lf.resize(nel);
+  el_wrad.resize(nel);
+  el_r.resize(nel);
+  for (size_t iel = 0; iel < nel; iel++) {
+    // Element function values at quadrature points are
+    arma::mat fval(get_basis(bf, iel));
+    arma::mat dval(get_basis(df, iel));
+    arma::mat lval(get_basis(lf, iel));
+
+    // Calculate r values
+    double rmin(bval(iel));
+    double rmax(bval(iel + 1));
+    double rmid = (rmax + rmin) / 2;
+    double rlen = (rmax - rmin) / 2;
+    arma::vec r(rmid * arma::ones<arma::vec>(xq.n_elem) + rlen * xq);
+
+    // Values with the 1/r factor, derivative and laplacian
+    arma::mat val(fval.n_rows, fval.n_cols);
+    arma::mat der(fval.n_rows, fval.n_cols);
+    arma::mat lapl(fval.n_rows, fval.n_cols);
+    for (size_t j = 0; j < fval.n_cols; j++)
+      for (size_t i = 0; i < fval.n_rows; i++) {
+        val(i, j) = fval(i, j) / r(i);
+        // Get one rlen from each derivative
+        der(i, j) = dval(i, j) / (rlen * r(i)) - fval(i, j) / (r(i) * r(i));
+        lapl(i, j) = lval(i, j) / (rlen * rlen * r(i)) -
+                     2.0 * dval(i, j) / (rlen * r(i) * r(i)) +
+                     2.0 * fval(i, j) / (r(i) * r(i) * r(i));
+      }
 
-  return lapl;
+    el_bf[iel] = val;
+    el_df[iel] = der;
+    el_lf[iel] = lapl;
+    el_r[iel] = r;
+    // This is just the radial rule, no r^2 factor included here
+    el_wrad[iel] = rlen * wq;
+  }
 }
 
-arma::vec RadialBasis::get_wrad(size_t iel) const {
-  // Full radial weight
-  double rmin(bval(iel));
-  double rmax(bval(iel + 1));
-  double rlen = (rmax - rmin) / 2;
+const arma::mat &RadialBasis::get_bf(size_t iel) const { return el_bf[iel]; }
 
-  // This is just the radial rule, no r^2 factor included here
-  return rlen * wq;
-}
+const arma::mat &RadialBasis::get_df(size_t iel) const { return el_df[iel]; }
 
-arma::vec RadialBasis::get_r(size_t iel) const {
-  // Full radial weight
-  double rmin(bval(iel));
-  double rmax(bval(iel + 1));
-  double rmid = (rmax + rmin) / 2;
-  double rlen = (rmax - rmin) / 2;
+const arma::mat &RadialBasis::get_lf(size_t iel) const { return el_lf[iel]; }
 
-  return rmid * arma::ones<arma::vec>(xq.n_elem) + rlen * xq;
-}
+const arma::vec &RadialBasis::get_wrad(size_t iel) const { return el_wrad[iel]; }
+
+const arma::vec &RadialBasis::get_r(size_t iel) const { return el_r[iel]; }
 
 double RadialBasis::nuclear_density(const arma::mat &Prad) const {
   if (Prad.n_rows != Nbf() || Prad.n_cols != Nbf())
@@ -0,0 +1,55 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include <helfem.h>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+double helfem::utils::max_rel_diff(const arma::mat & ref, const arma::mat & val) {
+  if(ref.n_rows != val.n_rows || ref.n_cols != val.n_cols)
+    return INFINITY;
+  if(!ref.n_elem)
+    return 0.0;
+
+  double diff(arma::abs(ref-val).max());
+  double scale(arma::abs(ref).max());
+  return (scale>0.0) ? diff/scale : diff;
+}
+
+double helfem::utils::max_pointwise_rel_diff(const arma::mat & ref, const arma::mat & val) {
+  if(ref.n_rows != val.n_rows || ref.n_cols != val.n_cols)
+    return INFINITY;
+
+  double d=0.0;
+  for(size_t i=0;i<ref.n_elem;i++) {
+    // No relative error can be defined
+    if(!std::isnormal(ref(i)))
+      continue;
+    if(!std::isfinite(val(i)))
+      return INFINITY;
+    // Value has underflowed
+    if(std::abs(val(i))<DBL_MIN)
+      continue;
+    d=std::max(d,std::abs(ref(i)-val(i))/std::abs(ref(i)));
+  }
+  return d;
+}
+
+int helfem::utils::test_status(bool fail) {
+  if(fail)
+    printf("Test failed!\n");
+  return fail ? 1 : 0;
+}
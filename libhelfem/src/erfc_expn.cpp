@@ -19,6 +19,7 @@
 #include <cfloat>
 #include <stdexcept>
 #include <cstdio>
+#include <vector>
 
 // For factorials
 extern "C" {
@@ -186,6 +187,134 @@ namespace helfem {
           return Phi_general(n,Xi,xi);
         }
       }
+
+      arma::mat Dnk_table(unsigned int n, const arma::vec & X) {
+        // Coefficients of the k=0 sum
+        arma::vec c0(n+1,arma::fill::zeros);
+        for(unsigned int m=1;m<=n;m++)
+          c0(m)=1.0/double_factorial(2*(n-m)+1);
+        // Prefactors and coefficients (m,k) of the k>0 sums
+        arma::vec pk(Dnk_kmax+1,arma::fill::zeros);
+        arma::mat ck(Dnk_kmax+1,Dnk_kmax+1,arma::fill::zeros);
+        for(unsigned int k=1;k<=Dnk_kmax;k++) {
+          pk(k)=(2.0*n+1.0)/(factorial(k)*(2.0*(n+k)+1.0));
+          for(unsigned int m=1;m<=k;m++)
+            ck(m,k)=choose(m-k-1,m-1)/double_factorial(2*(n+k-m)+1);
+        }
+
+        arma::mat D(Dnk_kmax+1,X.n_elem);
+        arma::vec ypow(Dnk_kmax+1);
+        for(size_t ix=0;ix<X.n_elem;ix++) {
+          double Xi(X(ix));
+          // Powers of 2 Xi^2
+          double y(2*Xi*Xi);
+          ypow(0)=1.0;
+          for(unsigned int j=1;j<=Dnk_kmax;j++)
+            ypow(j)=ypow(j-1)*y;
+
+          // Prefactor
+          double prefac = std::exp(-Xi*Xi)/sqrt(M_PI)*std::pow(2,n+1)*std::pow(Xi,2*n+1);
+
+          // k=0
+          double sum=0.0;
+          double yinvm=1.0;
+          for(unsigned int m=1;m<=n;m++) {
+            yinvm/=y;
+            sum+=c0(m)*yinvm;
+          }
+          D(0,ix)=erfc(Xi) + prefac*sum;
+
+          // k>0
+          for(unsigned int k=1;k<=Dnk_kmax;k++) {
+            sum=0.0;
+            for(unsigned int m=1;m<=k;m++)
+              sum+=ck(m,k)*ypow(k-m);
+            D(k,ix)=prefac*pk(k)*sum;
+          }
+        }
+
+        return D;
+      }
+
+      // Short-range expansion with tabulated damping functions at Xi
+      inline static double Phi_short_tab(unsigned int n, double Xi, double xi, const double * D) {
+        double Phi = 0.0;
+        double dPhi = 0.0;
+        double tol=DBL_EPSILON;
+        double x2(xi*xi);
+        double xpow(std::pow(xi,n));
+        for(unsigned int k=0; k+1<=Dnk_kmax; k+=2) {
+          dPhi = (D[k] + D[k+1]*x2)*xpow;
+          Phi += dPhi;
+          if(std::abs(dPhi) < tol*std::abs(Phi)) break;
+          xpow*=x2*x2;
+        }
+        if(std::abs(dPhi) >= tol*std::abs(Phi))
+          fprintf(stderr,"Warning - short-range Phi not converged, ratio %e\n",dPhi/Phi);
+
+        return Phi/std::pow(Xi,n+1);
+      }
+
+      // General expansion with tabulated factorial ratios cF(p,i) = (i+p)!/(p! (i-p)!); F is scratch memory
+      inline static double Phi_general_tab(unsigned int n, double Xi, double xi, const arma::mat & cF, double * F) {
+        // The exponentials are shared by all the Fn
+        double explus(std::exp(-(Xi+xi)*(Xi+xi)));
+        double exminus(std::exp(-(Xi-xi)*(Xi-xi)));
+        double prefac(-1.0/(4.0*Xi*xi));
+        for(unsigned int i=0;i<=n;i++) {
+          double Fi=0.0;
+          double pp(prefac);
+          for(unsigned int p=0;p<=i;p++) {
+            Fi += pp*cF(p,i)*((((i-p)%2) ? -explus : explus) - exminus);
+            pp*=prefac;
+          }
+          F[i]=2.0/sqrt(M_PI)*Fi;
+        }
+
+        double sum = 0.0;
+        double r(xi/Xi);
+        double rm(1.0);
+        for(unsigned int m=1;m<=n;m++) {
+          rm*=r;
+          sum += F[n-m]*(rm + 1.0/rm);
+        }
+
+        return F[n] + sum + Hn(n,Xi,xi);
+      }
+
+      arma::mat Phi(unsigned int n, const arma::vec & Xi, const arma::mat & DXi, const arma::vec & xk, const arma::mat & Dxk) {
+        if(DXi.n_rows != Dnk_kmax+1 || DXi.n_cols != Xi.n_elem || Dxk.n_rows != Dnk_kmax+1 || Dxk.n_cols != xk.n_elem)
+          throw std::logic_error("Damping function tables are not compatible with the grids!\n");
+
+        // Factorial ratios in the general expansion
+        arma::mat cF(n+1,n+1,arma::fill::zeros);
+        for(unsigned int i=0;i<=n;i++)
+          for(unsigned int p=0;p<=i;p++)
+            cF(p,i)=factorial(i+p)/(factorial(p)*factorial(i-p));
+        std::vector<double> F(n+1);
+
+        arma::mat Fn(Xi.n_elem,xk.n_elem);
+        for(size_t k=0;k<xk.n_elem;k++)
+          for(size_t i=0;i<Xi.n_elem;i++) {
+            // Larger and smaller argument, and the damping functions at the larger one
+            bool ilarge(Xi(i)>=xk(k));
+            double X(ilarge ? Xi(i) : xk(k));
+            double x(ilarge ? xk(k) : Xi(i));
+            const double * D(ilarge ? DXi.colptr(i) : Dxk.colptr(k));
+
+            // See text on top of page 8624 of Angyan et al
+            if(x < 0.4 || (X < 0.5 && x < 2*X))
+              Fn(i,k)=Phi_short_tab(n,X,x,D);
+            else
+              Fn(i,k)=Phi_general_tab(n,X,x,cF,&F[0]);
+          }
+
+        return Fn;
+      }
+
+      arma::mat Phi(unsigned int n, const arma::vec & Xi, const arma::vec & xk) {
+        return Phi(n,Xi,Dnk_table(n,Xi),xk,Dnk_table(n,xk));
+      }
     }
   }
 }
@@ -16,6 +16,8 @@
 #ifndef ATOMIC_ERFC_EXPN_H
 #define ATOMIC_ERFC_EXPN_H
 
+#include <armadillo>
+
 namespace helfem {
   namespace atomic {
     namespace erfc_expn {
@@ -33,6 +35,23 @@ namespace helfem {
        * interactions", J. Phys. A: Math. Gen. 39, 8613 (2006).
        */
       double Phi(unsigned int n, double Xi, double xi);
+
+      /// Largest k needed for the damping functions in the short-range expansion
+      const unsigned int Dnk_kmax=31;
+      /**
+       * Tabulates the damping functions Dnk(n,k,X) for k = 0,
+       * ..., Dnk_kmax at the given points. The table is
+       * (Dnk_kmax+1) x X.n_elem.
+       */
+      arma::mat Dnk_table(unsigned int n, const arma::vec & X);
+      /**
+       * Batch evaluation of the expansion on a grid, F(i,k) =
+       * Phi(n, Xi(i), xk(k)), using tabulated damping functions at
+       * both sets of points.
+       */
+      arma::mat Phi(unsigned int n, const arma::vec & Xi, const arma::mat & DXi, const arma::vec & xk, const arma::mat & Dxk);
+      /// Batch evaluation of the expansion on a grid, F(i,k) = Phi(n, Xi(i), xk(k))
+      arma::mat Phi(unsigned int n, const arma::vec & Xi, const arma::vec & xk);
     }
   }
 }
@@ -15,7 +15,7 @@
  */
 #include <helfem.h>
 
-arma::vec helfem::utils::get_grid(double rmax, int num_el, int igrid, double zexp) {
+arma::vec helfem::utils::get_grid(double rmax, int num_el, int igrid, double zexp, bool verbose) {
   // Boundary values
   arma::vec bval;
 
@@ -23,14 +23,14 @@ arma::vec helfem::utils::get_grid(double rmax, int num_el, int igrid, double zex
   switch (igrid) {
   // linear grid
   case (1):
-    if (helfem::verbose)
+    if (verbose)
       printf("Using linear grid\n");
     bval = arma::linspace<arma::vec>(0, rmax, num_el + 1);
     break;
 
   // quadratic grid (Schweizer et al 1999)
   case (2):
-    if (helfem::verbose)
+    if (verbose)
       printf("Using quadratic grid\n");
     bval.zeros(num_el + 1);
     for (int i = 0; i <= num_el; i++)
@@ -39,7 +39,7 @@ arma::vec helfem::utils::get_grid(double rmax, int num_el, int igrid, double zex
 
   case (3):
     // generalized polynomial grid, monotonic decrease till zexp~3, after that fails to work
-    if (helfem::verbose)
+    if (verbose)
       printf("Using generalized polynomial grid, zexp = %e\n", zexp);
     bval.zeros(num_el + 1);
     for (int i = 0; i <= num_el; i++)
@@ -48,7 +48,7 @@ arma::vec helfem::utils::get_grid(double rmax, int num_el, int igrid, double zex
 
   // generalized exponential grid, monotonic decrease till zexp~2, after that fails to work
   case (4):
-    if (helfem::verbose)
+    if (verbose)
       printf("Using generalized exponential grid, zexp = %e\n", zexp);
     bval = arma::exp(arma::pow(arma::linspace<arma::vec>(
                                    0, std::pow(log(rmax + 1), 1.0 / zexp), num_el + 1),
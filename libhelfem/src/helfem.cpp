@@ -16,16 +16,9 @@
 #include <helfem.h>
 #include <iostream>
 
-using namespace std;
-
-bool helfem::verbose = false;
-
-void helfem::set_verbosity(bool new_verbosity) {
-  if (verbose && new_verbosity)
-    printf("HelFEM library already in verbose mode.");
-  else if (!verbose && new_verbosity)
-    printf("HelFEM library set to verbose mode.");
-  verbose = new_verbosity;
+void helfem::set_verbosity(bool verbosity) {
+  // Verbosity is requested per call; there is no global state to set
+  (void) verbosity;
 }
 
 std::string helfem::version() { return __HELFEM_VERSION__; }
@@ -17,7 +17,10 @@
 #include "polynomial_basis.h"
 #include "polynomial.h"
 #include "orthpoly.h"
+#include "polynomial_kernels.h"
 #include <cfloat>
+#include <sstream>
+#include <stdexcept>
 
 // Legendre polynomials
 extern "C" {
@@ -45,7 +48,119 @@ namespace helfem {
       return idx;
     }
 
-    PolynomialBasis * get_basis(int primbas, int Nnodes) {
+    arma::mat lip_reference(const arma::vec & x0, const arma::vec & x, int der) {
+      arma::mat f(x.n_elem,x0.n_elem);
+      f.zeros();
+
+      if(der==0) {
+        for(size_t ix=0;ix<x.n_elem;ix++) {
+          // Loop over polynomials: x_i term excluded
+          for(size_t fi=0;fi<x0.n_elem;fi++) {
+            // Evaluate the l_i polynomial
+            double fval=1.0;
+            for(size_t fj=0;fj<x0.n_elem;fj++) {
+              // Term not included
+              if(fi==fj)
+                continue;
+              // Compute ratio
+              fval *= (x(ix)-x0(fj))/(x0(fi)-x0(fj));
+            }
+            // Store value
+            f(ix,fi)=fval;
+          }
+        }
+
+      } else if(der==1) {
+        for(size_t ix=0;ix<x.n_elem;ix++) {
+          // Loop over polynomials
+          for(size_t fi=0;fi<x0.n_elem;fi++) {
+            // Derivative yields a sum over one of the indices
+            for(size_t fj=0;fj<x0.n_elem;fj++) {
+              if(fi==fj)
+                continue;
+
+              double fval=1.0;
+              for(size_t fk=0;fk<x0.n_elem;fk++) {
+                // Term not included
+                if(fi==fk)
+                  continue;
+                if(fj==fk)
+                  continue;
+                // Compute ratio
+                fval *= (x(ix)-x0(fk))/(x0(fi)-x0(fk));
+              }
+              // Increment derivative
+              f(ix,fi)+=fval/(x0(fi)-x0(fj));
+            }
+          }
+        }
+
+      } else if(der==2) {
+        for(size_t ix=0;ix<x.n_elem;ix++) {
+          // Loop over polynomials
+          for(size_t fi=0;fi<x0.n_elem;fi++) {
+            // Derivative yields a sum over one of the indices
+            for(size_t fj=0;fj<x0.n_elem;fj++) {
+              if(fi==fj)
+                continue;
+              // Second derivative yields another sum over the indices
+              for(size_t fk=0;fk<x0.n_elem;fk++) {
+                if(fi==fk)
+                  continue;
+                if(fj==fk)
+                  continue;
+
+                double fval=1.0;
+                for(size_t fl=0;fl<x0.n_elem;fl++) {
+                  // Term not included
+                  if(fi==fl)
+                    continue;
+                  if(fj==fl)
+                    continue;
+                  if(fk==fl)
+                    continue;
+                  // Compute ratio
+                  fval *= (x(ix)-x0(fl))/(x0(fi)-x0(fl));
+                }
+                // Increment second derivative
+                f(ix,fi)+=fval/((x0(fi)-x0(fj))*(x0(fi)-x0(fk)));
+              }
+            }
+          }
+        }
+
+      } else {
+        std::ostringstream oss;
+        oss << "Derivative order " << der << " not supported!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      return f;
+    }
+
+    arma::mat legendre_reference(int lmax, const arma::vec & x, int der) {
+      if(der<0 || der>2) {
+        std::ostringstream oss;
+        oss << "Derivative order " << der << " not supported!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      // Memory for values
+      arma::mat f(x.n_elem,lmax+1);
+      // Fill in array
+      for(int l=0;l<=lmax;l++)
+        for(size_t i=0;i<x.n_elem;i++) {
+          if(der==0)
+            f(i,l) = oomph::Orthpoly::legendre(l, x(i));
+          else if(der==1)
+            f(i,l) = oomph::Orthpoly::dlegendre(l, x(i));
+          else
+            f(i,l) = oomph::Orthpoly::ddlegendre(l, x(i));
+        }
+      return f;
+    }
+
+    PolynomialBasis * get_basis(int primbas, int Nnodes, bool verbose) {
       if(Nnodes<2)
         throw std::logic_error("Can't have finite element basis with less than two nodes per element.\n");
 
@@ -56,13 +171,16 @@ namespace helfem {
       case(1):
       case(2):
         poly=new HermiteBasis(Nnodes,primbas);
-      printf("Basis set composed of %i nodes with %i:th derivative continuity.\n",Nnodes,primbas);
-      printf("This means using primitive polynomials of order %i.\n",Nnodes*(primbas+1)-1);
-      break;
+        if(verbose) {
+          printf("Basis set composed of %i nodes with %i:th derivative continuity.\n",Nnodes,primbas);
+          printf("This means using primitive polynomials of order %i.\n",Nnodes*(primbas+1)-1);
+        }
+        break;
 
       case(3):
         poly=new polynomial_basis::LegendreBasis(Nnodes,primbas);
-        printf("Basis set composed of %i-node spectral elements.\n",Nnodes);
+        if(verbose)
+          printf("Basis set composed of %i-node spectral elements.\n",Nnodes);
         break;
 
       case(4):
@@ -70,7 +188,8 @@ namespace helfem {
           arma::vec x, w;
           ::lobatto_compute(Nnodes,x,w);
           poly=new polynomial_basis::LIPBasis(x,primbas);
-          printf("Basis set composed of %i-node LIPs with Gauss-Lobatto nodes.\n",Nnodes);
+          if(verbose)
+            printf("Basis set composed of %i-node LIPs with Gauss-Lobatto nodes.\n",Nnodes);
           break;
         }
 
@@ -147,15 +266,22 @@ namespace helfem {
     }
 
     arma::mat HermiteBasis::eval(const arma::vec & x) const {
-      return polynomial::polyval(bf_C,x);
+      arma::mat f;
+      if(!polynomial_kernels::horner_eval(bf_C,x,&f,NULL,NULL))
+        f=polynomial::polyval(bf_C,x);
+      return f;
     }
 
     void HermiteBasis::eval(const arma::vec & x, arma::mat & f, arma::mat & df) const {
+      if(polynomial_kernels::horner_eval(bf_C,x,&f,&df,NULL))
+        return;
       f=polynomial::polyval(bf_C,x);
       df=polynomial::polyval(df_C,x);
     }
 
     void HermiteBasis::eval_lapl(const arma::vec & x, arma::mat & lf) const {
+      if(polynomial_kernels::horner_eval(bf_C,x,NULL,NULL,&lf))
+        return;
       lf=polynomial::polyval(polynomial::derivative_coeffs(bf_C, 2), x);
     }
 
@@ -221,47 +347,28 @@ namespace helfem {
         return x;
     }
 
-    arma::mat LegendreBasis::f_eval(const arma::vec & x) const {
-      // Memory for values
-      arma::mat ft(x.n_elem,lmax+1);
-      // Fill in array
-      for(int l=0;l<=lmax;l++)
-        for(size_t i=0;i<x.n_elem;i++)
-          ft(i,l) = oomph::Orthpoly::legendre(l, x(i));
-      return ft;
-    }
-
-    arma::mat LegendreBasis::df_eval(const arma::vec & x) const {
-      // Memory for values
-      arma::mat dt(x.n_elem,lmax+1);
-      // Fill in array
-      for(int l=0;l<=lmax;l++)
-        for(size_t i=0;i<x.n_elem;i++)
-          dt(i,l) = oomph::Orthpoly::dlegendre(l, x(i));
-      return dt;
-    }
-
-    arma::mat LegendreBasis::lf_eval(const arma::vec & x) const {
-      // Memory for values
-      arma::mat lt(x.n_elem,lmax+1);
-      // Fill in array
-      for(int l=0;l<=lmax;l++)
-        for(size_t i=0;i<x.n_elem;i++)
-          lt(i,l) = oomph::Orthpoly::ddlegendre(l, x(i));
-      return lt;
-    }
-
     arma::mat LegendreBasis::eval(const arma::vec & x) const {
-      return f_eval(x)*T;
+      arma::mat ft;
+      if(!polynomial_kernels::legendre_eval(lmax,x,&ft,NULL,NULL))
+        ft=legendre_reference(lmax,x,0);
+      return ft*T;
     }
 
     void LegendreBasis::eval(const arma::vec & x, arma::mat & f, arma::mat & df) const {
-      f=f_eval(x)*T;
-      df=df_eval(x)*T;
+      arma::mat ft, dt;
+      if(!polynomial_kernels::legendre_eval(lmax,x,&ft,&dt,NULL)) {
+        ft=legendre_reference(lmax,x,0);
+        dt=legendre_reference(lmax,x,1);
+      }
+      f=ft*T;
+      df=dt*T;
     }
 
     void LegendreBasis::eval_lapl(const arma::vec & x, arma::mat & lf) const {
-      lf=lf_eval(x)*T;
+      arma::mat lt;
+      if(!polynomial_kernels::legendre_eval(lmax,x,NULL,NULL,&lt))
+        lt=legendre_reference(lmax,x,2);
+      lf=lt*T;
     }
 
     void LegendreBasis::drop_first() {
@@ -284,6 +391,13 @@ namespace helfem {
       if(std::abs(x(x.n_elem-1)-1)>=sqrt(DBL_EPSILON))
         throw std::logic_error("LIP rightmost node is not at -1!\n");
 
+      // Normalization weights
+      w0.ones(x0.n_elem);
+      for(size_t fi=0;fi<x0.n_elem;fi++)
+        for(size_t fj=0;fj<x0.n_elem;fj++)
+          if(fi!=fj)
+            w0(fi)/=x0(fi)-x0(fj);
+
       // One overlapping function
       noverlap=1;
       nbf=x0.n_elem;
@@ -305,98 +419,24 @@ namespace helfem {
 
     arma::mat LIPBasis::eval(const arma::vec & x) const {
       // Memory for values
-      arma::mat bf(x.n_elem,x0.n_elem);
-
-      // Fill in array
-      for(size_t ix=0;ix<x.n_elem;ix++) {
-        // Loop over polynomials: x_i term excluded
-        for(size_t fi=0;fi<x0.n_elem;fi++) {
-          // Evaluate the l_i polynomial
-          double fval=1.0;
-          for(size_t fj=0;fj<x0.n_elem;fj++) {
-            // Term not included
-            if(fi==fj)
-              continue;
-            // Compute ratio
-            fval *= (x(ix)-x0(fj))/(x0(fi)-x0(fj));
-          }
-          // Store value
-          bf(ix,fi)=fval;
-        }
-      }
-
-      bf=bf.cols(enabled);
-
-      return bf;
+      arma::mat bf;
+      if(!polynomial_kernels::lip_eval(x0,w0,x,&bf,NULL,NULL))
+        bf=lip_reference(x0,x,0);
+      return bf.cols(enabled);
     }
 
     void LIPBasis::eval(const arma::vec & x, arma::mat & f, arma::mat & df) const {
-      // Function values
-      f=eval(x);
-
-      // Derivative
-      df.zeros(x.n_elem,x0.n_elem);
-      for(size_t ix=0;ix<x.n_elem;ix++) {
-        // Loop over polynomials
-        for(size_t fi=0;fi<x0.n_elem;fi++) {
-          // Derivative yields a sum over one of the indices
-          for(size_t fj=0;fj<x0.n_elem;fj++) {
-            if(fi==fj)
-              continue;
-
-            double fval=1.0;
-            for(size_t fk=0;fk<x0.n_elem;fk++) {
-              // Term not included
-              if(fi==fk)
-                continue;
-              if(fj==fk)
-                continue;
-              // Compute ratio
-              fval *= (x(ix)-x0(fk))/(x0(fi)-x0(fk));
-            }
-            // Increment derivative
-            df(ix,fi)+=fval/(x0(fi)-x0(fj));
-          }
-        }
+      if(!polynomial_kernels::lip_eval(x0,w0,x,&f,&df,NULL)) {
+        f=lip_reference(x0,x,0);
+        df=lip_reference(x0,x,1);
       }
+      f=f.cols(enabled);
       df=df.cols(enabled);
     }
 
     void LIPBasis::eval_lapl(const arma::vec & x, arma::mat & lf) const {
-      // Second derivative
-      lf.zeros(x.n_elem,x0.n_elem);
-      for(size_t ix=0;ix<x.n_elem;ix++) {
-        // Loop over polynomials
-        for(size_t fi=0;fi<x0.n_elem;fi++) {
-          // Derivative yields a sum over one of the indices
-          for(size_t fj=0;fj<x0.n_elem;fj++) {
-            if(fi==fj)
-              continue;
-            // Second derivative yields another sum over the indices
-            for(size_t fk=0;fk<x0.n_elem;fk++) {
-              if(fi==fk)
-                continue;
-              if(fj==fk)
-                continue;
-
-              double fval=1.0;
-              for(size_t fl=0;fl<x0.n_elem;fl++) {
-                // Term not included
-                if(fi==fl)
-                  continue;
-                if(fj==fl)
-                  continue;
-                if(fk==fl)
-                  continue;
-                // Compute ratio
-                fval *= (x(ix)-x0(fl))/(x0(fi)-x0(fl));
-              }
-              // Increment second derivative
-              lf(ix,fi)+=fval/((x0(fi)-x0(fj))*(x0(fi)-x0(fk)));
-            }
-          }
-        }
-      }
+      if(!polynomial_kernels::lip_eval(x0,w0,x,NULL,NULL,&lf))
+        lf=lip_reference(x0,x,2);
       lf=lf.cols(enabled);
     }
 
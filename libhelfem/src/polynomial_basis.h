@@ -26,6 +26,11 @@ namespace helfem {
   namespace polynomial_basis {
     /// Get primitive indices for a basis with n nodes and n overlapping functions.
     arma::uvec primitive_indices(int nnodes, int noverlap, bool drop_first, bool drop_last);
+
+    /// Reference evaluation of the der:th derivative (0, 1 or 2) of the Lagrange interpolating polynomials with nodes x0, used when there is no specialized kernel
+    arma::mat lip_reference(const arma::vec & x0, const arma::vec & x, int der);
+    /// Reference evaluation of the der:th derivative (0, 1 or 2) of the Legendre polynomials up to lmax, used when there is no specialized kernel
+    arma::mat legendre_reference(int lmax, const arma::vec & x, int der);
   }
 }
 #endif
@@ -0,0 +1,126 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "polynomial_kernels.h"
+
+/// Expands to the switch cases for all specialized node counts
+#define KERNEL_CASES(CALL)                              \
+  case 4: CALL(4); break;                               \
+  case 5: CALL(5); break;                               \
+  case 6: CALL(6); break;                               \
+  case 7: CALL(7); break;                               \
+  case 8: CALL(8); break;                               \
+  case 9: CALL(9); break;                               \
+  case 10: CALL(10); break;                             \
+  case 11: CALL(11); break;                             \
+  case 12: CALL(12); break;                             \
+  case 13: CALL(13); break;                             \
+  case 14: CALL(14); break;                             \
+  case 15: CALL(15); break;                             \
+  case 16: CALL(16); break;                             \
+  case 17: CALL(17); break;                             \
+  case 18: CALL(18); break;                             \
+  case 19: CALL(19); break;                             \
+  case 20: CALL(20); break;
+
+/// Expands to the switch cases for the number of expansion coefficients of Hermite bases beyond the node counts
+#define WIDE_KERNEL_CASES(CALL)                         \
+  case 21: CALL(21); break;                             \
+  case 22: CALL(22); break;                             \
+  case 23: CALL(23); break;                             \
+  case 24: CALL(24); break;                             \
+  case 25: CALL(25); break;                             \
+  case 26: CALL(26); break;                             \
+  case 27: CALL(27); break;                             \
+  case 28: CALL(28); break;                             \
+  case 29: CALL(29); break;                             \
+  case 30: CALL(30); break;                             \
+  case 31: CALL(31); break;                             \
+  case 32: CALL(32); break;                             \
+  case 33: CALL(33); break;                             \
+  case 34: CALL(34); break;                             \
+  case 35: CALL(35); break;                             \
+  case 36: CALL(36); break;                             \
+  case 37: CALL(37); break;                             \
+  case 38: CALL(38); break;                             \
+  case 39: CALL(39); break;                             \
+  case 40: CALL(40); break;
+
+namespace helfem {
+  namespace polynomial_kernels {
+    /// Allocates the wanted outputs and returns their memory pointers
+    static void allocate(size_t nx, size_t nf, arma::mat * f, arma::mat * df, arma::mat * lf, double * & fp, double * & dfp, double * & lfp) {
+      fp=dfp=lfp=NULL;
+      if(f) {
+        f->set_size(nx,nf);
+        fp=f->memptr();
+      }
+      if(df) {
+        df->set_size(nx,nf);
+        dfp=df->memptr();
+      }
+      if(lf) {
+        lf->set_size(nx,nf);
+        lfp=lf->memptr();
+      }
+    }
+
+    bool lip_eval(const arma::vec & x0, const arma::vec & w, const arma::vec & x, arma::mat * f, arma::mat * df, arma::mat * lf) {
+      int n(x0.n_elem);
+      if(n<min_nodes || n>max_nodes)
+        return false;
+
+      double *fp, *dfp, *lfp;
+      allocate(x.n_elem,n,f,df,lf,fp,dfp,lfp);
+#define LIP_CALL(N) lip_kernel<N>(x0.memptr(),w.memptr(),x.memptr(),x.n_elem,fp,dfp,lfp)
+      switch(n) {
+        KERNEL_CASES(LIP_CALL)
+      }
+#undef LIP_CALL
+      return true;
+    }
+
+    bool legendre_eval(int lmax, const arma::vec & x, arma::mat * f, arma::mat * df, arma::mat * lf) {
+      int n(lmax+1);
+      if(n<min_nodes || n>max_nodes)
+        return false;
+
+      double *fp, *dfp, *lfp;
+      allocate(x.n_elem,n,f,df,lf,fp,dfp,lfp);
+#define LEGENDRE_CALL(N) legendre_kernel<N>(x.memptr(),x.n_elem,fp,dfp,lfp)
+      switch(n) {
+        KERNEL_CASES(LEGENDRE_CALL)
+      }
+#undef LEGENDRE_CALL
+      return true;
+    }
+
+    bool horner_eval(const arma::mat & C, const arma::vec & x, arma::mat * f, arma::mat * df, arma::mat * lf) {
+      int n(C.n_rows);
+      if(n<min_nodes || n>max_coeffs)
+        return false;
+
+      double *fp, *dfp, *lfp;
+      allocate(x.n_elem,C.n_cols,f,df,lf,fp,dfp,lfp);
+#define HORNER_CALL(N) horner_kernel<N>(C.memptr(),C.n_cols,x.memptr(),x.n_elem,fp,dfp,lfp)
+      switch(n) {
+        KERNEL_CASES(HORNER_CALL)
+        WIDE_KERNEL_CASES(HORNER_CALL)
+      }
+#undef HORNER_CALL
+      return true;
+    }
+  }
+}
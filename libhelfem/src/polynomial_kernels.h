@@ -0,0 +1,144 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#ifndef POLYNOMIAL_KERNELS_H
+#define POLYNOMIAL_KERNELS_H
+
+#include <armadillo>
+
+namespace helfem {
+  namespace polynomial_kernels {
+    /// Smallest number of nodes with a specialized kernel
+    const int min_nodes=4;
+    /// Largest number of nodes with a specialized kernel
+    const int max_nodes=20;
+    /// Largest number of expansion coefficients with a specialized kernel; Hermite bases have several per node
+    const int max_coeffs=40;
+
+    /**
+     * Lagrange interpolating polynomials l_i(x) = w_i prod_{j!=i} (x-x_j)
+     * with w_i = 1/prod_{j!=i} (x_i-x_j), and their first and second
+     * derivatives. The products of the factors to the left and to the
+     * right of i are accumulated with their derivatives, so a point
+     * costs O(N) per polynomial. Outputs are column-major Nx x N
+     * arrays; null pointers are skipped.
+     */
+    template<int N> void lip_kernel(const double *x0, const double *w, const double *x, size_t nx, double *f, double *df, double *lf) {
+      for(size_t ix=0;ix<nx;ix++) {
+        double d[N];
+        for(int j=0;j<N;j++)
+          d[j]=x[ix]-x0[j];
+
+        // Products of factors j<i and their derivatives
+        double p[N], dp[N], ddp[N];
+        p[0]=1.0;
+        dp[0]=0.0;
+        ddp[0]=0.0;
+        for(int j=1;j<N;j++) {
+          p[j]=p[j-1]*d[j-1];
+          dp[j]=dp[j-1]*d[j-1]+p[j-1];
+          ddp[j]=ddp[j-1]*d[j-1]+2.0*dp[j-1];
+        }
+
+        // Products of factors j>i, accumulated from the right
+        double s=1.0, ds=0.0, dds=0.0;
+        for(int i=N-1;i>=0;i--) {
+          if(f)
+            f[i*nx+ix]=w[i]*p[i]*s;
+          if(df)
+            df[i*nx+ix]=w[i]*(dp[i]*s+p[i]*ds);
+          if(lf)
+            lf[i*nx+ix]=w[i]*(ddp[i]*s+2.0*dp[i]*ds+p[i]*dds);
+
+          dds=dds*d[i]+2.0*ds;
+          ds=ds*d[i]+s;
+          s=s*d[i];
+        }
+      }
+    }
+
+    /**
+     * Legendre polynomials P_0, ..., P_{N-1} and their first and second
+     * derivatives from the three-term recurrence
+     *   (l+1) P_{l+1} = (2l+1) x P_l - l P_{l-1},
+     *   P'_{l+1} = P'_{l-1} + (2l+1) P_l,
+     *   P''_{l+1} = P''_{l-1} + (2l+1) P'_l.
+     * Outputs are column-major Nx x N arrays; null pointers are skipped.
+     */
+    template<int N> void legendre_kernel(const double *x, size_t nx, double *f, double *df, double *lf) {
+      for(size_t ix=0;ix<nx;ix++) {
+        double P[N], dP[N], ddP[N];
+        P[0]=1.0;
+        dP[0]=0.0;
+        ddP[0]=0.0;
+        P[1]=x[ix];
+        dP[1]=1.0;
+        ddP[1]=0.0;
+        for(int l=1;l+1<N;l++) {
+          P[l+1]=((2*l+1)*x[ix]*P[l]-l*P[l-1])/(l+1);
+          dP[l+1]=dP[l-1]+(2*l+1)*P[l];
+          ddP[l+1]=ddP[l-1]+(2*l+1)*dP[l];
+        }
+
+        for(int l=0;l<N;l++) {
+          if(f)
+            f[l*nx+ix]=P[l];
+          if(df)
+            df[l*nx+ix]=dP[l];
+          if(lf)
+            lf[l*nx+ix]=ddP[l];
+        }
+      }
+    }
+
+    /**
+     * Polynomials given by N expansion coefficients in the columns of
+     * C (lowest order first) and their first and second derivatives,
+     * evaluated with Horner's scheme. Outputs are column-major Nx x Nf
+     * arrays; null pointers are skipped.
+     */
+    template<int N> void horner_kernel(const double *C, size_t nf, const double *x, size_t nx, double *f, double *df, double *lf) {
+      for(size_t ic=0;ic<nf;ic++) {
+        double c[N];
+        for(int k=0;k<N;k++)
+          c[k]=C[ic*N+k];
+
+        for(size_t ix=0;ix<nx;ix++) {
+          double p=c[N-1], dp=0.0, ddp=0.0;
+          for(int k=N-2;k>=0;k--) {
+            ddp=ddp*x[ix]+2.0*dp;
+            dp=dp*x[ix]+p;
+            p=p*x[ix]+c[k];
+          }
+          if(f)
+            f[ic*nx+ix]=p;
+          if(df)
+            df[ic*nx+ix]=dp;
+          if(lf)
+            lf[ic*nx+ix]=ddp;
+        }
+      }
+    }
+
+    /// Evaluate Lagrange interpolating polynomials with nodes x0 and weights w; returns false if there is no specialized kernel for the number of nodes
+    bool lip_eval(const arma::vec & x0, const arma::vec & w, const arma::vec & x, arma::mat * f, arma::mat * df, arma::mat * lf);
+    /// Evaluate Legendre polynomials up to lmax; returns false if there is no specialized kernel for lmax+1 functions
+    bool legendre_eval(int lmax, const arma::vec & x, arma::mat * f, arma::mat * df, arma::mat * lf);
+    /// Evaluate polynomials from their expansion coefficients; returns false if there is no specialized kernel for the number of coefficients
+    bool horner_eval(const arma::mat & C, const arma::vec & x, arma::mat * f, arma::mat * df, arma::mat * lf);
+  }
+}
+
+#endif
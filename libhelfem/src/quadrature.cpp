@@ -276,6 +276,124 @@ namespace helfem {
       return ints;
     }
 
+    arma::mat inner_subinterval_basis(const arma::vec & x, const polynomial_basis::PolynomialBasis * poly) {
+      size_t Nq(x.n_elem);
+      arma::vec xsub(Nq*Nq);
+      for(size_t ip=0;ip<Nq;ip++) {
+        // Sub-interval is
+        double xmin(ip ? x(ip-1) : -1.0);
+        double xmax(x(ip));
+        double xmid(0.5*(xmax+xmin));
+        double xlen(0.5*(xmax-xmin));
+        xsub.subvec(ip*Nq,(ip+1)*Nq-1)=xmid*arma::ones<arma::vec>(Nq)+xlen*x;
+      }
+      return poly->eval(xsub);
+    }
+
+    arma::mat inner_moment(const arma::vec & x, const arma::vec & wx, const arma::mat & subbf, int k) {
+      size_t Nq(x.n_elem);
+      size_t Nb(subbf.n_cols);
+      arma::vec wp(wx%arma::pow(x,k));
+
+      arma::mat moment(Nq,Nb*Nb);
+      for(size_t ip=0;ip<Nq;ip++) {
+        // Basis functions in the sub-interval
+        arma::mat bf(subbf.rows(ip*Nq,(ip+1)*Nq-1));
+        arma::mat wbf(bf);
+        for(size_t i=0;i<wbf.n_cols;i++)
+          wbf.col(i)%=wp;
+        moment.row(ip)=arma::trans(arma::vectorise(arma::trans(wbf)*bf));
+      }
+
+      return moment;
+    }
+
+    arma::mat twoe_inner_integral(double rmin, double rmax, const arma::vec & x, const std::vector<arma::mat> & moments, int L) {
+      if(L<0 || (size_t) L>=moments.size()) {
+        std::ostringstream oss;
+        oss << "Moments of the inner integral are only available up to L=" << ((int) moments.size()-1) << " but L=" << L << " was requested!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      // Midpoint is at
+      double rmid(0.5*(rmax+rmin));
+      // and half-length of interval is
+      double rlen(0.5*(rmax-rmin));
+      // r values are then
+      arma::vec r(rmid*arma::ones<arma::vec>(x.n_elem)+rlen*x);
+
+      /*
+        In sub-interval ip, r = c + h t with t in [-1,1], so the
+        weight r^L h expands as h sum_k binom(L,k) c^(L-k) h^k t^k.
+        Since c >= h, all the terms are positive and bounded by the
+        largest r^L in the sub-interval, so the expansion is stable.
+      */
+      size_t Nq(x.n_elem);
+      arma::mat coeff(Nq,L+1);
+      for(size_t ip=0;ip<Nq;ip++) {
+        double xmin(ip ? x(ip-1) : -1.0);
+        double xmax(x(ip));
+        double c(rmid+rlen*0.5*(xmax+xmin));
+        double h(rlen*0.5*(xmax-xmin));
+
+        // Powers of c and h
+        arma::vec cpow(L+1), hpow(L+1);
+        cpow(0)=1.0;
+        hpow(0)=h;
+        for(int k=1;k<=L;k++) {
+          cpow(k)=cpow(k-1)*c;
+          hpow(k)=hpow(k-1)*h;
+        }
+        double binom(1.0);
+        for(int k=0;k<=L;k++) {
+          coeff(ip,k)=binom*cpow(L-k)*hpow(k);
+          binom*=(L-k)/(k+1.0);
+        }
+      }
+
+      // Sub-interval integrals
+      arma::mat inner(arma::diagmat(coeff.col(0))*moments[0]);
+      for(int k=1;k<=L;k++)
+        inner+=arma::diagmat(coeff.col(k))*moments[k];
+      // Cumulative integrals
+      inner=arma::cumsum(inner);
+
+      // Put in the 1/r^(L+1) factors now that the integrals have been computed
+      arma::vec rpopl(arma::pow(r,L+1));
+      for(size_t ip=0;ip<x.n_elem;ip++)
+        inner.row(ip)/=rpopl(ip);
+
+      return inner;
+    }
+
+    /// Contract the inner integrals with the outer product functions
+    static arma::mat twoe_outer_integral(double rmin, double rmax, const arma::vec & wx, const arma::mat & bf, const arma::mat & inner) {
+      // Half-length of interval is
+      double rlen(0.5*(rmax-rmin));
+
+      // Product functions
+      arma::mat bfprod(bf.n_rows,bf.n_cols*bf.n_cols);
+      for(size_t fi=0;fi<bf.n_cols;fi++)
+        for(size_t fj=0;fj<bf.n_cols;fj++)
+          bfprod.col(fi*bf.n_cols+fj)=bf.col(fi)%bf.col(fj);
+      // Put in the weights for the outer integral
+      arma::vec wp(wx*rlen);
+      for(size_t i=0;i<bfprod.n_cols;i++)
+        bfprod.col(i)%=wp;
+
+      // Integrals are then
+      arma::mat ints(arma::trans(bfprod)*inner);
+      // but we are still missing the second term which can be
+      // obtained as simply as
+      ints+=arma::trans(ints);
+
+      return ints;
+    }
+
+    arma::mat twoe_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, const std::vector<arma::mat> & moments, int L) {
+      return twoe_outer_integral(rmin, rmax, wx, bf, twoe_inner_integral(rmin, rmax, x, moments, L));
+    }
+
     static arma::vec yukawa_inner_integral_wrk(double rmin, double rmax, double rmin0, double rmax0, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, double lambda) {
       // Midpoint is at
       double rmid(0.5*(rmax+rmin));
@@ -367,7 +485,62 @@ namespace helfem {
       return ints;
     }
 
+    arma::mat yukawa_inner_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const arma::mat & subbf, int L, double lambda) {
+      // Midpoint is at
+      double rmid(0.5*(rmax+rmin));
+      // and half-length of interval is
+      double rlen(0.5*(rmax-rmin));
+      // r values are then
+      arma::vec r(rmid*arma::ones<arma::vec>(x.n_elem)+rlen*x);
+
+      size_t Nq(x.n_elem);
+      size_t Nb(subbf.n_cols);
+      arma::mat inner(Nq,Nb*Nb);
+      for(size_t ip=0;ip<Nq;ip++) {
+        // Sub-interval
+        double rsmin(ip ? r(ip-1) : rmin);
+        double rsmid(0.5*(r(ip)+rsmin));
+        double rslen(0.5*(r(ip)-rsmin));
+        arma::vec rs(rsmid*arma::ones<arma::vec>(Nq)+rslen*x);
+
+        // Calculate total weight per point
+        arma::vec wp((wx%utils::bessel_il(rs*lambda,L))*rslen);
+
+        // Basis functions at the points are already known
+        arma::mat bf(subbf.rows(ip*Nq,(ip+1)*Nq-1));
+        arma::mat wbf(bf);
+        for(size_t i=0;i<wbf.n_cols;i++)
+          wbf.col(i)%=wp;
+        inner.row(ip)=arma::trans(arma::vectorise(arma::trans(wbf)*bf));
+      }
+      // Cumulative integrals
+      inner=arma::cumsum(inner);
+
+      // Put in the k_L(r) factors now that the integrals have been computed
+      arma::vec rpopl(utils::bessel_kl(r*lambda,L));
+      for(size_t ip=0;ip<x.n_elem;ip++)
+        inner.row(ip)*=rpopl(ip);
+
+      return inner;
+    }
+
+    arma::mat yukawa_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, const arma::mat & subbf, int L, double lambda) {
+      return twoe_outer_integral(rmin, rmax, wx, bf, yukawa_inner_integral(rmin, rmax, x, wx, subbf, L, lambda));
+    }
+
     arma::mat erfc_integral(double rmini, double rmaxi, const arma::mat & bfi, const arma::vec & xi, const arma::vec & wi, double rmink, double rmaxk, const arma::mat & bfk, const arma::vec & xk, const arma::vec & wk, int L, double mu) {
+      // Radii
+      arma::vec ri(0.5*(rmaxi+rmini)*arma::ones<arma::vec>(xi.n_elem)+0.5*(rmaxi-rmini)*xi);
+      arma::vec rk(0.5*(rmaxk+rmink)*arma::ones<arma::vec>(xk.n_elem)+0.5*(rmaxk-rmink)*xk);
+
+      // Tabulate the damping functions
+      arma::mat Di(atomic::erfc_expn::Dnk_table(L,mu*ri));
+      arma::mat Dk(atomic::erfc_expn::Dnk_table(L,mu*rk));
+
+      return erfc_integral(rmini, rmaxi, bfi, xi, wi, Di, rmink, rmaxk, bfk, xk, wk, Dk, L, mu);
+    }
+
+    arma::mat erfc_integral(double rmini, double rmaxi, const arma::mat & bfi, const arma::vec & xi, const arma::vec & wi, const arma::mat & Di, double rmink, double rmaxk, const arma::mat & bfk, const arma::vec & xk, const arma::vec & wk, const arma::mat & Dk, int L, double mu) {
 #ifndef ARMA_NO_DEBUG
       if(xi.n_elem != wi.n_elem) {
         std::ostringstream oss;
@@ -392,10 +565,7 @@ namespace helfem {
       arma::vec rk(rmidk*arma::ones<arma::vec>(xk.n_elem)+rlenk*xk);
 
       // Green's function
-      arma::mat Fn(ri.n_elem,rk.n_elem);
-      for(size_t i=0;i<ri.n_elem;i++)
-        for(size_t k=0;k<rk.n_elem;k++)
-          Fn(i,k) = atomic::erfc_expn::Phi(L,mu*ri(i),mu*rk(k));
+      arma::mat Fn(atomic::erfc_expn::Phi(L,mu*ri,Di,mu*rk,Dk));
 
       // Product functions
       arma::mat bfprodij(bfi.n_rows,bfi.n_cols*bfi.n_cols);
@@ -91,6 +91,36 @@ namespace helfem {
      */
     arma::mat twoe_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L);
 
+    /**
+     * Evaluates the polynomial basis at the points of the
+     * sub-interval quadratures used for the inner integrals on the
+     * reference element [-1,1]. Sub-interval ip runs from x(ip-1)
+     * (or -1) to x(ip); the result is <Nq^2 x Nprim> with rows ip*Nq+j.
+     */
+    arma::mat inner_subinterval_basis(const arma::vec & x, const polynomial_basis::PolynomialBasis * poly);
+
+    /**
+     * Computes the k:th moment operator of the inner integrals on
+     * the reference element: row ip holds the sub-interval integrals
+     * \f$ \int t^k B_a(t) B_b(t) \f$ in the local coordinate t of
+     * sub-interval ip. The result is <Nq x Nprim^2>.
+     */
+    arma::mat inner_moment(const arma::vec & x, const arma::vec & wx, const arma::mat & subbf, int k);
+
+    /**
+     * Computes the inner in-element two-electron integral for the
+     * full primitive basis from the reference element moments
+     * 0, ..., L, which must be available.
+     */
+    arma::mat twoe_inner_integral(double rmin, double rmax, const arma::vec & x, const std::vector<arma::mat> & moments, int L);
+
+    /**
+     * Computes a primitive two-electron in-element integral for the
+     * full primitive basis, using the basis functions bf evaluated at
+     * the quadrature points and the reference element moments.
+     */
+    arma::mat twoe_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, const std::vector<arma::mat> & moments, int L);
+
     /**
      * Computes the inner in-element two-electron Yukawa integral:
      * \f$ \phi(r) = \frac 1 r^{L+1} \int_0^r dr' r'^{L} B_k(r') B_l(r') \f$
@@ -104,11 +134,32 @@ namespace helfem {
      */
     arma::mat yukawa_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, double lambda);
 
+    /**
+     * Computes the inner in-element two-electron Yukawa integral for
+     * the full primitive basis, using the basis functions subbf at the
+     * sub-interval points from inner_subinterval_basis.
+     */
+    arma::mat yukawa_inner_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const arma::mat & subbf, int L, double lambda);
+
+    /**
+     * Computes a primitive two-electron in-element Yukawa integral
+     * for the full primitive basis, using the basis functions bf
+     * evaluated at the quadrature points and subbf at the sub-interval
+     * points.
+     */
+    arma::mat yukawa_integral(double rmin, double rmax, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, const arma::mat & subbf, int L, double lambda);
+
     /**
      * Computes a primitive two-electron complementary error function
      * integral. Note that these integrals do not factorize.
      */
     arma::mat erfc_integral(double rmini, double rmaxi, const arma::mat & bfi, const arma::vec & xi, const arma::vec & wi, double rmink, double rmaxk, const arma::mat & bfk, const arma::vec & xk, const arma::vec & wk, int L, double mu);
+    /**
+     * Same as above, but using damping functions of the expansion
+     * that have been tabulated at the quadrature points with
+     * erfc_expn::Dnk_table.
+     */
+    arma::mat erfc_integral(double rmini, double rmaxi, const arma::mat & bfi, const arma::vec & xi, const arma::vec & wi, const arma::mat & Di, double rmink, double rmaxk, const arma::mat & bfk, const arma::vec & xk, const arma::vec & wk, const arma::mat & Dk, int L, double mu);
 
     /**
      * Computes the spherically symmetric potential V(r).
@@ -148,11 +148,72 @@ namespace helfem {
       return ktei;
     }
 
+    void convert_to_single(std::vector<arma::mat> & in, std::vector<arma::fmat> & out) {
+      out.resize(in.size());
+      for(size_t i=0;i<in.size();i++)
+        out[i]=arma::conv_to<arma::fmat>::from(in[i]);
+      in.clear();
+    }
+
+    void mixed_gemv(const arma::fmat & A, const arma::mat & x, double fac, arma::mat & y) {
+#ifndef ARMA_NO_DEBUG
+      if(A.n_cols != x.n_elem || A.n_rows != y.n_elem) {
+        std::ostringstream oss;
+        oss << "Incompatible dimensions in mixed_gemv: " << A.n_rows << " x " << A.n_cols << " matrix with " << x.n_elem << " element input and " << y.n_elem << " element output!\n";
+        throw std::logic_error(oss.str());
+      }
+#endif
+
+      // Column-wise accumulation: the matrix is only read once, in
+      // storage order, and widened to double on the fly. This is
+      // memory bound; once vectorized it runs as fast as dgemv on the
+      // double precision matrix while reading half the bytes, whereas
+      // widening panels for dgemv costs a separate conversion pass.
+      double * yp(y.memptr());
+      for(size_t j=0;j<A.n_cols;j++) {
+        const double xj(fac*x(j));
+        if(xj==0.0)
+          continue;
+        const float * Ap(A.colptr(j));
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+        for(size_t i=0;i<A.n_rows;i++)
+          yp[i]+=xj*((double) Ap[i]);
+      }
+    }
+
+    void mixed_gemv_t(const arma::fmat & A, const arma::mat & x, double fac, arma::mat & y) {
+#ifndef ARMA_NO_DEBUG
+      if(A.n_rows != x.n_elem || A.n_cols != y.n_elem) {
+        std::ostringstream oss;
+        oss << "Incompatible dimensions in mixed_gemv_t: " << A.n_rows << " x " << A.n_cols << " matrix with " << x.n_elem << " element input and " << y.n_elem << " element output!\n";
+        throw std::logic_error(oss.str());
+      }
+#endif
+
+      // Dot products with the columns, which are read in storage
+      // order and widened to double on the fly; as in mixed_gemv,
+      // this is as fast as dgemv on the double precision matrix
+      const double * xp(x.memptr());
+      double * yp(y.memptr());
+      for(size_t j=0;j<A.n_cols;j++) {
+        const float * Ap(A.colptr(j));
+        double d=0.0;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:d)
+#endif
+        for(size_t i=0;i<A.n_rows;i++)
+          d+=((double) Ap[i])*xp[i];
+        yp[j]+=fac*d;
+      }
+    }
+
     int stricmp(const std::string & str1, const std::string & str2) {
       return strcasecmp(str1.c_str(),str2.c_str());
     }
 
-    arma::mat invh(arma::mat S, bool chol) {
+    arma::mat invh(arma::mat S, bool chol, bool verbose) {
       // Get the basis function norms
       arma::vec bfnormlz(arma::pow(arma::diagvec(S),-0.5));
       // Go to normalized basis
@@ -168,7 +229,8 @@ namespace helfem {
         if(!arma::eig_sym(Sval,Svec,S)) {
           throw std::logic_error("Diagonalization of overlap matrix failed\n");
         }
-        printf("Smallest eigenvalue of overlap matrix is % e, condition number %e\n",Sval(0),Sval(Sval.n_elem-1)/Sval(0));
+        if(verbose)
+          printf("Smallest eigenvalue of overlap matrix is % e, condition number %e\n",Sval(0),Sval(Sval.n_elem-1)/Sval(0));
 
         Sinvh=Svec*arma::diagmat(arma::pow(Sval,-0.5))*arma::trans(Svec);
       }
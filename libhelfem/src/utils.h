@@ -43,6 +43,13 @@ namespace helfem {
     /// Permute indices (ij|kl) -> (jk|il)
     arma::mat exchange_tei(const arma::mat & tei, size_t Ni, size_t Nj, size_t Nk, size_t Nl);
 
+    /// Convert integrals to single precision, releasing the double precision storage
+    void convert_to_single(std::vector<arma::mat> & in, std::vector<arma::fmat> & out);
+    /// Increment y += fac * A * x for a single precision matrix A, accumulating in double precision
+    void mixed_gemv(const arma::fmat & A, const arma::mat & x, double fac, arma::mat & y);
+    /// Increment y += fac * A^T * x for a single precision matrix A, accumulating in double precision
+    void mixed_gemv_t(const arma::fmat & A, const arma::mat & x, double fac, arma::mat & y);
+
     /// Case independent string comparison
     int stricmp(const std::string & str1, const std::string & str2);
   }
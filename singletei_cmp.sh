@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Compares converged SCF total energies computed with double (default)
+# and single precision storage of the primitive two-electron
+# integrals (--singletei 0/1) for a few atoms and diatomics. Run after
+# compile.sh, which installs the binaries under bin/.
+
+bindir=${bindir:-$(pwd)/bin}
+# Extra arguments, e.g. --method=
+extra="$@"
+
+workdir=$(mktemp -d)
+trap "rm -rf ${workdir}" EXIT
+
+# Final total energy of a calculation
+total_energy() {
+    awk '/^Total +energy:/ {E=$3} END {print E}' $1
+}
+
+# Runs the calculation with both integral precisions and prints the difference
+compare() {
+    label=$1
+    shift
+    for s in 0 1; do
+        (cd ${workdir} && "$@" --singletei=${s} --convthr=1e-9 --save=${workdir}/sp${s}.chk ${extra} > ${workdir}/sp${s}.out 2>&1)
+        if [[ $? -ne 0 ]]; then
+            echo "${label}: calculation with --singletei=${s} failed, see below"
+            tail -n 20 ${workdir}/sp${s}.out
+            return 1
+        fi
+    done
+    E0=$(total_energy ${workdir}/sp0.out)
+    E1=$(total_energy ${workdir}/sp1.out)
+    awk -v l="${label}" -v a="${E0}" -v b="${E1}" 'BEGIN {printf("%-4s double % .12f single % .12f difference % .3e\n",l,a,b,b-a)}'
+}
+
+compare He ${bindir}/atomic --Z=He --lmax=0 --mmax=0 --nelem=10
+compare Ne ${bindir}/atomic --Z=Ne --lmax=3 --mmax=0 --nelem=10
+compare Ar ${bindir}/atomic --Z=Ar --lmax=3 --mmax=0 --nelem=10
+compare H2 ${bindir}/diatomic --Z1=H --Z2=H --Rbond=1.4 --lmax=10 --nelem=5
+compare LiH ${bindir}/diatomic --Z1=Li --Z2=H --Rbond=3.015 --lmax=10 --nelem=5
+compare N2 ${bindir}/diatomic --Z1=N --Z2=N --Rbond=2.074 --lmax=12 --nelem=5
@@ -0,0 +1,199 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "BlockMatrix.h"
+
+namespace helfem {
+  namespace atomic {
+    namespace basis {
+      BlockMatrix::BlockMatrix() : Nang(0), Nrad(0) {
+      }
+
+      BlockMatrix::BlockMatrix(size_t Nang_, size_t Nrad_) : Nang(Nang_), Nrad(Nrad_) {
+        blocks.resize(Nang*Nang);
+      }
+
+      BlockMatrix::BlockMatrix(const arma::mat & M, size_t Nang_, size_t Nrad_) : Nang(Nang_), Nrad(Nrad_) {
+        if(M.n_rows != Nang*Nrad || M.n_cols != Nang*Nrad) {
+          std::ostringstream oss;
+          oss << "Matrix is " << M.n_rows << " x " << M.n_cols << " but expected " << Nang*Nrad << " x " << Nang*Nrad << "!\n";
+          throw std::logic_error(oss.str());
+        }
+
+        blocks.resize(Nang*Nang);
+        for(size_t iang=0;iang<Nang;iang++)
+          for(size_t jang=0;jang<Nang;jang++) {
+            arma::mat Msub(M.submat(iang*Nrad,jang*Nrad,(iang+1)*Nrad-1,(jang+1)*Nrad-1));
+            if(arma::any(arma::vectorise(Msub)!=0.0))
+              blocks[index(iang,jang)]=Msub;
+          }
+      }
+
+      BlockMatrix::~BlockMatrix() {
+      }
+
+      size_t BlockMatrix::index(size_t iang, size_t jang) const {
+#ifndef ARMA_NO_DEBUG
+        if(iang>=Nang || jang>=Nang) {
+          std::ostringstream oss;
+          oss << "Block (" << iang << "," << jang << ") requested but matrix only has " << Nang << " x " << Nang << " blocks!\n";
+          throw std::logic_error(oss.str());
+        }
+#endif
+        return iang*Nang+jang;
+      }
+
+      size_t BlockMatrix::get_Nang() const {
+        return Nang;
+      }
+
+      size_t BlockMatrix::get_Nrad() const {
+        return Nrad;
+      }
+
+      bool BlockMatrix::has_block(size_t iang, size_t jang) const {
+        return blocks[index(iang,jang)].n_elem>0;
+      }
+
+      arma::mat & BlockMatrix::block(size_t iang, size_t jang) {
+        arma::mat & blk(blocks[index(iang,jang)]);
+        if(!blk.n_elem)
+          blk.zeros(Nrad,Nrad);
+        return blk;
+      }
+
+      arma::mat BlockMatrix::get_block(size_t iang, size_t jang) const {
+        const arma::mat & blk(blocks[index(iang,jang)]);
+        if(blk.n_elem)
+          return blk;
+        else
+          return arma::zeros<arma::mat>(Nrad,Nrad);
+      }
+
+      const arma::mat & BlockMatrix::at(size_t iang, size_t jang) const {
+        const arma::mat & blk(blocks[index(iang,jang)]);
+        if(!blk.n_elem) {
+          std::ostringstream oss;
+          oss << "Block (" << iang << "," << jang << ") is not stored!\n";
+          throw std::logic_error(oss.str());
+        }
+        return blk;
+      }
+
+      void BlockMatrix::set_block(size_t iang, size_t jang, const arma::mat & M) {
+        blocks[index(iang,jang)]=M;
+      }
+
+      void BlockMatrix::add_block(size_t iang, size_t jang, const arma::mat & M) {
+        block(iang,jang)+=M;
+      }
+
+      size_t BlockMatrix::stored_blocks() const {
+        size_t n=0;
+        for(size_t i=0;i<blocks.size();i++)
+          if(blocks[i].n_elem)
+            n++;
+        return n;
+      }
+
+      size_t BlockMatrix::memory() const {
+        return stored_blocks()*Nrad*Nrad*sizeof(double);
+      }
+
+      arma::mat BlockMatrix::dense() const {
+        arma::mat M(Nang*Nrad,Nang*Nrad,arma::fill::zeros);
+        for(size_t iang=0;iang<Nang;iang++)
+          for(size_t jang=0;jang<Nang;jang++) {
+            const arma::mat & blk(blocks[index(iang,jang)]);
+            if(blk.n_elem)
+              M.submat(iang*Nrad,jang*Nrad,(iang+1)*Nrad-1,(jang+1)*Nrad-1)=blk;
+          }
+        return M;
+      }
+
+      arma::mat BlockMatrix::norms() const {
+        arma::mat N(Nang,Nang,arma::fill::zeros);
+        for(size_t iang=0;iang<Nang;iang++)
+          for(size_t jang=0;jang<Nang;jang++) {
+            const arma::mat & blk(blocks[index(iang,jang)]);
+            if(blk.n_elem)
+              N(iang,jang)=arma::norm(blk,"fro");
+          }
+        return N;
+      }
+
+      double BlockMatrix::trace_product(const BlockMatrix & rh) const {
+        if(rh.Nang != Nang || rh.Nrad != Nrad)
+          throw std::logic_error("Incompatible block matrices!\n");
+        // tr(A*B) = sum_{ij} A_ij . B_ji^T, which only gets
+        // contributions from blocks stored in both matrices
+        double tr=0.0;
+        for(size_t iang=0;iang<Nang;iang++)
+          for(size_t jang=0;jang<Nang;jang++) {
+            const arma::mat & lblk(blocks[index(iang,jang)]);
+            const arma::mat & rblk(rh.blocks[index(jang,iang)]);
+            if(lblk.n_elem && rblk.n_elem)
+              tr+=arma::accu(lblk%rblk.t());
+          }
+        return tr;
+      }
+
+      BlockMatrix & BlockMatrix::operator+=(const BlockMatrix & rh) {
+        if(rh.Nang != Nang || rh.Nrad != Nrad)
+          throw std::logic_error("Incompatible block matrices!\n");
+        for(size_t i=0;i<blocks.size();i++)
+          if(rh.blocks[i].n_elem) {
+            if(blocks[i].n_elem)
+              blocks[i]+=rh.blocks[i];
+            else
+              blocks[i]=rh.blocks[i];
+          }
+        return *this;
+      }
+
+      BlockMatrix & BlockMatrix::operator-=(const BlockMatrix & rh) {
+        if(rh.Nang != Nang || rh.Nrad != Nrad)
+          throw std::logic_error("Incompatible block matrices!\n");
+        for(size_t i=0;i<blocks.size();i++)
+          if(rh.blocks[i].n_elem) {
+            if(blocks[i].n_elem)
+              blocks[i]-=rh.blocks[i];
+            else
+              blocks[i]=-rh.blocks[i];
+          }
+        return *this;
+      }
+
+      BlockMatrix & BlockMatrix::operator*=(double fac) {
+        for(size_t i=0;i<blocks.size();i++)
+          if(blocks[i].n_elem)
+            blocks[i]*=fac;
+        return *this;
+      }
+
+      BlockMatrix operator+(const BlockMatrix & lh, const BlockMatrix & rh) {
+        BlockMatrix M(lh);
+        M+=rh;
+        return M;
+      }
+
+      BlockMatrix operator*(double fac, const BlockMatrix & M) {
+        BlockMatrix R(M);
+        R*=fac;
+        return R;
+      }
+    }
+  }
+}
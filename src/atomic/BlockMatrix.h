@@ -0,0 +1,97 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#ifndef ATOMIC_BLOCKMATRIX_H
+#define ATOMIC_BLOCKMATRIX_H
+
+#include <armadillo>
+#include <vector>
+
+namespace helfem {
+  namespace atomic {
+    namespace basis {
+      /**
+       * Block-sparse matrix in the angular basis. The matrix is
+       * composed of Nang x Nang radial blocks of size Nrad x Nrad, of
+       * which only the ones that have been touched are stored.
+       */
+      class BlockMatrix {
+        /// Number of angular blocks
+        size_t Nang;
+        /// Size of a radial block
+        size_t Nrad;
+        /// Blocks; (iang,jang) is stored at iang*Nang+jang, and empty blocks are zero
+        std::vector<arma::mat> blocks;
+
+        /// Index of block
+        size_t index(size_t iang, size_t jang) const;
+
+      public:
+        /// Dummy constructor
+        BlockMatrix();
+        /// Constructor for zero matrix
+        BlockMatrix(size_t Nang, size_t Nrad);
+        /// Constructor from a dense matrix; blocks that are exactly zero are not stored
+        BlockMatrix(const arma::mat & M, size_t Nang, size_t Nrad);
+        /// Destructor
+        ~BlockMatrix();
+
+        /// Number of angular blocks
+        size_t get_Nang() const;
+        /// Size of a radial block
+        size_t get_Nrad() const;
+
+        /// Is the block stored?
+        bool has_block(size_t iang, size_t jang) const;
+        /// Access block, allocating it as zero if it is not stored. Distinct blocks can be accessed from several threads.
+        arma::mat & block(size_t iang, size_t jang);
+        /// Get block, which is zero if not stored
+        arma::mat get_block(size_t iang, size_t jang) const;
+        /// Access a stored block; throws if the block is not stored
+        const arma::mat & at(size_t iang, size_t jang) const;
+        /// Set block
+        void set_block(size_t iang, size_t jang, const arma::mat & M);
+        /// Add to block
+        void add_block(size_t iang, size_t jang, const arma::mat & M);
+
+        /// Number of stored blocks
+        size_t stored_blocks() const;
+        /// Memory used by the stored blocks
+        size_t memory() const;
+
+        /// Convert to dense matrix
+        arma::mat dense() const;
+        /// Frobenius norms of the blocks, zero for blocks that are not stored
+        arma::mat norms() const;
+        /// Computes tr(this*rh) without forming the dense matrices
+        double trace_product(const BlockMatrix & rh) const;
+
+        /// Add matrix
+        BlockMatrix & operator+=(const BlockMatrix & rh);
+        /// Subtract matrix
+        BlockMatrix & operator-=(const BlockMatrix & rh);
+        /// Scale matrix
+        BlockMatrix & operator*=(double fac);
+      };
+
+      /// Sum of two matrices
+      BlockMatrix operator+(const BlockMatrix & lh, const BlockMatrix & rh);
+      /// Scaled matrix
+      BlockMatrix operator*(double fac, const BlockMatrix & M);
+    }
+  }
+}
+
+#endif
@@ -22,6 +22,8 @@
 #include "../general/gaunt.h"
 #include "utils.h"
 #include "../general/scf_helpers.h"
+#include "../general/integralcache.h"
+#include <algorithm>
 #include <cassert>
 #include <cfloat>
 #include <helfem.h>
@@ -33,7 +35,7 @@
 namespace helfem {
   namespace atomic {
     namespace basis {
-      TwoDBasis::TwoDBasis() {
+      TwoDBasis::TwoDBasis() : rs_thresh(0.0), single_tei(false), kscreen(0.0), batch_exchange(true) {
       }
 
       TwoDBasis::TwoDBasis(int Z_, modelpotential::nuclear_model_t model_, double Rrms_, const polynomial_basis::PolynomialBasis * poly, int n_quad, const arma::vec & bval, const arma::ivec & lval_, const arma::ivec & mval_, int Zl_, int Zr_, double Rhalf_) {
@@ -51,6 +53,113 @@ namespace helfem {
         // Construct angular basis
         lval=lval_;
         mval=mval_;
+
+        // Angular couplings
+        form_coupling_plan();
+        rs_thresh=0.0;
+        single_tei=false;
+        batch_exchange=true;
+        // No screening by default
+        kscreen=0.0;
+      }
+
+      bool operator<(const angular_coupling_t & lh, const angular_coupling_t & rh) {
+        if(lh.L < rh.L)
+          return true;
+        if(lh.L > rh.L)
+          return false;
+
+        if(lh.M < rh.M)
+          return true;
+        if(lh.M > rh.M)
+          return false;
+
+        return lh.iang < rh.iang;
+      }
+
+      void TwoDBasis::form_coupling_plan() {
+        // Maximal M value
+        Mmax=arma::max(mval)-arma::min(mval);
+
+        // Gaunt coefficient table
+        int gmax(std::max(arma::max(lval),arma::max(mval)));
+        gaunt::Gaunt gaunt(gmax,2*gmax,gmax);
+
+        cplplan.clear();
+        cplplan.resize(lval.n_elem);
+        for(size_t iang=0;iang<lval.n_elem;iang++) {
+          int li(lval(iang));
+          int mi(mval(iang));
+          for(size_t jang=0;jang<lval.n_elem;jang++) {
+            int lj(lval(jang));
+            int mj(mval(jang));
+
+            // M value of the coupling
+            int M(mi-mj);
+            // Loop over possible couplings
+            int Lmin=std::max(std::abs(li-lj),std::abs(M));
+            int Lmax=li+lj;
+            for(int L=Lmin;L<=Lmax;L++) {
+              angular_coupling_t c;
+              c.iang=jang;
+              c.L=L;
+              c.M=M;
+              c.cpl=gaunt.coeff(li,mi,L,M,lj,mj);
+              if(c.cpl!=0.0)
+                cplplan[iang].push_back(c);
+            }
+          }
+          std::sort(cplplan[iang].begin(),cplplan[iang].end());
+        }
+      }
+
+      void TwoDBasis::exchange_angular_sum(const BlockMatrix & P, const arma::mat & Pnorm, const arma::vec & Lfac, size_t jang, size_t kang, std::vector<arma::mat> & Rmat, std::vector<bool> & couple, arma::vec & Rbound) const {
+        // K(jk) couples to P(il) only through channels (L,M) shared by j and k
+        const std::vector<angular_coupling_t> & jplan(cplplan[jang]);
+        const std::vector<angular_coupling_t> & kplan(cplplan[kang]);
+
+        size_t jidx=0, kidx=0;
+        while(jidx<jplan.size() && kidx<kplan.size()) {
+          const angular_coupling_t & jc(jplan[jidx]);
+          const angular_coupling_t & kc(kplan[kidx]);
+          if(jc.L<kc.L || (jc.L==kc.L && jc.M<kc.M)) {
+            jidx++;
+            continue;
+          }
+          if(kc.L<jc.L || (kc.L==jc.L && kc.M<jc.M)) {
+            kidx++;
+            continue;
+          }
+
+          // Find the end of the (L,M) runs
+          int L(jc.L), M(jc.M);
+          size_t jend(jidx), kend(kidx);
+          while(jend<jplan.size() && jplan[jend].L==L && jplan[jend].M==M)
+            jend++;
+          while(kend<kplan.size() && kplan[kend].L==L && kplan[kend].M==M)
+            kend++;
+
+          for(size_t ij=jidx;ij<jend;ij++) {
+            size_t iang(jplan[ij].iang);
+            for(size_t ik=kidx;ik<kend;ik++) {
+              size_t lang(kplan[ik].iang);
+
+              // Do we have any density in this block? Blocks that
+              // are not stored have zero norm.
+              if(Pnorm(iang,lang)<10*DBL_EPSILON)
+                continue;
+
+              // Total coupling coefficient
+              double cpl(Lfac(L)*jplan[ij].cpl*kplan[ik].cpl);
+              Rmat[L]+=cpl*P.at(iang,lang);
+              Rbound(L)+=std::abs(cpl)*Pnorm(iang,lang);
+              couple[L]=true;
+            }
+          }
+
+          jidx=jend;
+          kidx=kend;
+        }
       }
 
       TwoDBasis::~TwoDBasis() {
@@ -203,9 +312,32 @@ namespace helfem {
         return idx;
       }
 
+      arma::mat TwoDBasis::expand_radial(const arma::mat & Mrad, int sym) const {
+        size_t Nrad(radial.Nbf());
+        if(Mrad.n_rows != Nrad || Mrad.n_cols != Nrad) {
+          std::ostringstream oss;
+          oss << "Radial matrix does not have expected size! Got " << Mrad.n_rows << " x " << Mrad.n_cols << ", expected " << Nrad << " x " << Nrad << "!\n";
+          throw std::logic_error(oss.str());
+        }
+
+        // The symmetry blocks consist of whole angular channels
+        std::vector<arma::uvec> midx(get_sym_idx(sym));
+        arma::mat M(Nbf(),Nbf(),arma::fill::zeros);
+        size_t ioff=0;
+        for(size_t i=0;i<midx.size();i++)
+          for(size_t ich=0;ich<midx[i].n_elem/Nrad;ich++) {
+            size_t irow(midx[i](ich*Nrad));
+            M.submat(irow,ioff,irow+Nrad-1,ioff+Nrad-1)=Mrad;
+            ioff+=Nrad;
+          }
+
+        return M;
+      }
+
       arma::mat TwoDBasis::Shalf(bool chol, int sym) const {
-        // Form overlap matrix
-        arma::mat S(overlap());
+        // The overlap is I_ang x S_rad, so only the radial overlap
+        // needs to be factorized
+        arma::mat S(radial.overlap().dense());
 
         // Get the basis function norms
         arma::vec bfnormlz(arma::pow(arma::diagvec(S),-0.5));
@@ -216,70 +348,45 @@ namespace helfem {
 
         if(chol && sym==0) {
           // Half-inverse is
-          return arma::diagmat(bfinvnormlz) * arma::chol(S);
+          return expand_radial(arma::diagmat(bfinvnormlz) * arma::chol(S), 0);
 
         } else {
+          // The square root is unique, so the symmetry blocking does not affect it
           arma::vec Sval;
           arma::mat Svec;
-          if(sym) {
-            // Symmetries
-            std::vector<arma::uvec> midx(get_sym_idx(sym));
-            scf::eig_sym_sub(Sval,Svec,S,midx);
-          } else {
-            if(!arma::eig_sym(Sval,Svec,S)) {
-              S.save("S.dat",arma::raw_ascii);
-              throw std::logic_error("Diagonalization of overlap matrix failed\n");
-            }
+          if(!arma::eig_sym(Sval,Svec,S)) {
+            S.save("S.dat",arma::raw_ascii);
+            throw std::logic_error("Diagonalization of overlap matrix failed\n");
           }
           printf("Smallest eigenvalue of overlap matrix is % e, condition number %e\n",Sval(0),Sval(Sval.n_elem-1)/Sval(0));
 
           arma::mat Shalf(Svec*arma::diagmat(arma::pow(Sval,0.5))*arma::trans(Svec));
           Shalf=arma::diagmat(bfinvnormlz)*Shalf;
 
-          return Shalf;
+          return expand_radial(Shalf, 0);
         }
       }
 
       arma::mat TwoDBasis::Sinvh(bool chol, int sym) const {
-        // Form overlap matrix
-        arma::mat S(overlap());
-
-        // Half-inverse is
-        if(sym==0) {
-          return scf::form_Sinvh(S,chol);
-        } else {
-          // Get basis function indices
-          std::vector<arma::uvec> midx(get_sym_idx(sym));
-          // Construct Sinvh in each subblock
-          arma::mat Sinvh(Nbf(),Nbf(),arma::fill::zeros);
-          size_t ioff=0;
-          for(size_t i=0;i<midx.size();i++) {
-            if(!midx[i].n_elem)
-              continue;
-
-            // Column indices
-            arma::uvec cidx(arma::linspace<arma::uvec>(ioff,ioff+midx[i].n_elem-1,midx[i].n_elem));
-            Sinvh(midx[i],cidx)=scf::form_Sinvh(S(midx[i],midx[i]),chol);
-            // Increment offset
-            ioff += midx[i].n_elem;
-          }
-          return Sinvh;
-        }
+        // The overlap is I_ang x S_rad, and every symmetry block
+        // consists of whole angular channels, so the half-inverse is
+        // formed from the radial overlap alone
+        return expand_radial(banded::invh(radial.overlap(),chol), sym);
       }
 
-      void TwoDBasis::set_sub(arma::mat & M, size_t iang, size_t jang, const arma::mat & Mrad) const {
-        M.submat(iang*radial.Nbf(),jang*radial.Nbf(),(iang+1)*radial.Nbf()-1,(jang+1)*radial.Nbf()-1)=Mrad;
+      void TwoDBasis::set_sub(BlockMatrix & M, size_t iang, size_t jang, const arma::mat & Mrad) const {
+        M.set_block(iang,jang,Mrad);
       }
 
-      void TwoDBasis::add_sub(arma::mat & M, size_t iang, size_t jang, const arma::mat & Mrad) const {
-        M.submat(iang*radial.Nbf(),jang*radial.Nbf(),(iang+1)*radial.Nbf()-1,(jang+1)*radial.Nbf()-1)+=Mrad;
+      void TwoDBasis::add_sub(BlockMatrix & M, size_t iang, size_t jang, const arma::mat & Mrad) const {
+        M.add_block(iang,jang,Mrad);
       }
 
       arma::mat TwoDBasis::get_sub(const arma::mat & M, size_t iang, size_t jang) const {
         return M.submat(iang*radial.Nbf(),jang*radial.Nbf(),(iang+1)*radial.Nbf()-1,(jang+1)*radial.Nbf()-1);
       }
 
-      arma::mat TwoDBasis::radial_integral(int Rexp) const {
+      BlockMatrix TwoDBasis::radial_integral_blocks(int Rexp) const {
         // Build radial elements
         size_t Nrad(radial.Nbf());
         arma::mat Orad(Nrad,Nrad);
@@ -294,13 +401,20 @@ namespace helfem {
         }
 
         // Full overlap matrix
-        arma::mat O(Ndummy(),Ndummy());
-        O.zeros();
+        BlockMatrix O(lval.n_elem,Nrad);
         // Fill elements
         for(size_t iang=0;iang<lval.n_elem;iang++)
           set_sub(O,iang,iang,Orad);
 
-        return remove_boundaries(O);
+        return O;
+      }
+
+      arma::mat TwoDBasis::radial_integral(int Rexp) const {
+        return to_dense(radial_integral_blocks(Rexp));
+      }
+
+      BlockMatrix TwoDBasis::overlap_blocks() const {
+        return radial_integral_blocks(0);
       }
 
       arma::mat TwoDBasis::overlap() const {
@@ -323,7 +437,7 @@ namespace helfem {
         return S;
       }
 
-      arma::mat TwoDBasis::kinetic() const {
+      BlockMatrix TwoDBasis::kinetic_blocks() const {
         // Build radial kinetic energy matrix
         size_t Nrad(radial.Nbf());
         arma::mat Trad(Nrad,Nrad);
@@ -341,8 +455,7 @@ namespace helfem {
         }
 
         // Full kinetic energy matrix
-        arma::mat T(Ndummy(),Ndummy());
-        T.zeros();
+        BlockMatrix T(lval.n_elem,Nrad);
         // Fill elements
         for(size_t iang=0;iang<lval.n_elem;iang++) {
           set_sub(T,iang,iang,Trad);
@@ -352,22 +465,25 @@ namespace helfem {
           }
         }
 
-        return remove_boundaries(T);
+        return T;
       }
 
-      arma::mat TwoDBasis::nuclear() const {
+      arma::mat TwoDBasis::kinetic() const {
+        return to_dense(kinetic_blocks());
+      }
+
+      BlockMatrix TwoDBasis::nuclear_blocks() const {
         if(model != modelpotential::POINT_NUCLEUS) {
           modelpotential::ModelPotential *pot=modelpotential::get_nuclear_model(model,Z,Rrms);
-          arma::mat Vnuc(model_potential(pot));
+          BlockMatrix Vnuc(model_potential_blocks(pot));
           delete pot;
           return Vnuc;
         } else {
           // Full nuclear attraction matrix
-          arma::mat V(Ndummy(),Ndummy());
-          V.zeros();
+          size_t Nrad(radial.Nbf());
+          BlockMatrix V(lval.n_elem,Nrad);
 
           if(Z!=0.0) {
-            size_t Nrad(radial.Nbf());
             arma::mat Vrad(Nrad,Nrad);
             Vrad.zeros();
             // Loop over elements
@@ -384,7 +500,6 @@ namespace helfem {
 
           if(Zl != 0.0 || Zr != 0.0) {
             // Auxiliary matrices
-            size_t Nrad(radial.Nbf());
             int Lmax(2*arma::max(lval));
             std::vector<arma::mat> Vaux(Lmax+1);
 #ifdef _OPENMP
@@ -431,16 +546,19 @@ namespace helfem {
             }
           }
 
-          return remove_boundaries(V);
+          return V;
         }
       }
 
-      arma::mat TwoDBasis::model_potential(const modelpotential::ModelPotential * pot) const {
-        // Full nuclear attraction matrix
-        arma::mat V(Ndummy(),Ndummy());
-        V.zeros();
+      arma::mat TwoDBasis::nuclear() const {
+        return to_dense(nuclear_blocks());
+      }
 
+      BlockMatrix TwoDBasis::model_potential_blocks(const modelpotential::ModelPotential * pot) const {
 	size_t Nrad(radial.Nbf());
+        // Full nuclear attraction matrix
+        BlockMatrix V(lval.n_elem,Nrad);
+
 	arma::mat Vrad(Nrad,Nrad);
 	Vrad.zeros();
 	// Loop over elements
@@ -454,18 +572,21 @@ namespace helfem {
 	for(size_t iang=0;iang<lval.n_elem;iang++)
 	  set_sub(V,iang,iang,Vrad);
 
-        return remove_boundaries(V);
+        return V;
       }
 
-      arma::mat TwoDBasis::dipole_z() const {
+      arma::mat TwoDBasis::model_potential(const modelpotential::ModelPotential * pot) const {
+        return to_dense(model_potential_blocks(pot));
+      }
+
+      BlockMatrix TwoDBasis::dipole_z_blocks() const {
         // Build radial elements
         size_t Nrad(radial.Nbf());
         arma::mat Orad(Nrad,Nrad);
         Orad.zeros();
 
         // Full electric couplings
-        arma::mat V(Ndummy(),Ndummy());
-        V.zeros();
+        BlockMatrix V(lval.n_elem,Nrad);
 
         // Loop over elements
         for(size_t iel=0;iel<radial.Nel();iel++) {
@@ -494,18 +615,21 @@ namespace helfem {
           }
         }
 
-        return remove_boundaries(V);
+        return V;
       }
 
-      arma::mat TwoDBasis::quadrupole_zz() const {
+      arma::mat TwoDBasis::dipole_z() const {
+        return to_dense(dipole_z_blocks());
+      }
+
+      BlockMatrix TwoDBasis::quadrupole_zz_blocks() const {
         // Build radial elements
         size_t Nrad(radial.Nbf());
         arma::mat Orad(Nrad,Nrad);
         Orad.zeros();
 
         // Full electric couplings
-        arma::mat V(Ndummy(),Ndummy());
-        V.zeros();
+        BlockMatrix V(lval.n_elem,Nrad);
 
         // Loop over elements
         for(size_t iel=0;iel<radial.Nel();iel++) {
@@ -537,10 +661,14 @@ namespace helfem {
           }
         }
 
-        return remove_boundaries(V);
+        return V;
       }
 
-      arma::mat TwoDBasis::Bz_field(double B) const {
+      arma::mat TwoDBasis::quadrupole_zz() const {
+        return to_dense(quadrupole_zz_blocks());
+      }
+
+      BlockMatrix TwoDBasis::Bz_field_blocks(double B) const {
         // Build radial elements
         size_t Nrad(radial.Nbf());
         arma::mat O0rad(Nrad,Nrad);
@@ -558,8 +686,7 @@ namespace helfem {
         }
 
         // Full coupling
-        arma::mat V(Ndummy(),Ndummy());
-        V.zeros();
+        BlockMatrix V(lval.n_elem,Nrad);
 
         int gmax(std::max(arma::max(lval),arma::max(mval)));
         gaunt::Gaunt gaunt(gmax,4,gmax);
@@ -585,7 +712,11 @@ namespace helfem {
           }
         }
 
-        return remove_boundaries(V);
+        return V;
+      }
+
+      arma::mat TwoDBasis::Bz_field(double B) const {
+        return to_dense(Bz_field_blocks(B));
       }
 
       size_t TwoDBasis::mem_1el() const {
@@ -603,91 +734,143 @@ namespace helfem {
       size_t TwoDBasis::mem_2el_aux() const {
         // Auxiliary integrals required up to
         size_t N_L(2*arma::max(lval)+1);
-        // Number of elements
-        size_t Nel(radial.Nel());
-        // Number of primitive functions per element
-        size_t Nprim(radial.max_Nprim());
+        // Number of primitive functions in the elements
+        std::vector<size_t> Nprim(radial.Nel());
+        for(size_t iel=0;iel<Nprim.size();iel++)
+          Nprim[iel]=radial.Nprim(iel);
+
+        // Only the in-element blocks are stored, and exchange reads the same integrals as Coulomb
+        return elementtei::ElementTEI::required_memory(N_L,Nprim,single_tei);
+      }
 
-        // Memory use is thus
-        //return 2*N_L*Nel*Nel*Nprim*Nprim*Nprim*Nprim*sizeof(double);
-        // No off-diagonal storage
-        return 2*N_L*Nel*Nprim*Nprim*Nprim*Nprim*sizeof(double);
+      void TwoDBasis::set_single_precision_tei(bool single) {
+        single_tei=single;
       }
 
+      void TwoDBasis::set_integral_cache(const std::string & dir) {
+        intcache=dir;
+      }
+
+      std::string TwoDBasis::integral_cache_key(const std::string & kind, double param, double thr) const {
+        // The primitive integrals only depend on the radial basis and
+        // the number of L channels
+        Fingerprint fp;
+        fp.add(kind);
+        fp.add(param);
+        fp.add(thr);
+        fp.add((int) (2*arma::max(lval)+1));
+        fp.add(radial.get_bval());
+        fp.add(radial.get_poly_id());
+        fp.add(radial.get_poly_order());
+        fp.add(radial.get_nquad());
+        return kind + "_" + fp.hex();
+      }
 
       void TwoDBasis::compute_tei(bool exchange) {
         // Number of distinct L values is
         size_t N_L(2*arma::max(lval)+1);
         size_t Nel(radial.Nel());
-
-        // Compute disjoint integrals
-        disjoint_L.resize(Nel*N_L);
-        disjoint_m1L.resize(Nel*N_L);
-        for(size_t L=0;L<N_L;L++)
+        // Number of primitive functions in the elements
+        std::vector<size_t> Nprim(Nel);
+        for(size_t iel=0;iel<Nel;iel++)
+          Nprim[iel]=radial.Nprim(iel);
+
+        // Cached integrals
+        std::vector<arma::mat> tei;
+        std::vector<std::string> names;
+        names.push_back("disjoint_L");
+        names.push_back("disjoint_m1L");
+        names.push_back("prim_tei");
+        std::vector< std::vector<arma::mat> * > sets;
+        sets.push_back(&disjoint_L);
+        sets.push_back(&disjoint_m1L);
+        sets.push_back(&tei);
+        std::string key(integral_cache_key("coulomb",0.0));
+        bool cached(intcache.size() && IntegralCache(intcache).load(key,names,sets));
+
+        prim_tei=elementtei::ElementTEI(N_L,Nprim);
+        if(cached) {
+          prim_tei.set_blocks(tei);
+        } else {
+          // Compute disjoint integrals
+          disjoint_L.resize(Nel*N_L);
+          disjoint_m1L.resize(Nel*N_L);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
           for(size_t iel=0;iel<Nel;iel++) {
-            disjoint_L[L*Nel+iel]=radial.radial_integral(L,iel);
-            disjoint_m1L[L*Nel+iel]=radial.radial_integral(-L-1,iel);
+            // All L values at once
+            std::vector<arma::mat> rL, rm1L;
+            radial.multipole_integrals(N_L-1,iel,rL,rm1L);
+            for(size_t L=0;L<N_L;L++) {
+              disjoint_L[L*Nel+iel]=rL[L];
+              disjoint_m1L[L*Nel+iel]=rm1L[L];
+            }
           }
 
-        // Form two-electron integrals
-        prim_tei.resize(Nel*Nel*N_L);
+          // Form the in-element two-electron integrals from the
+          // reference element operators; the integrals between
+          // different elements are contracted in factorized form
+          radial.tabulate_twoe(N_L-1);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
 #endif
-        for(size_t L=0;L<N_L;L++) {
-          for(size_t iel=0;iel<Nel;iel++) {
-            // In-element integral
-            prim_tei[Nel*Nel*L + iel*Nel + iel]=radial.twoe_integral(L,iel);
-
-            /*
-              for(size_t jel=0;jel<Nel;jel++) {
-	      // Disjoint integrals. When r(iel)>r(jel), iel gets -1-L, jel gets L.
-	      const arma::mat & iint=(iel>jel) ? disjoint_m1L[L*Nel+iel] : disjoint_L[L*Nel+iel];
-	      const arma::mat & jint=(iel>jel) ? disjoint_L[L*Nel+jel] : disjoint_m1L[L*Nel+jel];
+          for(size_t L=0;L<N_L;L++)
+            for(size_t iel=0;iel<Nel;iel++)
+              prim_tei.set_block(L,iel,radial.twoe_integral(L,iel));
 
-	      // Store integrals
-	      prim_tei[Nel*Nel*L + iel*Nel + jel]=utils::product_tei(iint,jint);
-              }
-              }
-            */
+          // Store in cache
+          if(intcache.size()) {
+            tei=prim_tei.get_blocks();
+            IntegralCache(intcache).save(key,names,std::vector< const std::vector<arma::mat> * >(sets.begin(),sets.end()));
           }
         }
 
-        /*
-          The exchange matrix is given by
-          K(jk) = (ij|kl) P(il)
-          i.e. the complex conjugation hits i and l as
-          in the density matrix.
+        // Integral norms for screening. The exchange contractions read
+        // the Coulomb ordered integrals in permuted order, which does
+        // not change the norms.
+        disjoint_L_norm=integral_norms(disjoint_L,Nel);
+        disjoint_m1L_norm=integral_norms(disjoint_m1L,Nel);
+        prim_tei_norm.reset();
+        if(exchange)
+          prim_tei_norm=prim_tei.norms();
+
+        // Switch to single precision storage
+        if(single_tei)
+          prim_tei.convert_to_single();
+      }
 
-          To get this in the proper order, we permute the integrals
-          K(jk) = (jk;il) P(il)
-          so we don't have to reform the permutations in the exchange routine.
-        */
-        if(exchange) {
-          prim_ktei.resize(Nel*Nel*N_L);
-#ifdef _OPENMP
-#pragma omp parallel for collapse(2)
-#endif
-          for(size_t L=0;L<N_L;L++)
-            for(size_t iel=0;iel<Nel;iel++) {
-              // Diagonal integrals
-              size_t Ni(radial.Nprim(iel));
-              prim_ktei[Nel*Nel*L + iel*Nel + iel]=utils::exchange_tei(prim_tei[Nel*Nel*L + iel*Nel + iel],Ni,Ni,Ni,Ni);
+      void TwoDBasis::set_erfc_screening(double thr) {
+        rs_thresh=thr;
+      }
 
-              // Off-diagonal integrals (not used since faster to contract
-              // the integrals in factorized form)
+      void TwoDBasis::form_rs_pairs(bool diagonal) {
+        size_t Nel(radial.Nel());
+        arma::vec bval(radial.get_bval());
+
+        rs_pair_ofs.assign(Nel+1,0);
+        rs_pair_jel.clear();
+        for(size_t iel=0;iel<Nel;iel++) {
+          rs_pair_ofs[iel]=rs_pair_jel.size();
+          for(size_t jel=0;jel<Nel;jel++) {
+            if(diagonal && jel!=iel)
+              continue;
+            if(!diagonal && rs_thresh>0.0) {
               /*
-                for(size_t jel=0;jel<iel;jel++) {
-                size_t Nj(radial.Nprim(jel));
-                prim_ktei[Nel*Nel*L + iel*Nel + jel]=utils::exchange_tei(prim_tei[Nel*Nel*L + iel*Nel + jel],Ni,Ni,Nj,Nj);
-                }
-                for(size_t jel=iel+1;jel<Nel;jel++) {
-                size_t Nj(radial.Nprim(jel));
-                prim_ktei[Nel*Nel*L + iel*Nel + jel]=utils::exchange_tei(prim_tei[Nel*Nel*L + iel*Nel + jel],Ni,Ni,Nj,Nj);
-                }
+                The short-range kernel is bounded by erfc(mu*d)/d,
+                where d is the gap between the elements, i.e. it is
+                suppressed by erfc(mu*d) relative to the Coulomb
+                kernel. Pairs where the suppression exceeds the
+                threshold are left out.
               */
+              double d((jel>iel) ? bval(jel)-bval(iel+1) : bval(iel)-bval(jel+1));
+              if(d>0.0 && erfc(lambda*d)<rs_thresh)
+                continue;
             }
+            rs_pair_jel.push_back(jel);
+          }
         }
+        rs_pair_ofs[Nel]=rs_pair_jel.size();
       }
 
       void TwoDBasis::compute_yukawa(double lambda_) {
@@ -698,14 +881,39 @@ namespace helfem {
         size_t N_L(2*arma::max(lval)+1);
         size_t Nel(radial.Nel());
 
-        // Compute disjoint integrals
-        disjoint_iL.resize(Nel*N_L);
-        disjoint_kL.resize(Nel*N_L);
-        for(size_t L=0;L<N_L;L++)
+        // Cached integrals
+        std::vector<std::string> names;
+        names.push_back("disjoint_iL");
+        names.push_back("disjoint_kL");
+        names.push_back("rs_ktei");
+        std::vector< std::vector<arma::mat> * > sets;
+        sets.push_back(&disjoint_iL);
+        sets.push_back(&disjoint_kL);
+        sets.push_back(&rs_ktei);
+        std::string key(integral_cache_key("yukawa",lambda));
+        bool cached(intcache.size() && IntegralCache(intcache).load(key,names,sets));
+
+        // Only the in-element integrals are stored, the rest factorize
+        form_rs_pairs(true);
+        size_t Npair(rs_pair_jel.size());
+
+        if(!cached) {
+          // Compute disjoint integrals
+          disjoint_iL.resize(Nel*N_L);
+          disjoint_kL.resize(Nel*N_L);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
           for(size_t iel=0;iel<Nel;iel++) {
-            disjoint_iL[L*Nel+iel]=radial.bessel_il_integral(L,lambda,iel);
-            disjoint_kL[L*Nel+iel]=radial.bessel_kl_integral(L,lambda,iel);
+            // All L values at once
+            std::vector<arma::mat> iL, kL;
+            radial.bessel_integrals(N_L-1,lambda,iel,iL,kL);
+            for(size_t L=0;L<N_L;L++) {
+              disjoint_iL[L*Nel+iel]=iL[L];
+              disjoint_kL[L*Nel+iel]=kL[L];
+            }
           }
+        }
 
         /*
           The exchange matrix is given by
@@ -717,16 +925,33 @@ namespace helfem {
           K(jk) = (jk;il) P(il)
           so we don't have to reform the permutations in the exchange routine.
         */
-        rs_ktei.resize(Nel*Nel*N_L);
+        if(!cached) {
+          rs_ktei.clear();
+          rs_ktei.resize(Npair*N_L);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
 #endif
-        for(size_t L=0;L<N_L;L++)
-          for(size_t iel=0;iel<Nel;iel++) {
-            // Diagonal integrals
-            size_t Ni(radial.Nprim(iel));
-            rs_ktei[Nel*Nel*L + iel*Nel + iel]=utils::exchange_tei(radial.yukawa_integral(L,lambda,iel),Ni,Ni,Ni,Ni);
-          }
+          for(size_t L=0;L<N_L;L++)
+            for(size_t iel=0;iel<Nel;iel++) {
+              // Diagonal integrals
+              size_t Ni(radial.Nprim(iel));
+              rs_ktei[Npair*L + rs_pair_ofs[iel]]=utils::exchange_tei(radial.yukawa_integral(L,lambda,iel),Ni,Ni,Ni,Ni);
+            }
+
+          // Store in cache
+          if(intcache.size())
+            IntegralCache(intcache).save(key,names,std::vector< const std::vector<arma::mat> * >(sets.begin(),sets.end()));
+        }
+
+        // Integral norms for screening
+        disjoint_iL_norm=integral_norms(disjoint_iL,Nel);
+        disjoint_kL_norm=integral_norms(disjoint_kL,Nel);
+        rs_ktei_norm=integral_norms(rs_ktei,Npair);
+
+        // Switch to single precision storage
+        rs_ktei_f.clear();
+        if(single_tei)
+          utils::convert_to_single(rs_ktei,rs_ktei_f);
       }
 
       void TwoDBasis::compute_erfc(double mu) {
@@ -751,43 +976,159 @@ namespace helfem {
           K(jk) = (jk;il) P(il)
           so we don't have to reform the permutations in the exchange routine.
         */
-        rs_ktei.resize(Nel*Nel*N_L);
+        // Element pairs that are close enough to interact
+        form_rs_pairs(false);
+        size_t Npair(rs_pair_jel.size());
+        // Element index of each pair
+        std::vector<size_t> rs_pair_iel(Npair);
+        for(size_t iel=0;iel<Nel;iel++)
+          for(size_t ip=rs_pair_ofs[iel];ip<rs_pair_ofs[iel+1];ip++)
+            rs_pair_iel[ip]=iel;
+
+        std::vector<std::string> names(1,"rs_ktei");
+        std::vector< std::vector<arma::mat> * > sets(1,&rs_ktei);
+        std::string key(integral_cache_key("erfc",lambda,rs_thresh));
+        bool cached(intcache.size() && IntegralCache(intcache).load(key,names,sets));
+        if(!cached) {
+          // Tabulate the kernel expansion, shared by all element pairs
+          radial.tabulate_erfc(N_L-1,lambda);
+
+          rs_ktei.clear();
+          rs_ktei.resize(Npair*N_L);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
 #endif
-        for(size_t L=0;L<N_L;L++)
-          for(size_t iel=0;iel<Nel;iel++) {
-            for(size_t kel=0;kel<Nel;kel++) {
-              // Diagonal integrals
+          for(size_t L=0;L<N_L;L++)
+            for(size_t ip=0;ip<Npair;ip++) {
+              size_t iel(rs_pair_iel[ip]);
+              size_t kel(rs_pair_jel[ip]);
               size_t Ni(radial.Nprim(iel));
               size_t Nk(radial.Nprim(kel));
-              rs_ktei[Nel*Nel*L + iel*Nel + kel]=utils::exchange_tei(radial.erfc_integral(L,lambda,iel,kel),Ni,Ni,Nk,Nk);
+              rs_ktei[Npair*L + ip]=utils::exchange_tei(radial.erfc_integral(L,lambda,iel,kel),Ni,Ni,Nk,Nk);
             }
+
+          // Store in cache
+          if(intcache.size())
+            IntegralCache(intcache).save(key,names,std::vector< const std::vector<arma::mat> * >(sets.begin(),sets.end()));
+        }
+
+        // Integral norms for screening
+        disjoint_iL_norm.clear();
+        disjoint_kL_norm.clear();
+        rs_ktei_norm=integral_norms(rs_ktei,Npair);
+
+        // Switch to single precision storage
+        rs_ktei_f.clear();
+        if(single_tei)
+          utils::convert_to_single(rs_ktei,rs_ktei_f);
+      }
+
+      arma::mat TwoDBasis::integral_norms(const std::vector<arma::mat> & ints, size_t N) const {
+        arma::mat norms(N,ints.size()/N,arma::fill::zeros);
+        for(size_t i=0;i<ints.size();i++)
+          if(ints[i].n_elem)
+            norms(i%N,i/N)=arma::norm(ints[i],"fro");
+        return norms;
+      }
+
+      void TwoDBasis::set_exchange_screening(double thr) {
+        kscreen=thr;
+      }
+
+      void TwoDBasis::disjoint_pair_bounds(const arma::mat & inner_norm, const arma::mat & outer_norm, size_t L, double & maxbound, double & sumbound) const {
+        size_t Nel(radial.Nel());
+        maxbound=0.0;
+        sumbound=0.0;
+        for(size_t iel=0;iel<Nel;iel++)
+          for(size_t jel=0;jel<Nel;jel++) {
+            if(iel==jel)
+              continue;
+            // Same bound as for the individual pairs
+            double bound((iel>jel) ? outer_norm(iel,L)*inner_norm(jel,L) : inner_norm(iel,L)*outer_norm(jel,L));
+            maxbound=std::max(maxbound,bound);
+            sumbound+=bound;
           }
       }
 
-      arma::mat TwoDBasis::coulomb(const arma::mat & P0) const {
-        if(!prim_tei.size())
-          throw std::logic_error("Primitive teis have not been computed!\n");
+      void TwoDBasis::set_batched_exchange(bool batch) {
+        batch_exchange=batch;
+      }
 
-        // Extend to boundaries
-        arma::mat P(expand_boundaries(P0));
+      arma::uvec TwoDBasis::element_offsets() const {
+        size_t Nel(radial.Nel());
+        arma::uvec elofs(Nel+1);
+        elofs(0)=0;
+        for(size_t iel=0;iel<Nel;iel++)
+          elofs(iel+1)=elofs(iel)+radial.Nprim(iel);
+        return elofs;
+      }
+
+      void TwoDBasis::disjoint_exchange(const std::vector<arma::mat> & inner, const std::vector<arma::mat> & outer, size_t L, const arma::mat & R, const arma::uvec & elofs, arma::mat & T, arma::mat & Kexp) const {
+        size_t Nel(radial.Nel());
+        size_t Nrad(radial.Nbf());
+        size_t Ntot(elofs(Nel));
+
+        /*
+          The element pair (iel,jel) contributes outer(iel) R(iel,jel)
+          inner(jel)^T for iel>jel, and inner(iel) R(iel,jel)
+          outer(jel)^T for iel<jel. Instead of a small product for
+          every pair, the columns are first contracted for all rows at
+          once, and the rows are then contracted for all columns at
+          once. The columns of T and Kexp are expanded so that every
+          element has its own functions; the row blocks of elements
+          before and after jel do not overlap.
+        */
+        for(size_t jel=0;jel<Nel;jel++) {
+          size_t jfirst, jlast;
+          radial.get_idx(jel,jfirst,jlast);
+
+          // Rows of elements after jel
+          if(jel+1<Nel) {
+            size_t afirst, alast;
+            radial.get_idx(jel+1,afirst,alast);
+            T.submat(afirst,elofs(jel),Nrad-1,elofs(jel+1)-1)=R.submat(afirst,jfirst,Nrad-1,jlast)*arma::trans(inner[L*Nel+jel]);
+          }
+          // Rows of elements before jel
+          if(jel>0) {
+            size_t bfirst, blast;
+            radial.get_idx(jel-1,bfirst,blast);
+            T.submat(0,elofs(jel),blast,elofs(jel+1)-1)=R.submat(0,jfirst,blast,jlast)*arma::trans(outer[L*Nel+jel]);
+          }
+        }
+
+        for(size_t iel=0;iel<Nel;iel++) {
+          size_t ifirst, ilast;
+          radial.get_idx(iel,ifirst,ilast);
+
+          // Columns of elements before iel
+          if(iel>0)
+            Kexp.submat(ifirst,0,ilast,elofs(iel)-1)+=outer[L*Nel+iel]*T.submat(ifirst,0,ilast,elofs(iel)-1);
+          // Columns of elements after iel
+          if(iel+1<Nel)
+            Kexp.submat(ifirst,elofs(iel+1),ilast,Ntot-1)+=inner[L*Nel+iel]*T.submat(ifirst,elofs(iel+1),ilast,Ntot-1);
+        }
+      }
+
+      arma::mat TwoDBasis::coulomb(const arma::mat & P) const {
+        return to_dense(coulomb_blocks(to_blocks(P)));
+      }
+
+      BlockMatrix TwoDBasis::coulomb_blocks(const BlockMatrix & P) const {
+        if(prim_tei.empty())
+          throw std::logic_error("Primitive teis have not been computed!\n");
 
         // Number of radial elements
         size_t Nel(radial.Nel());
         // Number of radial functions
         size_t Nrad(radial.Nbf());
-        // Gaunt coefficient table
-        int gmax(std::max(arma::max(lval),arma::max(mval)));
-        gaunt::Gaunt gaunt(gmax,2*gmax,gmax);
-
-        // maximal M value
-        int Mmax=arma::max(mval)-arma::min(mval);
 
         // Radial helper matrices
         std::vector< std::vector<arma::mat> > Paux(2*arma::max(lval)+1);
+        // Does the density have a component in the (L,M) channel?
+        std::vector< std::vector<bool> > Pchan(Paux.size());
         for(int L=0;L<(int) Paux.size();L++) {
           Paux[L].resize(2*Mmax+1);
+          Pchan[L].assign(2*Mmax+1,false);
           for(int M=-std::min(L,Mmax);M<=std::min(L,Mmax);M++) {
             Paux[L][M+Mmax].zeros(Nrad,Nrad);
           }
@@ -795,23 +1136,13 @@ namespace helfem {
 
         // Form radial helpers: contract ket
         for(size_t kang=0;kang<lval.n_elem;kang++) {
-          for(size_t lang=0;lang<lval.n_elem;lang++) {
-            // l and m values
-            int lk(lval(kang));
-            int mk(mval(kang));
-            int ll(lval(lang));
-            int ml(mval(lang));
-            // RH m value
-            int M(mk-ml);
-            // M values match. Loop over possible couplings
-            int Lmin=std::max(std::abs(lk-ll),abs(M));
-            int Lmax=lk+ll;
-            for(int L=Lmin;L<=Lmax;L++) {
-              // Calculate coupling coefficient
-              double cpl(gaunt.coeff(lk,mk,L,M,ll,ml));
-              // Increment
-              Paux[L][M+Mmax]+=cpl*P.submat(kang*Nrad,lang*Nrad,(kang+1)*Nrad-1,(lang+1)*Nrad-1);
-            }
+          for(size_t ic=0;ic<cplplan[kang].size();ic++) {
+            const angular_coupling_t & c(cplplan[kang][ic]);
+            size_t lang(c.iang);
+            if(!P.has_block(kang,lang))
+              continue;
+            Paux[c.L][c.M+Mmax]+=c.cpl*P.at(kang,lang);
+            Pchan[c.L][c.M+Mmax]=true;
           }
         }
 
@@ -828,6 +1159,8 @@ namespace helfem {
           const double Lfac=4.0*M_PI/(2*L+1);
 
           for(int M=-std::min(L,Mmax);M<=std::min(L,Mmax);M++) {
+            if(!Pchan[L][M+Mmax])
+              continue;
             for(size_t jel=0;jel<Nel;jel++) {
               size_t jfirst, jlast;
               radial.get_idx(jel,jfirst,jlast);
@@ -868,8 +1201,8 @@ namespace helfem {
                 // Contract integrals
                 Psub.reshape(Nj*Nj,1);
 
-                const size_t idx(Nel*Nel*L + iel*Nel + jel);
-                arma::mat Jsub(Lfac*(prim_tei[idx]*Psub));
+                arma::mat Jsub(Ni*Ni,1,arma::fill::zeros);
+                prim_tei.gemv(L,iel,Psub,Lfac,Jsub);
                 Jsub.reshape(Ni,Ni);
 
                 Jaux[L][M+Mmax].submat(ifirst,ifirst,ilast,ilast)+=Jsub;
@@ -878,53 +1211,51 @@ namespace helfem {
           }
         }
 
-        // Full Coulomb matrix
-        arma::mat J(Ndummy(),Ndummy());
-        J.zeros();
-        for(size_t iang=0;iang<lval.n_elem;iang++) {
-          for(size_t jang=0;jang<lval.n_elem;jang++) {
-            // l and m values
-            int li(lval(iang));
-            int mi(mval(iang));
-            int lj(lval(jang));
-            int mj(mval(jang));
-            // LH m value
-            int M(mj-mi);
-
-            int Lmin=std::max(std::abs(lj-li),abs(M));
-            int Lmax=lj+li;
-            for(int L=Lmin;L<=Lmax;L++) {
-              // Coupling
-              double cpl(gaunt.coeff(lj,mj,L,M,li,mi));
-              if(cpl!=0.0) {
-                J.submat(iang*Nrad,jang*Nrad,(iang+1)*Nrad-1,(jang+1)*Nrad-1)+=cpl*Jaux[L][M+Mmax];
-              }
-            }
+        // Full Coulomb matrix; only the blocks coupled to channels
+        // carrying density are stored
+        BlockMatrix J(lval.n_elem,Nrad);
+        for(size_t jang=0;jang<lval.n_elem;jang++) {
+          for(size_t ic=0;ic<cplplan[jang].size();ic++) {
+            const angular_coupling_t & c(cplplan[jang][ic]);
+            if(!Pchan[c.L][c.M+Mmax])
+              continue;
+            size_t iang(c.iang);
+            J.add_block(iang,jang,c.cpl*Jaux[c.L][c.M+Mmax]);
           }
         }
 
-        return remove_boundaries(J);
+        return J;
       }
 
-      arma::mat TwoDBasis::exchange(const arma::mat & P0) const {
-        if(!prim_ktei.size())
-          throw std::logic_error("Primitive teis have not been computed!\n");
+      arma::mat TwoDBasis::exchange(const arma::mat & P) const {
+        exchange_screening_t stats = {0, 0, 0.0};
+        return exchange(P,stats);
+      }
 
-        // Extend to boundaries
-        arma::mat P(expand_boundaries(P0));
+      arma::mat TwoDBasis::exchange(const arma::mat & P, exchange_screening_t & stats) const {
+        return to_dense(exchange_blocks(to_blocks(P),stats));
+      }
 
-        // Gaunt coefficient table
-        int gmax(std::max(arma::max(lval),arma::max(mval)));
-        gaunt::Gaunt gaunt(gmax,2*gmax,gmax);
+      BlockMatrix TwoDBasis::exchange_blocks(const BlockMatrix & P, exchange_screening_t & stats) const {
+        if(prim_tei.empty() || !prim_tei_norm.n_elem)
+          throw std::logic_error("Primitive teis have not been computed for exchange!\n");
+
+        // Density block norms
+        arma::mat Pnorm(P.norms());
 
         // Number of radial elements
         size_t Nel(radial.Nel());
         // Number of radial basis functions
         size_t Nrad(radial.Nbf());
+        // Number of coupling channels
+        size_t N_L(2*arma::max(lval)+1);
+        // L factors
+        arma::vec Lfac(N_L);
+        for(size_t L=0;L<N_L;L++)
+          Lfac(L)=4.0*M_PI/(2*L+1);
 
         // Full exchange matrix
-        arma::mat K(Ndummy(),Ndummy());
-        K.zeros();
+        BlockMatrix K(lval.n_elem,Nrad);
 
         // Helper memory
 #ifdef _OPENMP
@@ -936,8 +1267,16 @@ namespace helfem {
         std::vector<arma::vec> mem_Psub(nth);
         std::vector<arma::vec> mem_T(nth);
 
+        // Element offsets for the batched contractions
+        arma::uvec elofs(element_offsets());
+        bool batch(batch_exchange);
+
+        // Screening statistics
+        size_t nkcomp=0, nkskip=0;
+        double kerr=0.0;
+
 #ifdef _OPENMP
-#pragma omp parallel
+#pragma omp parallel reduction(+:nkcomp,nkskip,kerr)
 #endif
         {
 #ifdef _OPENMP
@@ -950,66 +1289,41 @@ namespace helfem {
           mem_Ksub[ith].zeros(radial.max_Nprim()*radial.max_Nprim());
           mem_T[ith].zeros(radial.max_Nprim()*radial.max_Nprim());
 
+          // Helpers for the batched contractions
+          arma::mat Tbat, Kbat;
+          if(batch) {
+            Tbat.zeros(Nrad,elofs(Nel));
+            Kbat.zeros(Nrad,elofs(Nel));
+          }
+
           // Increment
 #ifdef _OPENMP
 #pragma omp for collapse(2)
 #endif
           for(size_t jang=0;jang<lval.n_elem;jang++) {
             for(size_t kang=0;kang<lval.n_elem;kang++) {
-              int lj(lval(jang));
-              int mj(mval(jang));
-
-              int lk(lval(kang));
-              int mk(mval(kang));
-
               // Form radial helpers
-              size_t N_L(2*arma::max(lval)+1);
               std::vector<arma::mat> Rmat(N_L);
               for(size_t i=0;i<N_L;i++) {
                 Rmat[i].zeros(Nrad,Nrad);
               }
               // Is there a coupling to the channel?
               std::vector<bool> couple(N_L,false);
+              // Upper bound for the norm of the radial helpers
+              arma::vec Rbound(N_L,arma::fill::zeros);
 
               // Perform angular sums
-              for(size_t iang=0;iang<lval.n_elem;iang++) {
-                int li(lval(iang));
-                int mi(mval(iang));
-
-                for(size_t lang=0;lang<lval.n_elem;lang++) {
-                  int ll(lval(lang));
-                  int ml(mval(lang));
-
-                  // LH m value
-                  int M(mj-mi);
-                  // RH m value
-                  int Mp(mk-ml);
-                  if(M!=Mp)
-                    continue;
-
-                  // Do we have any density in this block?
-                  double bdens(arma::norm(P.submat(iang*Nrad,lang*Nrad,(iang+1)*Nrad-1,(lang+1)*Nrad-1),"fro"));
-                  //printf("(%i %i) (%i %i) density block norm %e\n",li,mi,ll,ml,bdens);
-                  if(bdens<10*DBL_EPSILON)
-                    continue;
-
-                  // M values match. Loop over possible couplings
-                  int Lmin=std::max(std::max(std::abs(li-lj),std::abs(lk-ll)),abs(M));
-                  int Lmax=std::min(li+lj,lk+ll);
-
-                  for(int L=Lmin;L<=Lmax;L++) {
-                    // Calculate total coupling coefficient
-                    double cpl(gaunt.coeff(lj,mj,L,M,li,mi)*gaunt.coeff(lk,mk,L,M,ll,ml));
-                    if(cpl==0.0)
-                      continue;
-
-                    // L factor
-                    double Lfac=4.0*M_PI/(2*L+1);
-                    Rmat[L]+=(Lfac*cpl)*P.submat(iang*Nrad,lang*Nrad,(iang+1)*Nrad-1,(lang+1)*Nrad-1);
-                    couple[L]=true;
-                  }
-                }
-              }
+              exchange_angular_sum(P,Pnorm,Lfac,jang,kang,Rmat,couple,Rbound);
+
+              // Block vanishes if there are no couplings
+              bool anycouple=false;
+              for(size_t L=0;L<N_L;L++)
+                anycouple = anycouple || couple[L];
+              if(!anycouple)
+                continue;
+              // Only the coupled blocks are allocated; every block is
+              // handled by a single thread
+              arma::mat & Kblk(K.block(jang,kang));
 
               // Loop over elements: output
               for(size_t iel=0;iel<Nel;iel++) {
@@ -1043,18 +1357,26 @@ namespace helfem {
                     for(size_t L=0;L<N_L;L++) {
                       if(!couple[L])
                         continue;
-                      Ksub+=prim_ktei[Nel*Nel*L + iel*Nel + jel]*arma::vectorise(Rmat[L].submat(ifirst,jfirst,ilast,jlast));
+                      // Screen contribution
+                      double bound(Rbound(L)*prim_tei_norm(iel,L));
+                      if(bound<kscreen) {
+                        nkskip++;
+                        kerr+=bound;
+                        continue;
+                      }
+                      nkcomp++;
+                      prim_tei.exchange_gemv(L,iel,arma::vectorise(Rmat[L].submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
                     }
                     Ksub.reshape(Ni,Nj);
 
                     // Increment global exchange matrix
-                    K.submat(jang*Nrad+ifirst,kang*Nrad+jfirst,jang*Nrad+ilast,kang*Nrad+jlast)-=Ksub;
+                    Kblk.submat(ifirst,jfirst,ilast,jlast)-=Ksub;
 
                     //arma::vec Ptgt(arma::vectorise(P.submat(jang*Nrad+ifirst,kang*Nrad+jfirst,jang*Nrad+ilast,kang*Nrad+jlast)));
                     //printf("(%i %i) (%i %i) (%i %i) (%i %i) [%i %i]\n",li,mi,lj,mj,lk,mk,ll,ml,L,M);
                     //printf("Element %i - %i contribution to exchange energy % .10e\n",(int) iel,(int) jel,-0.5*arma::dot(Ksub,Ptgt));
 
-                  } else {
+                  } else if(!batch) {
                     // Exchange submatrix
                     arma::mat Ksub(mem_Ksub[ith].memptr(),Ni,Nj,false,true);
                     Ksub.zeros();
@@ -1067,6 +1389,15 @@ namespace helfem {
                       const arma::mat & iint=(iel>jel) ? disjoint_m1L[L*Nel+iel] : disjoint_L[L*Nel+iel];
                       const arma::mat & jint=(iel>jel) ? disjoint_L[L*Nel+jel] : disjoint_m1L[L*Nel+jel];
 
+                      // Screen contribution
+                      double bound(Rbound(L)*((iel>jel) ? disjoint_m1L_norm(iel,L)*disjoint_L_norm(jel,L) : disjoint_L_norm(iel,L)*disjoint_m1L_norm(jel,L)));
+                      if(bound<kscreen) {
+                        nkskip++;
+                        kerr+=bound;
+                        continue;
+                      }
+                      nkcomp++;
+
                       // Get density submatrix (Niel x Njel)
                       arma::mat Psub(mem_Psub[ith].memptr(),Ni,Nj,false,true);
                       Psub=Rmat[L].submat(ifirst,jfirst,ilast,jlast);
@@ -1080,36 +1411,78 @@ namespace helfem {
                       Ksub+=iint*T;
                     }
 
-                    K.submat(jang*Nrad+ifirst,kang*Nrad+jfirst,jang*Nrad+ilast,kang*Nrad+jlast)-=Ksub;
+                    Kblk.submat(ifirst,jfirst,ilast,jlast)-=Ksub;
+                  }
+                }
+              }
+
+              if(batch) {
+                // Contributions from distinct elements
+                Kbat.zeros();
+                for(size_t L=0;L<N_L;L++) {
+                  if(!couple[L])
+                    continue;
+
+                  // The channel is skipped only if every element pair
+                  // would be skipped in the unbatched contraction
+                  double maxbound, sumbound;
+                  disjoint_pair_bounds(disjoint_L_norm,disjoint_m1L_norm,L,maxbound,sumbound);
+                  if(Rbound(L)*maxbound<kscreen) {
+                    nkskip+=Nel*(Nel-1);
+                    kerr+=Rbound(L)*sumbound;
+                    continue;
                   }
+                  nkcomp+=Nel*(Nel-1);
+                  disjoint_exchange(disjoint_L,disjoint_m1L,L,Rmat[L],elofs,Tbat,Kbat);
+                }
+                // Sum the expanded columns into the exchange matrix
+                for(size_t jel=0;jel<Nel;jel++) {
+                  size_t jfirst, jlast;
+                  radial.get_idx(jel,jfirst,jlast);
+                  Kblk.cols(jfirst,jlast)-=Kbat.cols(elofs(jel),elofs(jel+1)-1);
                 }
               }
             }
           }
         }
 
-        return remove_boundaries(K);
+        // Update screening statistics
+        stats.ncomp+=nkcomp;
+        stats.nskip+=nkskip;
+        stats.err+=kerr;
+
+        return K;
       }
 
-      arma::mat TwoDBasis::rs_exchange(const arma::mat & P0) const {
-        if(!rs_ktei.size())
-          throw std::logic_error("Primitive teis have not been computed!\n");
+      arma::mat TwoDBasis::rs_exchange(const arma::mat & P) const {
+        exchange_screening_t stats = {0, 0, 0.0};
+        return rs_exchange(P,stats);
+      }
 
-        // Extend to boundaries
-        arma::mat P(expand_boundaries(P0));
+      arma::mat TwoDBasis::rs_exchange(const arma::mat & P, exchange_screening_t & stats) const {
+        return to_dense(rs_exchange_blocks(to_blocks(P),stats));
+      }
 
-        // Gaunt coefficient table
-        int gmax(std::max(arma::max(lval),arma::max(mval)));
-        gaunt::Gaunt gaunt(gmax,2*gmax,gmax);
+      BlockMatrix TwoDBasis::rs_exchange_blocks(const BlockMatrix & P, exchange_screening_t & stats) const {
+        if(!rs_ktei.size() && !rs_ktei_f.size())
+          throw std::logic_error("Primitive teis have not been computed!\n");
+
+        // Density block norms
+        arma::mat Pnorm(P.norms());
 
         // Number of radial elements
         size_t Nel(radial.Nel());
         // Number of radial basis functions
         size_t Nrad(radial.Nbf());
+        // Number of coupling channels
+        size_t N_L(2*arma::max(lval)+1);
+        // L factors
+        arma::vec Lfac(N_L);
+        for(size_t L=0;L<N_L;L++)
+          Lfac(L)=yukawa ? 4.0*M_PI*lambda : 4.0*M_PI*lambda/(2*L+1);
 
         // Full exchange matrix
-        arma::mat K(Ndummy(),Ndummy());
-        K.zeros();
+        BlockMatrix K(lval.n_elem,Nrad);
 
         // Helper memory
 #ifdef _OPENMP
@@ -1121,8 +1494,19 @@ namespace helfem {
         std::vector<arma::vec> mem_Psub(nth);
         std::vector<arma::vec> mem_T(nth);
 
+        // Number of element pairs with stored integrals
+        size_t Npair(rs_pair_jel.size());
+
+        // Element offsets for the batched contractions
+        arma::uvec elofs(element_offsets());
+        bool batch(yukawa && batch_exchange);
+
+        // Screening statistics
+        size_t nkcomp=0, nkskip=0;
+        double kerr=0.0;
+
 #ifdef _OPENMP
-#pragma omp parallel
+#pragma omp parallel reduction(+:nkcomp,nkskip,kerr)
 #endif
         {
 #ifdef _OPENMP
@@ -1135,142 +1519,185 @@ namespace helfem {
           mem_Ksub[ith].zeros(radial.max_Nprim()*radial.max_Nprim());
           mem_T[ith].zeros(radial.max_Nprim()*radial.max_Nprim());
 
+          // Helpers for the batched contractions
+          arma::mat Tbat, Kbat;
+          if(batch) {
+            Tbat.zeros(Nrad,elofs(Nel));
+            Kbat.zeros(Nrad,elofs(Nel));
+          }
+
           // Increment
 #ifdef _OPENMP
 #pragma omp for collapse(2)
 #endif
           for(size_t jang=0;jang<lval.n_elem;jang++) {
             for(size_t kang=0;kang<lval.n_elem;kang++) {
-              int lj(lval(jang));
-              int mj(mval(jang));
-
-              int lk(lval(kang));
-              int mk(mval(kang));
-
               // Form radial helpers
-              size_t N_L(2*arma::max(lval)+1);
               std::vector<arma::mat> Rmat(N_L);
               for(size_t i=0;i<N_L;i++) {
                 Rmat[i].zeros(Nrad,Nrad);
               }
               // Is there a coupling to the channel?
               std::vector<bool> couple(N_L,false);
+              // Upper bound for the norm of the radial helpers
+              arma::vec Rbound(N_L,arma::fill::zeros);
 
               // Perform angular sums
-              for(size_t iang=0;iang<lval.n_elem;iang++) {
-                int li(lval(iang));
-                int mi(mval(iang));
+              exchange_angular_sum(P,Pnorm,Lfac,jang,kang,Rmat,couple,Rbound);
+
+              // Block vanishes if there are no couplings
+              bool anycouple=false;
+              for(size_t L=0;L<N_L;L++)
+                anycouple = anycouple || couple[L];
+              if(!anycouple)
+                continue;
+              // Only the coupled blocks are allocated; every block is
+              // handled by a single thread
+              arma::mat & Kblk(K.block(jang,kang));
+
+              // Loop over elements: output
+              for(size_t iel=0;iel<Nel;iel++) {
+                size_t ifirst, ilast;
+                radial.get_idx(iel,ifirst,ilast);
+                // Number of functions in the element
+                size_t Ni(ilast-ifirst+1);
 
-                for(size_t lang=0;lang<lval.n_elem;lang++) {
-                  int ll(lval(lang));
-                  int ml(mval(lang));
+                // Input: element pairs with stored integrals; the
+                // error function does not factorize
+                for(size_t ip=rs_pair_ofs[iel];ip<rs_pair_ofs[iel+1];ip++) {
+                  size_t jel(rs_pair_jel[ip]);
+                  size_t jfirst, jlast;
+                  radial.get_idx(jel,jfirst,jlast);
+                  size_t Nj(jlast-jfirst+1);
 
-                  // LH m value
-                  int M(mj-mi);
-                  // RH m value
-                  int Mp(mk-ml);
-                  if(M!=Mp)
-                    continue;
+                  /*
+                    The exchange matrix is given by
+                    K(jk) = (ij|kl) P(il)
+                    i.e. the complex conjugation hits i and l as
+                    in the density matrix.
 
-                  // Do we have any density in this block?
-                  double bdens(arma::norm(P.submat(iang*Nrad,lang*Nrad,(iang+1)*Nrad-1,(lang+1)*Nrad-1),"fro"));
-                  //printf("(%i %i) (%i %i) density block norm %e\n",li,mi,ll,ml,bdens);
-                  if(bdens<10*DBL_EPSILON)
-                    continue;
+                    To get this in the proper order, we permute the integrals
+                    K(jk) = (jk;il) P(il)
+                  */
 
-                  // M values match. Loop over possible couplings
-                  int Lmin=std::max(std::max(std::abs(li-lj),std::abs(lk-ll)),abs(M));
-                  int Lmax=std::min(li+lj,lk+ll);
+                  // Exchange submatrix
+                  arma::mat Ksub(mem_Ksub[ith].memptr(),Ni*Nj,1,false,true);
+                  Ksub.zeros();
 
-                  for(int L=Lmin;L<=Lmax;L++) {
-                    // Calculate total coupling coefficient
-                    double cpl(gaunt.coeff(lj,mj,L,M,li,mi)*gaunt.coeff(lk,mk,L,M,ll,ml));
-                    if(cpl==0.0)
+                  for(size_t L=0;L<N_L;L++) {
+                    if(!couple[L])
                       continue;
-
-                    // L factor
-                    double Lfac = yukawa ? 4.0*M_PI*lambda :  4.0*M_PI*lambda/(2*L+1);
-                    Rmat[L]+=(Lfac*cpl)*P.submat(iang*Nrad,lang*Nrad,(iang+1)*Nrad-1,(lang+1)*Nrad-1);
-                    couple[L]=true;
+                    // Screen contribution
+                    double bound(Rbound(L)*rs_ktei_norm(ip,L));
+                    if(bound<kscreen) {
+                      nkskip++;
+                      kerr+=bound;
+                      continue;
+                    }
+                    nkcomp++;
+                    if(rs_ktei_f.size())
+                      utils::mixed_gemv(rs_ktei_f[Npair*L + ip],arma::vectorise(Rmat[L].submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
+                    else
+                      Ksub+=rs_ktei[Npair*L + ip]*arma::vectorise(Rmat[L].submat(ifirst,jfirst,ilast,jlast));
                   }
-                }
-              }
+                  Ksub.reshape(Ni,Nj);
 
-              // Loop over elements: output
-              for(size_t iel=0;iel<Nel;iel++) {
-                size_t ifirst, ilast;
-                radial.get_idx(iel,ifirst,ilast);
+                  // Increment global exchange matrix
+                  Kblk.submat(ifirst,jfirst,ilast,jlast)-=Ksub;
+                }
 
-                // Input
+                // Input: distinct elements with factorized Yukawa integrals
+                if(!yukawa || batch)
+                  continue;
                 for(size_t jel=0;jel<Nel;jel++) {
+                  if(jel == iel)
+                    continue;
                   size_t jfirst, jlast;
                   radial.get_idx(jel,jfirst,jlast);
-
-                  // Number of functions in the two elements
-                  size_t Ni(ilast-ifirst+1);
                   size_t Nj(jlast-jfirst+1);
 
-                  // error function does not factorize
-                  if(!yukawa || iel == jel) {
-                    /*
-                      The exchange matrix is given by
-                      K(jk) = (ij|kl) P(il)
-                      i.e. the complex conjugation hits i and l as
-                      in the density matrix.
+                  // Exchange submatrix
+                  arma::mat Ksub(mem_Ksub[ith].memptr(),Ni,Nj,false,true);
+                  Ksub.zeros();
 
-                      To get this in the proper order, we permute the integrals
-                      K(jk) = (jk;il) P(il)
-                    */
+                  for(size_t L=0;L<N_L;L++) {
+                    if(!couple[L])
+                      continue;
 
-                    // Exchange submatrix
-                    arma::mat Ksub(mem_Ksub[ith].memptr(),Ni*Nj,1,false,true);
-                    Ksub.zeros();
+                    // Disjoint integrals. When r(iel)>r(jel), iel gets -1-L, jel gets L.
+                    const arma::mat & iint=(iel>jel) ? disjoint_kL[L*Nel+iel] : disjoint_iL[L*Nel+iel];
+                    const arma::mat & jint=(iel>jel) ? disjoint_iL[L*Nel+jel] : disjoint_kL[L*Nel+jel];
 
-                    for(size_t L=0;L<N_L;L++) {
-                      if(!couple[L])
-                        continue;
-                      Ksub+=rs_ktei[Nel*Nel*L + iel*Nel + jel]*arma::vectorise(Rmat[L].submat(ifirst,jfirst,ilast,jlast));
+                    // Screen contribution
+                    double bound(Rbound(L)*((iel>jel) ? disjoint_kL_norm(iel,L)*disjoint_iL_norm(jel,L) : disjoint_iL_norm(iel,L)*disjoint_kL_norm(jel,L)));
+                    if(bound<kscreen) {
+                      nkskip++;
+                      kerr+=bound;
+                      continue;
                     }
-                    Ksub.reshape(Ni,Nj);
+                    nkcomp++;
 
-                    // Increment global exchange matrix
-                    K.submat(jang*Nrad+ifirst,kang*Nrad+jfirst,jang*Nrad+ilast,kang*Nrad+jlast)-=Ksub;
+                    // Get density submatrix (Niel x Njel)
+                    arma::mat Psub(mem_Psub[ith].memptr(),Ni,Nj,false,true);
+                    Psub=Rmat[L].submat(ifirst,jfirst,ilast,jlast);
 
-                  } else {
-                    // Exchange submatrix
-                    arma::mat Ksub(mem_Ksub[ith].memptr(),Ni,Nj,false,true);
-                    Ksub.zeros();
-
-                    for(size_t L=0;L<N_L;L++) {
-                      if(!couple[L])
-                        continue;
+                    // Calculate helper
+                    arma::mat T(mem_T[ith].memptr(),Ni,Nj,false,true);
+                    // (Niel x Njel) = (Niel x Njel) x (Njel x Njel)
+                    T=Psub*arma::trans(jint);
 
-                      // Disjoint integrals. When r(iel)>r(jel), iel gets -1-L, jel gets L.
-                      const arma::mat & iint=(iel>jel) ? disjoint_kL[L*Nel+iel] : disjoint_iL[L*Nel+iel];
-                      const arma::mat & jint=(iel>jel) ? disjoint_iL[L*Nel+jel] : disjoint_kL[L*Nel+jel];
-
-                      // Get density submatrix (Niel x Njel)
-                      arma::mat Psub(mem_Psub[ith].memptr(),Ni,Nj,false,true);
-                      Psub=Rmat[L].submat(ifirst,jfirst,ilast,jlast);
+                    // Increment
+                    Ksub+=iint*T;
+                  }
 
-                      // Calculate helper
-                      arma::mat T(mem_T[ith].memptr(),Ni,Nj,false,true);
-                      // (Niel x Njel) = (Niel x Njel) x (Njel x Njel)
-                      T=Psub*arma::trans(jint);
+                  Kblk.submat(ifirst,jfirst,ilast,jlast)-=Ksub;
+                }
+              }
 
-                      // Increment
-                      Ksub+=iint*T;
-                    }
+              if(batch) {
+                // Contributions from distinct elements
+                Kbat.zeros();
+                for(size_t L=0;L<N_L;L++) {
+                  if(!couple[L])
+                    continue;
 
-                    K.submat(jang*Nrad+ifirst,kang*Nrad+jfirst,jang*Nrad+ilast,kang*Nrad+jlast)-=Ksub;
+                  // The channel is skipped only if every element pair
+                  // would be skipped in the unbatched contraction
+                  double maxbound, sumbound;
+                  disjoint_pair_bounds(disjoint_iL_norm,disjoint_kL_norm,L,maxbound,sumbound);
+                  if(Rbound(L)*maxbound<kscreen) {
+                    nkskip+=Nel*(Nel-1);
+                    kerr+=Rbound(L)*sumbound;
+                    continue;
                   }
+                  nkcomp+=Nel*(Nel-1);
+                  disjoint_exchange(disjoint_iL,disjoint_kL,L,Rmat[L],elofs,Tbat,Kbat);
+                }
+                // Sum the expanded columns into the exchange matrix
+                for(size_t jel=0;jel<Nel;jel++) {
+                  size_t jfirst, jlast;
+                  radial.get_idx(jel,jfirst,jlast);
+                  Kblk.cols(jfirst,jlast)-=Kbat.cols(elofs(jel),elofs(jel+1)-1);
                 }
               }
             }
           }
         }
 
-        return remove_boundaries(K);
+        // Update screening statistics
+        stats.ncomp+=nkcomp;
+        stats.nskip+=nkskip;
+        stats.err+=kerr;
+
+        return K;
+      }
+
+      BlockMatrix TwoDBasis::to_blocks(const arma::mat & M) const {
+        return BlockMatrix(expand_boundaries(M),lval.n_elem,radial.Nbf());
+      }
+
+      arma::mat TwoDBasis::to_dense(const BlockMatrix & M) const {
+        return remove_boundaries(M.dense());
       }
 
       arma::mat TwoDBasis::remove_boundaries(const arma::mat & Fnob) const {
@@ -1314,7 +1741,7 @@ namespace helfem {
       }
 
       std::vector<arma::mat> TwoDBasis::get_prim_tei() const {
-        return prim_tei;
+        return prim_tei.get_blocks();
       }
 
       arma::cx_mat TwoDBasis::eval_bf(size_t iel, double cth, double phi) const {
@@ -1324,7 +1751,7 @@ namespace helfem {
           sph(i)=::spherical_harmonics(lval(i),mval(i),cth,phi);
 
         // Evaluate radial functions
-        arma::mat rad(radial.get_bf(iel));
+        const arma::mat & rad(radial.get_bf(iel));
 
         // Form supermatrix
         arma::cx_mat bf(rad.n_rows,lval.n_elem*rad.n_cols);
@@ -1341,8 +1768,8 @@ namespace helfem {
           sph(i)=::spherical_harmonics(lval(i),mval(i),cth,phi);
 
         // Evaluate radial functions
-        arma::mat frad(radial.get_bf(iel));
-        arma::mat drad(radial.get_df(iel));
+        const arma::mat & frad(radial.get_bf(iel));
+        const arma::mat & drad(radial.get_df(iel));
 
         // Form supermatrices
         dr.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
@@ -1398,11 +1825,11 @@ namespace helfem {
         return radial.Nel();
       }
 
-      arma::vec TwoDBasis::get_wrad(size_t iel) const {
+      const arma::vec & TwoDBasis::get_wrad(size_t iel) const {
         return radial.get_wrad(iel);
       }
 
-      arma::vec TwoDBasis::get_r(size_t iel) const {
+      const arma::vec & TwoDBasis::get_r(size_t iel) const {
         return radial.get_r(iel);
       }
 
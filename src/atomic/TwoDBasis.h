@@ -21,10 +21,37 @@
 #include "../general/model_potential.h"
 #include "../general/sap.h"
 #include <helfem/RadialBasis.h>
+#include "../general/elementtei.h"
+#include "BlockMatrix.h"
 
 namespace helfem {
   namespace atomic {
     namespace basis {
+      /// Nonzero angular coupling of an angular function
+      typedef struct {
+        /// Index of the coupled angular function
+        size_t iang;
+        /// Coupling L value
+        int L;
+        /// Coupling M value
+        int M;
+        /// Gaunt coefficient
+        double cpl;
+      } angular_coupling_t;
+
+      /// Exchange screening statistics
+      typedef struct {
+        /// Number of computed (L, element pair) exchange blocks
+        size_t ncomp;
+        /// Number of skipped blocks
+        size_t nskip;
+        /// Sum of the bounds of the skipped blocks
+        double err;
+      } exchange_screening_t;
+
+      /// Sort couplings by (L,M)
+      bool operator<(const angular_coupling_t & lh, const angular_coupling_t & rh);
+
       /// Two-dimensional basis set
       class TwoDBasis {
         /// Nuclear charge
@@ -57,19 +84,59 @@ namespace helfem {
         std::vector<arma::mat> disjoint_L, disjoint_m1L;
         /// Auxiliary integrals for Yukawa separation
         std::vector<arma::mat> disjoint_iL, disjoint_kL;
-        /// Primitive two-electron integrals: <Nel^2 * (2L+1)>
-        std::vector<arma::mat> prim_tei;
-        /// Primitive two-electron integrals: <Nel^2 * (2L+1)> sorted for exchange
-        std::vector<arma::mat> prim_ktei;
-        /// Primitive range-separated two-electron integrals: <Nel^2 * (2L+1)> sorted for exchange
+        /// Primitive in-element two-electron integrals: <(2L+1) x Nel>, used for both Coulomb and exchange
+        elementtei::ElementTEI prim_tei;
+        /// Primitive range-separated two-electron integrals of the stored element pairs: <Npair * (2L+1)> sorted for exchange
         std::vector<arma::mat> rs_ktei;
+        /// Element pairs with stored range-separated integrals in compressed row form: the partners of iel are rs_pair_jel[rs_pair_ofs[iel] .. rs_pair_ofs[iel+1]-1]
+        std::vector<size_t> rs_pair_ofs, rs_pair_jel;
+        /// Screening threshold for distant element pairs in the erfc integrals
+        double rs_thresh;
+        /// Form the list of element pairs with range-separated integrals
+        void form_rs_pairs(bool diagonal);
+        /// Store the primitive two-electron integrals in single precision?
+        bool single_tei;
+        /// Single precision storage of rs_ktei, used instead of the above when nonempty
+        std::vector<arma::fmat> rs_ktei_f;
+
+        /// Maximal M value in the coupling channels
+        int Mmax;
+        /// Angular coupling plan: the nonzero couplings of each angular function, sorted in (L,M)
+        std::vector< std::vector<angular_coupling_t> > cplplan;
+        /// Form the angular coupling plan
+        void form_coupling_plan();
+        /// Form the angular sums for the (jang,kang) block of the exchange matrix
+        void exchange_angular_sum(const BlockMatrix & P, const arma::mat & Pnorm, const arma::vec & Lfac, size_t jang, size_t kang, std::vector<arma::mat> & Rmat, std::vector<bool> & couple, arma::vec & Rbound) const;
+
+        /// Screening threshold for exchange contributions
+        double kscreen;
+        /// Norms of the integral blocks for screening: <Nel x N_L> for disjoint and in-element integrals, <Npair x N_L> for range-separated integrals
+        arma::mat disjoint_L_norm, disjoint_m1L_norm, disjoint_iL_norm, disjoint_kL_norm, prim_tei_norm, rs_ktei_norm;
+        /// Compute norms of integral blocks stored as L*N + i
+        arma::mat integral_norms(const std::vector<arma::mat> & ints, size_t N) const;
+
+        /// Use batched contractions for the exchange between distinct elements?
+        bool batch_exchange;
+        /// Offsets of the elements in the element-expanded radial index
+        arma::uvec element_offsets() const;
+        /// Contract the exchange between distinct elements for channel L with factorized inner (r^L) and outer (r^{-L-1}) integrals
+        void disjoint_exchange(const std::vector<arma::mat> & inner, const std::vector<arma::mat> & outer, size_t L, const arma::mat & R, const arma::uvec & elofs, arma::mat & T, arma::mat & Kexp) const;
+        /// Largest and summed screening bounds of the distinct element pairs in channel L, given the norms of the inner (r^L) and outer (r^{-L-1}) integrals
+        void disjoint_pair_bounds(const arma::mat & inner_norm, const arma::mat & outer_norm, size_t L, double & maxbound, double & sumbound) const;
+
+        /// Integral cache directory (empty: no caching)
+        std::string intcache;
+        /// Cache key for the primitive integrals of the given kind and range-separation parameter
+        std::string integral_cache_key(const std::string & kind, double param, double thr=0.0) const;
 
         /// Add to radial submatrix
-        void add_sub(arma::mat & M, size_t iang, size_t jang, const arma::mat & Msub) const;
+        void add_sub(BlockMatrix & M, size_t iang, size_t jang, const arma::mat & Msub) const;
         /// Set radial submatrix
-        void set_sub(arma::mat & M, size_t iang, size_t jang, const arma::mat & Msub) const;
+        void set_sub(BlockMatrix & M, size_t iang, size_t jang, const arma::mat & Msub) const;
         /// Get radial submatrix
         arma::mat get_sub(const arma::mat & M, size_t iang, size_t jang) const;
+        /// Expand a radial matrix into the angular-diagonal full matrix I_ang x Mrad, with the columns ordered by the symmetry blocks of sym
+        arma::mat expand_radial(const arma::mat & Mrad, int sym) const;
 
       public:
         TwoDBasis();
@@ -112,6 +179,10 @@ namespace helfem {
         arma::mat expand_boundaries(const arma::mat & H) const;
         /// Remove boundary conditions
         arma::mat remove_boundaries(const arma::mat & H) const;
+        /// Convert a matrix in the basis to angular blocks
+        BlockMatrix to_blocks(const arma::mat & M) const;
+        /// Convert angular blocks to a matrix in the basis
+        arma::mat to_dense(const BlockMatrix & M) const;
 
         /// Memory for one-electron integral matrix
         size_t mem_1el() const;
@@ -120,10 +191,16 @@ namespace helfem {
         /// Memory for auxiliary two-electron integrals
         size_t mem_2el_aux() const;
 
-        /// Compute two-electron integrals
+        /// Set directory for the on-disk cache of primitive two-electron integrals (empty: no caching)
+        void set_integral_cache(const std::string & dir);
+        /// Store primitive two-electron integrals in single precision (default off); applies to integrals computed afterwards
+        void set_single_precision_tei(bool single);
+        /// Compute two-electron integrals, with the screening data for exchange if requested
         void compute_tei(bool exchange);
         /// Compute range-separated two-electron integrals
         void compute_yukawa(double lambda);
+        /// Set screening threshold for distant element pairs in the erfc integrals (default 0: all pairs); applies to integrals computed afterwards
+        void set_erfc_screening(double thr);
         /// Compute range-separated two-electron integrals
         void compute_erfc(double mu);
 
@@ -143,36 +220,66 @@ namespace helfem {
         arma::mat Sinvh(bool chol, int sym) const;
         /// Form radial integral
         arma::mat radial_integral(int n) const;
+        /// Form radial integral in angular blocks
+        BlockMatrix radial_integral_blocks(int n) const;
         /// Form overlap matrix
         arma::mat overlap() const;
+        /// Form overlap matrix in angular blocks
+        BlockMatrix overlap_blocks() const;
         /// Form kinetic energy matrix
         arma::mat kinetic() const;
+        /// Form kinetic energy matrix in angular blocks
+        BlockMatrix kinetic_blocks() const;
         /// Form nuclear attraction matrix
         arma::mat nuclear() const;
+        /// Form nuclear attraction matrix in angular blocks
+        BlockMatrix nuclear_blocks() const;
 	/// Form model potential matrix
 	arma::mat model_potential(const modelpotential::ModelPotential * model) const;
+	/// Form model potential matrix in angular blocks
+	BlockMatrix model_potential_blocks(const modelpotential::ModelPotential * model) const;
         /// Form dipole coupling matrix
         arma::mat dipole_z() const;
+        /// Form dipole coupling matrix in angular blocks
+        BlockMatrix dipole_z_blocks() const;
         /// Form quadrupole coupling matrix
         arma::mat quadrupole_zz() const;
+        /// Form quadrupole coupling matrix in angular blocks
+        BlockMatrix quadrupole_zz_blocks() const;
 
         /// Compute overlap matrix
         arma::mat overlap(const TwoDBasis & rh) const;
 
         /// Coupling to magnetic field in z direction
         arma::mat Bz_field(double B) const;
+        /// Coupling to magnetic field in z direction in angular blocks
+        BlockMatrix Bz_field_blocks(double B) const;
 
         /// Form density matrix
         arma::mat form_density(const arma::mat & C, size_t nocc) const;
 
         /// Form Coulomb matrix
         arma::mat coulomb(const arma::mat & P) const;
+        /// Form Coulomb matrix in angular blocks; only the blocks coupled to the density are stored
+        BlockMatrix coulomb_blocks(const BlockMatrix & P) const;
         /// Form exchange matrix
         arma::mat exchange(const arma::mat & P) const;
+        /// Form exchange matrix, adding the screening statistics to stats
+        arma::mat exchange(const arma::mat & P, exchange_screening_t & stats) const;
+        /// Form exchange matrix in angular blocks, adding the screening statistics to stats; only the coupled blocks are stored
+        BlockMatrix exchange_blocks(const BlockMatrix & P, exchange_screening_t & stats) const;
         /// Form range-separated exchange matrix
         arma::mat rs_exchange(const arma::mat & P) const;
+        /// Form range-separated exchange matrix, adding the screening statistics to stats
+        arma::mat rs_exchange(const arma::mat & P, exchange_screening_t & stats) const;
+        /// Form range-separated exchange matrix in angular blocks, adding the screening statistics to stats; only the coupled blocks are stored
+        BlockMatrix rs_exchange_blocks(const BlockMatrix & P, exchange_screening_t & stats) const;
+        /// Set screening threshold for exchange contributions (default 0: no screening)
+        void set_exchange_screening(double thr);
+        /// Toggle batched contractions in the exchange matrix (default on)
+        void set_batched_exchange(bool batch);
 
-        /// Get primitive integrals
+        /// Get primitive in-element integrals, stored at L*Nel+iel
         std::vector<arma::mat> get_prim_tei() const;
 
         /// Get l values
@@ -196,9 +303,9 @@ namespace helfem {
         /// Get number of radial elements
         size_t get_rad_Nel() const;
         /// Get radial quadrature weights
-        arma::vec get_wrad(size_t iel) const;
+        const arma::vec & get_wrad(size_t iel) const;
         /// Get r values
-        arma::vec get_r(size_t iel) const;
+        const arma::vec & get_r(size_t iel) const;
 
         /// Electron density at nuclei
         arma::vec nuclear_density(const arma::mat & P) const;
@@ -0,0 +1,151 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "../general/cmdline.h"
+#include <helfem.h>
+#include <cstdio>
+#include <vector>
+
+using namespace helfem;
+
+/// Dense assembly of the element matrices
+arma::mat dense_assembly(const atomic::basis::RadialBasis & radial, int itype) {
+  arma::mat M(radial.Nbf(),radial.Nbf());
+  M.zeros();
+  for(size_t iel=0;iel<radial.Nel();iel++) {
+    size_t ifirst, ilast;
+    radial.get_idx(iel,ifirst,ilast);
+    if(itype==0)
+      M.submat(ifirst,ifirst,ilast,ilast)+=radial.radial_integral(0,iel);
+    else if(itype==1)
+      M.submat(ifirst,ifirst,ilast,ilast)+=radial.kinetic(iel);
+    else
+      M.submat(ifirst,ifirst,ilast,ilast)+=radial.nuclear(iel);
+  }
+  return M;
+}
+
+/// Deviation of X^T S X from the unit matrix
+double orthonormality_error(const arma::mat & X, const arma::mat & S) {
+  arma::mat O(arma::trans(X)*S*X);
+  O.diag()-=1.0;
+  return arma::abs(O).max();
+}
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("primbas", 0, "primitive radial basis", false, 4);
+  parser.add<int>("nnodes", 0, "number of nodes per element", false, 15);
+  parser.add<int>("nquad", 0, "number of quadrature points", false, 0);
+  parser.add<int>("nelem", 0, "number of elements", false, 10);
+  parser.add<double>("Rmax", 0, "practical infinity in au", false, 40.0);
+  parser.add<int>("igrid", 0, "element grid", false, 4);
+  parser.add<double>("zexp", 0, "parameter in radial grid", false, 2.0);
+  parser.add<double>("thr", 0, "threshold for banded vs dense", false, 1e-9);
+  parser.parse_check(argc, argv);
+
+  int primbas(parser.get<int>("primbas"));
+  int Nnodes(parser.get<int>("nnodes"));
+  int Nquad(parser.get<int>("nquad"));
+  int Nelem(parser.get<int>("nelem"));
+  double Rmax(parser.get<double>("Rmax"));
+  int igrid(parser.get<int>("igrid"));
+  double zexp(parser.get<double>("zexp"));
+  double thr(parser.get<double>("thr"));
+  if(Nquad==0)
+    Nquad=5*Nnodes;
+
+  polynomial_basis::PolynomialBasis *poly(polynomial_basis::get_basis(primbas,Nnodes,false));
+  atomic::basis::RadialBasis radial(poly, Nquad, utils::get_grid(Rmax,Nelem,igrid,zexp));
+  delete poly;
+  printf("Radial basis has %i functions, bandwidth %i\n",(int) radial.Nbf(),(int) radial.bandwidth());
+
+  // Banded vs dense assembly
+  const char * names[]={"overlap","kinetic","nuclear"};
+  std::vector<banded::BandedMatrix> band(3);
+  band[0]=radial.overlap();
+  band[1]=radial.kinetic();
+  band[2]=radial.nuclear();
+
+  double maxdiff=0.0;
+  for(int itype=0;itype<3;itype++) {
+    arma::mat M(dense_assembly(radial,itype));
+    double d(utils::max_rel_diff(M,band[itype].dense()));
+    printf("Relative difference of banded and dense %s matrix %e\n",names[itype],d);
+    maxdiff=std::max(maxdiff,d);
+  }
+
+  // Banded vs dense eigenvalues
+  arma::mat S(band[0].dense());
+  arma::vec Eb, Ed;
+  arma::mat Cb, Cd;
+  banded::eig_sym(Eb,Cb,band[0]);
+  arma::eig_sym(Ed,Cd,S);
+  double dE(utils::max_rel_diff(Ed,Eb));
+  printf("Relative difference of banded and dense overlap eigenvalues %e\n",dE);
+  maxdiff=std::max(maxdiff,dE);
+
+  // Half-inverses: both must orthonormalize the basis, and the
+  // symmetric one is unique so it can be compared to the dense one
+  arma::vec bfnormlz(arma::pow(arma::diagvec(S),-0.5));
+  arma::mat Snorm(arma::diagmat(bfnormlz)*S*arma::diagmat(bfnormlz));
+  arma::vec Sval;
+  arma::mat Svec;
+  arma::eig_sym(Sval,Svec,Snorm);
+  arma::mat Sinvh_dense(arma::diagmat(bfnormlz)*Svec*arma::diagmat(arma::pow(Sval,-0.5))*arma::trans(Svec));
+
+  arma::mat Sinvh_sym(banded::invh(band[0],false));
+  arma::mat Sinvh_chol(banded::invh(band[0],true,false));
+  double dsym(utils::max_rel_diff(Sinvh_dense,Sinvh_sym));
+  double osym(orthonormality_error(Sinvh_sym,S));
+  double ochol(orthonormality_error(Sinvh_chol,S));
+  printf("Relative difference of banded and dense symmetric half-inverse %e\n",dsym);
+  printf("Orthonormality error of banded symmetric half-inverse %e, Cholesky half-inverse %e\n",osym,ochol);
+  maxdiff=std::max(maxdiff,std::max(dsym,std::max(osym,ochol)));
+
+  // Arithmetic and the conversion from a dense matrix
+  arma::mat Hd(dense_assembly(radial,1)+2.0*dense_assembly(radial,2));
+  banded::BandedMatrix Hb(band[1]+2.0*band[2]);
+  double dsum(utils::max_rel_diff(Hd,Hb.dense()));
+  double dconv(utils::max_rel_diff(Hd,banded::BandedMatrix(Hd,Hb.get_kd()).dense()));
+  printf("Relative difference of banded and dense sum %e, dense conversion %e\n",dsum,dconv);
+  maxdiff=std::max(maxdiff,std::max(dsum,dconv));
+
+  // Products and linear solves with a few right-hand sides
+  arma::arma_rng::set_seed(0);
+  arma::mat B(arma::randu<arma::mat>(S.n_rows,3));
+  arma::mat HB(Hd*B);
+  double dmul(utils::max_rel_diff(HB,Hb.multiply(B)));
+  arma::mat Xd(arma::solve(S,B));
+  double dsolve(utils::max_rel_diff(Xd,banded::solve(band[0],B)));
+  double dcsolve(utils::max_rel_diff(Xd,banded::chol_solve(banded::chol(band[0]),B)));
+  printf("Relative difference of banded and dense product %e, solve %e, Cholesky solve %e\n",dmul,dsolve,dcsolve);
+  maxdiff=std::max(maxdiff,std::max(dmul,std::max(dsolve,dcsolve)));
+
+  // Generalized eigenproblem vs the dense one in the orthonormal basis
+  arma::vec Egb, Egd;
+  arma::mat Cgb, Cgd;
+  banded::eig_gsym(Egb,Cgb,Hb,band[0]);
+  arma::eig_sym(Egd,Cgd,arma::trans(Sinvh_dense)*Hd*Sinvh_dense);
+  double dgE(utils::max_rel_diff(Egd,Egb));
+  double ogen(orthonormality_error(Cgb,S));
+  printf("Relative difference of banded and dense generalized eigenvalues %e, orthonormality error %e\n",dgE,ogen);
+  maxdiff=std::max(maxdiff,std::max(dgE,ogen));
+
+  printf("Maximum difference %e\n",maxdiff);
+  return utils::test_status(maxdiff>thr);
+}
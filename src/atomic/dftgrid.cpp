@@ -674,8 +674,8 @@ namespace helfem {
         bf_ind=basp->bf_list(iel);
 
         // Get radii and radial weights
-        arma::vec r(basp->get_r(iel));
-        arma::vec wrad(basp->get_wrad(iel));
+        const arma::vec & r(basp->get_r(iel));
+        const arma::vec & wrad(basp->get_wrad(iel));
 
         // Calculate scale factors
         arma::vec sth(cth.n_elem);
@@ -0,0 +1,79 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "erfc_expn.h"
+#include "../general/cmdline.h"
+#include <helfem.h>
+#include <cstdio>
+#include <vector>
+
+using namespace helfem;
+
+/// Logarithmic grid
+arma::vec log_grid(double xmin, double xmax, int npoints) {
+  return arma::exp(arma::linspace<arma::vec>(std::log(xmin),std::log(xmax),npoints));
+}
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("nmax", 0, "maximum order", false, 20);
+  parser.add<int>("npoints", 0, "number of points per grid", false, 60);
+  parser.add<double>("thr", 0, "threshold for batched vs pointwise", false, 1e-10);
+  parser.parse_check(argc, argv);
+
+  int nmax(parser.get<int>("nmax"));
+  int npoints(parser.get<int>("npoints"));
+  double thr(parser.get<double>("thr"));
+
+  // Grids in mu*r: short range, the crossover between the two
+  // expansions, and long range
+  std::vector<arma::vec> grids;
+  grids.push_back(log_grid(1e-4,0.5,npoints));
+  grids.push_back(log_grid(0.1,2.0,npoints));
+  grids.push_back(log_grid(0.5,30.0,npoints));
+
+  double maxdiff=0.0;
+  for(int n=0;n<=nmax;n++) {
+    // Damping function tables for every grid
+    std::vector<arma::mat> D(grids.size());
+    for(size_t ig=0;ig<grids.size();ig++)
+      D[ig]=atomic::erfc_expn::Dnk_table(n,grids[ig]);
+
+    for(size_t ig=0;ig<grids.size();ig++)
+      for(size_t jg=0;jg<grids.size();jg++) {
+        const arma::vec & Xi(grids[ig]);
+        const arma::vec & xk(grids[jg]);
+
+        // Pointwise reference
+        arma::mat Fref(Xi.n_elem,xk.n_elem);
+        for(size_t k=0;k<xk.n_elem;k++)
+          for(size_t i=0;i<Xi.n_elem;i++)
+            Fref(i,k)=atomic::erfc_expn::Phi(n,Xi(i),xk(k));
+
+        // Batched with precomputed tables, and with tables built on the fly
+        double dtab(utils::max_pointwise_rel_diff(Fref,atomic::erfc_expn::Phi(n,Xi,D[ig],xk,D[jg])));
+        double dbat(utils::max_pointwise_rel_diff(Fref,atomic::erfc_expn::Phi(n,Xi,xk)));
+
+        printf("n = %2i, grids %i x %i: relative difference %e with tables, %e without\n",n,(int) ig,(int) jg,dtab,dbat);
+        maxdiff=std::max(maxdiff,std::max(dtab,dbat));
+      }
+  }
+
+  printf("Maximum relative difference of batched vs pointwise evaluation %e\n",maxdiff);
+
+  return utils::test_status(maxdiff>thr);
+}
@@ -0,0 +1,115 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "../general/cmdline.h"
+#include "../general/timer.h"
+#include "../general/scf_helpers.h"
+#include "polynomial_basis.h"
+#include "basis.h"
+
+using namespace helfem;
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("Z", 0, "nuclear charge", false, 10);
+  parser.add<int>("lmax", 0, "maximum l quantum number", false, 3);
+  parser.add<int>("mmax", 0, "maximum m quantum number", false, 3);
+  parser.add<double>("Rmax", 0, "practical infinity in au", false, 40.0);
+  parser.add<int>("grid", 0, "type of grid: 1 for linear, 2 for quadratic, 3 for polynomial, 4 for exponential", false, 4);
+  parser.add<double>("zexp", 0, "parameter in radial grid", false, 2.0);
+  parser.add<int>("nelem", 0, "number of elements", false, 100);
+  parser.add<int>("nnodes", 0, "number of nodes per element", false, 15);
+  parser.add<int>("nquad", 0, "number of quadrature points", false, 0);
+  parser.add<int>("primbas", 0, "primitive radial basis", false, 4);
+  parser.add<int>("nrep", 0, "number of repetitions", false, 3);
+  parser.parse_check(argc, argv);
+
+  int Z(parser.get<int>("Z"));
+  int lmax(parser.get<int>("lmax"));
+  int mmax(parser.get<int>("mmax"));
+  double Rmax(parser.get<double>("Rmax"));
+  int igrid(parser.get<int>("grid"));
+  double zexp(parser.get<double>("zexp"));
+  int Nelem(parser.get<int>("nelem"));
+  int Nnodes(parser.get<int>("nnodes"));
+  int Nquad(parser.get<int>("nquad"));
+  int primbas(parser.get<int>("primbas"));
+  int nrep(parser.get<int>("nrep"));
+
+  // Get primitive basis
+  polynomial_basis::PolynomialBasis *poly(polynomial_basis::get_basis(primbas,Nnodes));
+  if(Nquad==0)
+    Nquad=5*poly->get_nbf();
+
+  // Construct the basis
+  arma::ivec lval, mval;
+  atomic::basis::angular_basis(lmax,mmax,lval,mval);
+  arma::vec bval=atomic::basis::form_grid(modelpotential::POINT_NUCLEUS, 0.0, Nelem, Rmax, igrid, zexp, 0, igrid, zexp, Z, 0, 0, 0.0);
+  atomic::basis::TwoDBasis basis(Z, modelpotential::POINT_NUCLEUS, 0.0, poly, Nquad, bval, lval, mval, 0, 0, 0.0);
+  delete poly;
+  printf("Basis set consists of %i angular shells composed of %i radial functions, totaling %i basis functions\n",(int) basis.Nang(), (int) basis.Nrad(), (int) basis.Nbf());
+
+  Timer t;
+  basis.compute_tei(true);
+  printf("Two-electron integrals computed in %.3f s\n",t.get());
+
+  // Random symmetric density matrix: no blocks are screened out. The
+  // two contractions must agree for any density; the accuracy of the
+  // single precision integrals is instead measured on converged SCF
+  // energies with singletei_cmp.sh
+  arma::mat P(basis.Nbf(),basis.Nbf());
+  P.randu();
+  P=P+P.t();
+
+  arma::mat Kref, Kbat;
+  double tref=0.0, tbat=0.0;
+  for(int irep=0;irep<nrep;irep++) {
+    basis.set_batched_exchange(false);
+    t.set();
+    Kref=basis.exchange(P);
+    tref+=t.get();
+
+    basis.set_batched_exchange(true);
+    t.set();
+    Kbat=basis.exchange(P);
+    tbat+=t.get();
+  }
+  tref/=nrep;
+  tbat/=nrep;
+
+  printf("Element pair loop exchange  %.3f s\n",tref);
+  printf("Batched exchange            %.3f s\n",tbat);
+  printf("Speedup                     %.2f\n",tref/tbat);
+  printf("Difference in exchange matrix %e\n",arma::norm(Kref-Kbat,"fro")/arma::norm(Kref,"fro"));
+
+  // Timings with single precision integral storage
+  basis.set_single_precision_tei(true);
+  t.set();
+  basis.compute_tei(true);
+  printf("\nSingle precision integrals computed in %.3f s, requiring %s\n",t.get(),scf::memory_size(basis.mem_2el_aux()).c_str());
+
+  double tKsp=0.0;
+  for(int irep=0;irep<nrep;irep++) {
+    t.set();
+    basis.exchange(P);
+    tKsp+=t.get();
+  }
+  tKsp/=nrep;
+  printf("Single precision exchange   %.3f s, speedup %.2f\n",tKsp,tbat/tKsp);
+
+  return 0;
+}
@@ -91,6 +91,11 @@ int main(int argc, char **argv) {
   parser.add<int>("ldft", 0, "theta rule for dft quadrature (0 for auto)", false, 0);
   parser.add<int>("mdft", 0, "phi rule for dft quadrature (0 for auto)", false, 0);
   parser.add<double>("dftthr", 0, "density threshold for dft", false, 1e-12);
+  parser.add<int>("incfock", 0, "build J and K from density differences, with a full rebuild every n iterations (0 for full builds only)", false, 0);
+  parser.add<int>("singletei", 0, "store primitive two-electron integrals in single precision", false, 0);
+  parser.add<double>("kscreen", 0, "screening threshold for exact exchange", false, 0.0);
+  parser.add<double>("rsthr", 0, "screening threshold for distant element pairs in erfc range separation", false, 0.0);
+  parser.add<std::string>("intcache", 0, "directory for caching two-electron integrals (empty for no caching)", false, "");
   parser.add<int>("restricted", 0, "spin-restricted orbitals", false, -1);
   parser.add<int>("symmetry", 0, "force orbital symmetry", false, 1);
   parser.add<int>("primbas", 0, "primitive radial basis", false, 4);
@@ -144,6 +149,11 @@ int main(int argc, char **argv) {
   int ldft(parser.get<int>("ldft"));
   int mdft(parser.get<int>("mdft"));
   double dftthr(parser.get<double>("dftthr"));
+  int incfock(parser.get<int>("incfock"));
+  int singletei(parser.get<int>("singletei"));
+  double kscreen(parser.get<double>("kscreen"));
+  double rsthr(parser.get<double>("rsthr"));
+  std::string intcache(parser.get<std::string>("intcache"));
 
   int finitenuc(parser.get<int>("finitenuc"));
   double Rrms(parser.get<double>("Rrms"));
@@ -239,6 +249,7 @@ int main(int argc, char **argv) {
 
   atomic::basis::TwoDBasis basis;
   basis=atomic::basis::TwoDBasis(Z, (modelpotential::nuclear_model_t) finitenuc, Rrms, poly, Nquad, bval, lval, mval, Zl, Zr, Rhalf);
+  basis.set_single_precision_tei(singletei);
   chkpt.write(basis);
   printf("Basis set consists of %i angular shells composed of %i radial functions, totaling %i basis functions\n",(int) basis.Nang(), (int) basis.Nrad(), (int) basis.Nbf());
 
@@ -331,9 +342,11 @@ int main(int argc, char **argv) {
   // Form overlap matrix
   arma::mat S(basis.overlap());
   chkpt.write("S",S);
-  // Form kinetic energy matrix
-  arma::mat T(basis.kinetic());
-  chkpt.write("T",T);
+  // Form kinetic energy matrix; the one-electron and two-electron
+  // matrices are kept in angular blocks, of which only the coupled
+  // ones are stored
+  atomic::basis::BlockMatrix T(basis.kinetic_blocks());
+  chkpt.write("T",basis.to_dense(T));
 
   // Form DFT grid
   helfem::atomic::dftgrid::DFTGrid grid;
@@ -378,10 +391,11 @@ int main(int argc, char **argv) {
     }
     {
       arma::mat Tdft(grid.eval_kinetic());
+      arma::mat Tref(basis.to_dense(T));
       // Compute relative error
       for(size_t j=0;j<Tdft.n_cols;j++)
         for(size_t i=0;i<Tdft.n_rows;i++)
-          Tdft(i,j)=std::abs(Tdft(i,j)-T(i,j))/(1+std::abs(T(i,j)));
+          Tdft(i,j)=std::abs(Tdft(i,j)-Tref(i,j))/(1+std::abs(Tref(i,j)));
 
       double Terr(arma::norm(Tdft,"fro"));
       printf("Relative error in kinetic matrix evaluated through xc grid is %e\n",Terr);
@@ -417,29 +431,30 @@ int main(int argc, char **argv) {
   Timer tnuc;
   if(Zl!=0 || Zr !=0)
     printf("Computing nuclear attraction integrals\n");
-  arma::mat Vnuc=basis.nuclear();
-  chkpt.write("Vuc",Vnuc);
+  atomic::basis::BlockMatrix Vnuc(basis.nuclear_blocks());
+  chkpt.write("Vuc",basis.to_dense(Vnuc));
   if(Zl!=0 || Zr !=0)
     printf("Done in %.6f\n",tnuc.get());
 
   // Dipole coupling
-  arma::mat dip(basis.dipole_z());
-  chkpt.write("dip",dip);
+  atomic::basis::BlockMatrix dip(basis.dipole_z_blocks());
+  chkpt.write("dip",basis.to_dense(dip));
   // Quadrupole coupling
-  arma::mat quad(basis.quadrupole_zz());
-  chkpt.write("quad",quad);
+  atomic::basis::BlockMatrix quad(basis.quadrupole_zz_blocks());
+  chkpt.write("quad",basis.to_dense(quad));
 
   // Electric field coupling (minus sign cancels one from charge)
-  arma::mat Vel(Ez*dip + Qzz*quad/3.0);
-  chkpt.write("Vel",Vel);
+  atomic::basis::BlockMatrix Vel(Ez*dip + (Qzz/3.0)*quad);
+  chkpt.write("Vel",basis.to_dense(Vel));
   // Magnetic field coupling
-  arma::mat Vmag(basis.Bz_field(Bz));
-  chkpt.write("Vmag",Vmag);
+  atomic::basis::BlockMatrix Vmag(basis.Bz_field_blocks(Bz));
+  chkpt.write("Vmag",basis.to_dense(Vmag));
   // Form Hamiltonian
-  arma::mat H0(T+Vnuc+Vel+Vmag);
-  chkpt.write("H0",H0);
+  atomic::basis::BlockMatrix H0(T+Vnuc+Vel+Vmag);
+  chkpt.write("H0",basis.to_dense(H0));
 
   printf("One-electron matrices formed in %.6f\n",timer.get());
+  printf("Hamiltonian stores %i out of %i angular blocks\n",(int) H0.stored_blocks(),(int) (basis.Nang()*basis.Nang()));
 
   // Occupied and virtual orbitals
   arma::mat Caocc, Cbocc, Cavirt, Cbvirt;
@@ -584,7 +599,7 @@ int main(int argc, char **argv) {
       }
 
       // Form guess Hamiltonian
-      arma::mat Hguess(T+Vel+Vmag+basis.model_potential(model));
+      arma::mat Hguess(basis.to_dense(T+Vel+Vmag+basis.model_potential_blocks(model)));
       // and free memory
       delete model;
 
@@ -650,12 +665,16 @@ int main(int argc, char **argv) {
   printf("Computing two-electron integrals\n");
   fflush(stdout);
   timer.set();
+  basis.set_integral_cache(intcache);
   basis.compute_tei(kfrac!=0.0);
   if(yukawa)
     basis.compute_yukawa(omega);
-  else if(erfc)
+  else if(erfc) {
+    basis.set_erfc_screening(rsthr);
     basis.compute_erfc(omega);
+  }
   printf("Done in %.6f\n",timer.get());
+  basis.set_exchange_screening(kscreen);
 
   double Ekin=0.0, Epot=0.0, Ecoul=0.0, Exx=0.0, Exc=0.0, Eefield=0.0, Emfield=0.0, Etot=0.0;
   double Eold=0.0;
@@ -666,6 +685,10 @@ int main(int argc, char **argv) {
 
   // Density matrices
   arma::mat P, Pa, Pb;
+  // Density matrices of the previous iteration for incremental builds
+  arma::mat Pold, Paold, Pbold;
+  // Coulomb and exchange matrices of the previous iteration
+  atomic::basis::BlockMatrix Jold, Kaold, Kbold;
 
   for(int i=1;i<=maxit;i++) {
     printf("\n**** Iteration %i ****\n\n",i);
@@ -686,55 +709,89 @@ int main(int argc, char **argv) {
       printf("Tr Pb = %f\n",arma::trace(Pb*S));
     fflush(stdout);
 
-    Ekin=arma::trace(P*T);
-    Epot=arma::trace(P*Vnuc);
-    Eefield=arma::trace(P*Vel);
-    Emfield=arma::trace(P*Vmag)-Bz/2.0*(nela-nelb);
+    // Density matrices in angular blocks
+    atomic::basis::BlockMatrix Pblk(basis.to_blocks(P));
+    atomic::basis::BlockMatrix Pablk(basis.to_blocks(Pa));
+    atomic::basis::BlockMatrix Pbblk(basis.to_blocks(Pb));
+
+    Ekin=Pblk.trace_product(T);
+    Epot=Pblk.trace_product(Vnuc);
+    Eefield=Pblk.trace_product(Vel);
+    Emfield=Pblk.trace_product(Vmag)-Bz/2.0*(nela-nelb);
+
+    // Full build, or incremental build from the density difference?
+    bool fullfock=(incfock<=0 || (i-1)%incfock==0);
+    arma::mat dP, dPa, dPb;
+    if(fullfock) {
+      dP=P;
+      dPa=Pa;
+      dPb=Pb;
+    } else {
+      printf("Incremental Fock build\n");
+      dP=P-Pold;
+      dPa=Pa-Paold;
+      dPb=Pb-Pbold;
+    }
 
     // Form Coulomb matrix
     timer.set();
-    arma::mat J(basis.coulomb(P));
+    atomic::basis::BlockMatrix J(basis.coulomb_blocks(basis.to_blocks(dP)));
+    if(!fullfock)
+      J+=Jold;
     double tJ(timer.get());
-    Ecoul=0.5*arma::trace(P*J);
+    Ecoul=0.5*Pblk.trace_product(J);
     printf("Coulomb energy %.10e % .6f\n",Ecoul,tJ);
     fflush(stdout);
 
-    chkpt.write("J",J);
+    chkpt.write("J",basis.to_dense(J));
 
-    // Form exchange matrix
+    // Form exchange matrix; blocks that are not stored are zero
     timer.set();
-    arma::mat Ka, Kb;
+    atomic::basis::BlockMatrix Ka(basis.Nang(),basis.Nrad()), Kb(basis.Nang(),basis.Nrad());
     if(kfrac!=0.0 || kshort!=0.0) {
-      Ka.zeros(Caocc.n_rows,Caocc.n_rows);
-      Kb.zeros(Caocc.n_rows,Caocc.n_rows);
+      atomic::basis::exchange_screening_t kstats = {0, 0, 0.0};
+      atomic::basis::BlockMatrix dPablk(basis.to_blocks(dPa));
       if(kfrac!=0.0)
-        Ka+=kfrac*basis.exchange(Pa);
+        Ka+=kfrac*basis.exchange_blocks(dPablk,kstats);
       if(omega!=0.0)
-        Ka+=kshort*basis.rs_exchange(Pa);
+        Ka+=kshort*basis.rs_exchange_blocks(dPablk,kstats);
+      if(!fullfock)
+        Ka+=Kaold;
 
       if(nelb) {
         if(restr && nela==nelb) {
           Kb=Ka;
         } else {
+          atomic::basis::BlockMatrix dPbblk(basis.to_blocks(dPb));
           if(kfrac!=0.0)
-            Kb+=kfrac*basis.exchange(Pb);
+            Kb+=kfrac*basis.exchange_blocks(dPbblk,kstats);
           if(omega!=0.0)
-            Kb+=kshort*basis.rs_exchange(Pb);
+            Kb+=kshort*basis.rs_exchange_blocks(dPbblk,kstats);
+          if(!fullfock)
+            Kb+=Kbold;
         }
       }
 
       double tK(timer.get());
-      Exx=0.5*arma::trace(Pa*Ka);
-      if(Kb.n_rows == Pb.n_rows && Kb.n_cols == Pb.n_cols)
-        Exx+=0.5*arma::trace(Pb*Kb);
+      Exx=0.5*(Pablk.trace_product(Ka)+Pbblk.trace_product(Kb));
       printf("Exchange energy %.10e % .6f\n",Exx,tK);
+      if(kscreen>0.0)
+        printf("Exchange screening: %i blocks computed, %i skipped, error bound %e\n",(int) kstats.ncomp,(int) kstats.nskip,kstats.err);
     } else {
       Exx=0.0;
     }
     fflush(stdout);
 
-    chkpt.write("Ka",Ka);
-    chkpt.write("Kb",Kb);
+    chkpt.write("Ka",basis.to_dense(Ka));
+    chkpt.write("Kb",basis.to_dense(Kb));
+
+    // Store for incremental builds
+    Pold=P;
+    Paold=Pa;
+    Pbold=Pb;
+    Jold=J;
+    Kaold=Ka;
+    Kbold=Kb;
 
     // Exchange-correlation
     Exc=0.0;
@@ -759,15 +816,11 @@ int main(int argc, char **argv) {
     chkpt.write("XCa",XCb);
     chkpt.write("XCb",XCb);
 
-    // Fock matrices
-    arma::mat Fa(H0+J);
-    arma::mat Fb(H0+J);
-    if(Ka.n_rows == Fa.n_rows) {
-      Fa+=Ka;
-    }
-    if(Kb.n_rows == Fb.n_rows) {
-      Fb+=Kb;
-    }
+    // Fock matrices: the angular blocks are summed first, and the
+    // dense matrices are only formed for the exchange-correlation
+    // terms, DIIS and the diagonalization
+    arma::mat Fa(basis.to_dense(H0+J+Ka));
+    arma::mat Fb(basis.to_dense(H0+J+Kb));
     if(dft) {
       Fa+=XCa;
       if(nelb>0) {
@@ -922,8 +975,11 @@ int main(int argc, char **argv) {
   printf("%-21s energy: % .16f\n","Virial ratio",-Etot/Ekin);
 
   printf("\n");
-  printf("Electronic dipole     moment % .16e\n",-arma::trace(dip*P));
-  printf("Electronic quadrupole moment % .16e\n",-arma::trace(quad*P));
+  {
+    atomic::basis::BlockMatrix Pblk(basis.to_blocks(P));
+    printf("Electronic dipole     moment % .16e\n",-Pblk.trace_product(dip));
+    printf("Electronic quadrupole moment % .16e\n",-Pblk.trace_product(quad));
+  }
 
   // Electron density at nucleus
   if(Z!=0) {
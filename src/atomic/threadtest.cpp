@@ -0,0 +1,138 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "../general/cmdline.h"
+#include "../general/timer.h"
+#include <helfem.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace helfem;
+
+/// Boundaries of the ibas:th test basis; every basis has a different grid
+arma::vec test_grid(int ibas, int Nelem, double Rmax) {
+  return utils::get_grid(Rmax*(1.0+0.1*(ibas%7)), Nelem+(ibas%5), 1+(ibas%4), 1.0+0.25*(ibas%3));
+}
+
+/// Integrals of a radial basis, collected into a single vector
+arma::vec integrals(const atomic::basis::RadialBasis & radial, int Lmax, double lambda) {
+  std::vector<arma::vec> ints;
+  ints.push_back(arma::vectorise(radial.overlap().band()));
+  ints.push_back(arma::vectorise(radial.kinetic().band()));
+  ints.push_back(arma::vectorise(radial.nuclear().band()));
+  for(size_t iel=0;iel<radial.Nel();iel++) {
+    ints.push_back(arma::vectorise(radial.get_bf(iel)));
+    for(int L=0;L<=Lmax;L++) {
+      ints.push_back(arma::vectorise(radial.twoe_integral(L,iel)));
+      ints.push_back(arma::vectorise(radial.yukawa_integral(L,lambda,iel)));
+    }
+  }
+
+  size_t N=0;
+  for(size_t i=0;i<ints.size();i++)
+    N+=ints[i].n_elem;
+  arma::vec all(N);
+  size_t ioff=0;
+  for(size_t i=0;i<ints.size();i++) {
+    all.subvec(ioff,ioff+ints[i].n_elem-1)=ints[i];
+    ioff+=ints[i].n_elem;
+  }
+  return all;
+}
+
+/// Construct the ibas:th basis and compute its integrals
+arma::vec run(int ibas, int primbas, int Nnodes, int Nquad, int Nelem, double Rmax, int Lmax, double lambda) {
+  polynomial_basis::PolynomialBasis *poly(polynomial_basis::get_basis(primbas,Nnodes,false));
+  atomic::basis::RadialBasis radial(poly, Nquad, test_grid(ibas,Nelem,Rmax));
+  delete poly;
+  radial.tabulate_twoe(Lmax);
+
+  // Exercise the copies, which share the polynomial basis
+  atomic::basis::RadialBasis copy(radial);
+  return integrals(copy,Lmax,lambda);
+}
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("nbas", 0, "number of bases to construct", false, 64);
+  parser.add<int>("primbas", 0, "primitive radial basis", false, 4);
+  parser.add<int>("nnodes", 0, "number of nodes per element", false, 8);
+  parser.add<int>("nquad", 0, "number of quadrature points", false, 0);
+  parser.add<int>("nelem", 0, "number of elements", false, 10);
+  parser.add<double>("Rmax", 0, "practical infinity in au", false, 20.0);
+  parser.add<int>("Lmax", 0, "maximum L of the two-electron integrals", false, 3);
+  parser.add<double>("lambda", 0, "Yukawa screening parameter", false, 0.5);
+  parser.parse_check(argc, argv);
+
+  int nbas(parser.get<int>("nbas"));
+  int primbas(parser.get<int>("primbas"));
+  int Nnodes(parser.get<int>("nnodes"));
+  int Nquad(parser.get<int>("nquad"));
+  int Nelem(parser.get<int>("nelem"));
+  double Rmax(parser.get<double>("Rmax"));
+  int Lmax(parser.get<int>("Lmax"));
+  double lambda(parser.get<double>("lambda"));
+  if(Nquad==0)
+    Nquad=5*Nnodes;
+
+  // Serial reference
+  Timer t;
+  std::vector<arma::vec> ref(nbas);
+  for(int ibas=0;ibas<nbas;ibas++)
+    ref[ibas]=run(ibas,primbas,Nnodes,Nquad,Nelem,Rmax,Lmax,lambda);
+  printf("Serial construction of %i bases took %.3f s\n",nbas,t.get());
+
+  // Concurrent construction; every basis is run several times
+  int nrep=3;
+  std::vector<arma::vec> par(nbas*nrep);
+  t.set();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+  for(int itask=0;itask<nbas*nrep;itask++)
+    par[itask]=run(itask%nbas,primbas,Nnodes,Nquad,Nelem,Rmax,Lmax,lambda);
+  printf("Concurrent construction of %i bases took %.3f s\n",nbas*nrep,t.get());
+
+  // Concurrent const calls on a single shared basis
+  polynomial_basis::PolynomialBasis *poly(polynomial_basis::get_basis(primbas,Nnodes,false));
+  atomic::basis::RadialBasis shared(poly, Nquad, test_grid(0,Nelem,Rmax));
+  delete poly;
+  shared.tabulate_twoe(Lmax);
+  std::vector<arma::vec> sh(nbas);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+  for(int itask=0;itask<nbas;itask++)
+    sh[itask]=integrals(shared,Lmax,lambda);
+
+  // Results must be bitwise reproducible
+  int nfail=0;
+  for(int itask=0;itask<nbas*nrep;itask++)
+    if(par[itask].n_elem != ref[itask%nbas].n_elem || arma::any(par[itask] != ref[itask%nbas]))
+      nfail++;
+  for(int itask=0;itask<nbas;itask++)
+    if(sh[itask].n_elem != ref[0].n_elem || arma::any(sh[itask] != ref[0]))
+      nfail++;
+
+#ifdef _OPENMP
+  printf("Ran with %i threads\n",omp_get_max_threads());
+#endif
+  printf("%i of %i concurrent results differ from the serial ones\n",nfail,nbas*(nrep+1));
+  return nfail ? 1 : 0;
+}
@@ -40,7 +40,16 @@ namespace helfem {
 
       RadialBasis::RadialBasis(const polynomial_basis::PolynomialBasis * poly_, int n_quad, const arma::vec & bval_) {
 	// Polynomial basis
-        poly=poly_->copy();
+        poly.reset(poly_->copy());
+        // and its element variants
+        poly_variants.resize(2);
+        poly_variants[0]=poly;
+        {
+          polynomial_basis::PolynomialBasis * p(poly_->copy());
+          // Boundary condition at infinity
+          p->drop_last();
+          poly_variants[1].reset(p);
+        }
 
         // Get quadrature rule
         chebyshev::chebyshev(n_quad,xq,wq);
@@ -56,24 +65,8 @@ namespace helfem {
 
         // Element boundaries
         bval=bval_;
-      }
-
-      RadialBasis::RadialBasis(const RadialBasis & rh) {
-        *this = rh;
-      }
-
-      RadialBasis & RadialBasis::operator=(const RadialBasis & rh) {
-        xq=rh.xq;
-        wq=rh.wq;
-        poly=rh.poly->copy();
-        bf=rh.bf;
-        df=rh.df;
-        bval=rh.bval;
-        return *this;
-      }
-
-      RadialBasis::~RadialBasis() {
-        delete poly;
+        // Per-element basis function tables
+        form_element_tables();
       }
 
       int RadialBasis::get_nquad() const {
@@ -106,14 +99,8 @@ namespace helfem {
 	return bas.cols(idx);
       }
 
-      polynomial_basis::PolynomialBasis * RadialBasis::get_basis(const polynomial_basis::PolynomialBasis * polynom, size_t iel) const {
-        polynomial_basis::PolynomialBasis * p(polynom->copy());
-        if(iel==bval.n_elem-2) {
-          // Boundary condition at infinity
-          p->drop_last();
-        }
-
-        return p;
+      const polynomial_basis::PolynomialBasis & RadialBasis::element_poly(size_t iel) const {
+        return *poly_variants[iel==bval.n_elem-2 ? 1 : 0];
       }
 
       size_t RadialBasis::get_noverlap() const {
@@ -279,7 +266,7 @@ namespace helfem {
         double mumax(bval(iel+1));
 
         // Integral by quadrature
-        return diatomic::quadrature::Plm_radial_integral(mumin,mumax,k,xq,wq,get_basis(bf,iel),L,M,legtab);
+        return diatomic::quadrature::Plm_radial_integral(mumin,mumax,k,xq,wq,get_basis(bf,iel),L,M,legtab,chmu_quad_offset(iel));
       }
 
       arma::mat RadialBasis::Qlm_integral(int k, size_t iel, int L, int M, const legendretable::LegendreTable & legtab) const {
@@ -287,7 +274,7 @@ namespace helfem {
         double mumax(bval(iel+1));
 
         // Integral by quadrature
-        return diatomic::quadrature::Qlm_radial_integral(mumin,mumax,k,xq,wq,get_basis(bf,iel),L,M,legtab);
+        return diatomic::quadrature::Qlm_radial_integral(mumin,mumax,k,xq,wq,get_basis(bf,iel),L,M,legtab,chmu_quad_offset(iel));
       }
 
       arma::mat RadialBasis::kinetic(size_t iel) const {
@@ -318,11 +305,7 @@ namespace helfem {
         double mumax(bval(iel+1));
 
         // Integral by quadrature
-        polynomial_basis::PolynomialBasis * p(get_basis(poly,iel));
-        arma::mat tei(quadrature::twoe_integral(mumin,mumax,alpha,beta,xq,wq,p,L,M,legtab));
-        delete p;
-
-        return tei;
+        return quadrature::twoe_integral(mumin,mumax,alpha,beta,xq,wq,&element_poly(iel),L,M,legtab,chmu_quad_offset(iel));
       }
 
       arma::vec RadialBasis::get_chmu_quad() const {
@@ -359,14 +342,38 @@ namespace helfem {
           }
         }
 
-        return arma::cosh(arma::sort(muq,"ascend"));
+        return arma::cosh(muq);
+      }
+
+      size_t RadialBasis::chmu_quad_offset(size_t iel) const {
+        return iel*xq.n_elem*(xq.n_elem+1);
+      }
+
+      void RadialBasis::form_element_tables() {
+        size_t nel(Nel());
+        el_bf.resize(nel);
+        el_df.resize(nel);
+        el_wrad.resize(nel);
+        el_r.resize(nel);
+        for(size_t iel=0;iel<nel;iel++) {
+          // Interval length
+          double rmin(bval(iel));
+          double rmax(bval(iel+1));
+          double rmid=(rmax+rmin)/2;
+          double rlen=(rmax-rmin)/2;
+
+          // Element function values at quadrature points
+          el_bf[iel]=get_basis(bf,iel);
+          // Derivative picks up one rlen
+          el_df[iel]=get_basis(df,iel)/rlen;
+          // This is just the radial rule, no r^2 factor included here
+          el_wrad[iel]=rlen*wq;
+          el_r[iel]=rmid*arma::ones<arma::vec>(xq.n_elem)+rlen*xq;
+        }
       }
 
-      arma::mat RadialBasis::get_bf(size_t iel) const {
-        // Element function values at quadrature points are
-        arma::mat val(get_basis(bf,iel));
-
-        return val;
+      const arma::mat & RadialBasis::get_bf(size_t iel) const {
+        return el_bf[iel];
       }
 
       arma::mat RadialBasis::get_bf(size_t iel, const arma::vec & x) const {
@@ -376,36 +383,16 @@ namespace helfem {
         return val;
       }
 
-      arma::mat RadialBasis::get_df(size_t iel) const {
-        // Element function values at quadrature points are
-        arma::mat dval(get_basis(df,iel));
-        // Interval length
-        double rmin(bval(iel));
-        double rmax(bval(iel+1));
-        double rlen=(rmax-rmin)/2;
-
-        // Derivative is then
-        return dval/rlen;
+      const arma::mat & RadialBasis::get_df(size_t iel) const {
+        return el_df[iel];
       }
 
-      arma::vec RadialBasis::get_wrad(size_t iel) const {
-        // Full radial weight
-        double rmin(bval(iel));
-        double rmax(bval(iel+1));
-        double rlen=(rmax-rmin)/2;
-
-        // This is just the radial rule, no r^2 factor included here
-        return rlen*wq;
+      const arma::vec & RadialBasis::get_wrad(size_t iel) const {
+        return el_wrad[iel];
       }
 
-      arma::vec RadialBasis::get_r(size_t iel) const {
-        // Full radial weight
-        double rmin(bval(iel));
-        double rmax(bval(iel+1));
-        double rmid=(rmax+rmin)/2;
-        double rlen=(rmax-rmin)/2;
-
-        return rmid*arma::ones<arma::vec>(xq.n_elem)+rlen*xq;
+      const arma::vec & RadialBasis::get_r(size_t iel) const {
+        return el_r[iel];
       }
 
       void lm_to_l_m(const arma::ivec & lmax, arma::ivec & lval, arma::ivec & mval) {
@@ -425,7 +412,7 @@ namespace helfem {
         }
       }
 
-      TwoDBasis::TwoDBasis() {
+      TwoDBasis::TwoDBasis() : single_tei(false) {
       }
 
       TwoDBasis::TwoDBasis(int Z1_, int Z2_, double Rbond, const polynomial_basis::PolynomialBasis * poly, int n_quad, const arma::vec & bval, const arma::ivec & lval_, const arma::ivec & mval_, int lpad, bool legendre) {
@@ -433,6 +420,8 @@ namespace helfem {
         Z1=Z1_;
         Z2=Z2_;
         Rhalf=0.5*Rbond;
+        // Double precision integrals by default
+        single_tei=false;
 
         // Construct radial basis
         radial=RadialBasis(poly, n_quad, bval);
@@ -440,6 +429,21 @@ namespace helfem {
         lval=lval_;
         mval=mval_;
 
+        // The functions with m != 0 also have a sin(m phi) part. The
+        // positions of these functions among bf_list(iel) only
+        // depend on the number of radial functions in the element.
+        sin_ang=arma::find(mval!=0);
+        sin_el.resize(radial.Nel());
+        for(size_t iel=0;iel<radial.Nel();iel++) {
+          size_t ifirst, ilast;
+          radial.get_idx(iel,ifirst,ilast);
+          size_t Nr(ilast-ifirst+1);
+          sin_el[iel].zeros(Nr*sin_ang.n_elem);
+          for(size_t is=0;is<sin_ang.n_elem;is++)
+            for(size_t j=0;j<Nr;j++)
+              sin_el[iel](is*Nr+j)=sin_ang(is)*Nr+j;
+        }
+
         // Gaunt coefficients
         int gmax(arma::max(lval)+2);
 
@@ -514,9 +518,7 @@ namespace helfem {
 
           // Fill table with necessary values
           legtab=legendretable::LegendreTable(Lmax+lpad,Lmax,Mmax);
-          arma::vec chmu(radial.get_chmu_quad());
-          for(size_t i=0;i<chmu.n_elem;i++)
-            legtab.compute(chmu(i));
+          legtab.compute(radial.get_chmu_quad());
           printf("done (% .3f s)\n",t.get());
           fflush(stdout);
 
@@ -1269,153 +1271,143 @@ namespace helfem {
       }
 
       size_t TwoDBasis::mem_2el_aux() const {
-        // Auxiliary integrals required up to
-        size_t N_LM(lm_map.size());
-        // Number of elements
-        size_t Nel(radial.Nel());
-        // Number of primitive functions per element
-        size_t Nprim(radial.max_Nprim());
-
-        // No off-diagonal storage
-        return 4*N_LM*Nel*Nprim*Nprim*Nprim*Nprim*sizeof(double);
+        // Number of primitive functions in the elements
+        std::vector<size_t> Nprim(radial.Nel());
+        for(size_t iel=0;iel<Nprim.size();iel++)
+          Nprim[iel]=radial.Nprim(iel);
+
+        // Only the in-element blocks of the four kinds of integrals
+        // are stored, and exchange reads the same integrals as Coulomb
+        return 4*elementtei::ElementTEI::required_memory(lm_map.size(),Nprim,single_tei);
+      }
+
+      void TwoDBasis::set_single_precision_tei(bool single) {
+        single_tei=single;
+      }
+
+
+      /// Kinds of integral precomputation tasks
+      enum tei_task_kind_t {
+        /// Disjoint Plm and Qlm integrals
+        TASK_DISJOINT,
+        /// In-element integrals (00)
+        TASK_TEI00,
+        /// In-element integrals (02) and (20), which are each other's transposes
+        TASK_TEI02,
+        /// In-element integrals (22)
+        TASK_TEI22
+      };
+
+      /// Integral precomputation task
+      typedef struct {
+        /// LM index
+        size_t ilm;
+        /// Element
+        size_t iel;
+        /// Kind of task
+        tei_task_kind_t kind;
+        /// Estimated cost
+        double cost;
+      } tei_task_t;
+
+      /// Sort tasks by decreasing cost
+      static bool task_cost_greater(const tei_task_t & lh, const tei_task_t & rh) {
+        return lh.cost > rh.cost;
       }
 
-
       void TwoDBasis::compute_tei(bool exchange) {
         // Number of distinct L values is
         size_t Nel(radial.Nel());
+        size_t N_LM(lm_map.size());
+
+        // Number of primitive functions in the elements
+        std::vector<size_t> Nprim(Nel);
+        for(size_t iel=0;iel<Nel;iel++)
+          Nprim[iel]=radial.Nprim(iel);
+
+        disjoint_P0.resize(Nel*N_LM);
+        disjoint_P2.resize(Nel*N_LM);
+        disjoint_Q0.resize(Nel*N_LM);
+        disjoint_Q2.resize(Nel*N_LM);
+        // Only the in-element integrals are stored; the integrals
+        // between different elements are contracted in factorized form
+        prim_tei00=elementtei::ElementTEI(N_LM,Nprim);
+        prim_tei02=elementtei::ElementTEI(N_LM,Nprim);
+        prim_tei20=elementtei::ElementTEI(N_LM,Nprim);
+        prim_tei22=elementtei::ElementTEI(N_LM,Nprim);
+
+        /*
+          All the integrals are independent, so the precomputation is
+          split into tasks over (LM, element, kind) that are run
+          longest first with dynamic scheduling. The quadrature cost
+          is the same for all LM; the in-element integrals cost
+          ~Nprim^4 from the products of the element's functions, and
+          the disjoint ones ~Nprim^2.
+        */
+        std::vector<tei_task_t> tasks;
+        for(size_t ilm=0;ilm<N_LM;ilm++)
+          for(size_t iel=0;iel<Nel;iel++) {
+            double N2(Nprim[iel]*Nprim[iel]);
+            tei_task_t task;
+            task.ilm=ilm;
+            task.iel=iel;
+
+            task.kind=TASK_DISJOINT;
+            task.cost=4*N2;
+            tasks.push_back(task);
+
+            task.cost=2*N2*N2;
+            task.kind=TASK_TEI00;
+            tasks.push_back(task);
+            task.kind=TASK_TEI02;
+            tasks.push_back(task);
+            task.kind=TASK_TEI22;
+            tasks.push_back(task);
+          }
+        std::stable_sort(tasks.begin(),tasks.end(),task_cost_greater);
 
-        // Compute disjoint integrals
-        disjoint_P0.resize(Nel*lm_map.size());
-        disjoint_P2.resize(Nel*lm_map.size());
-        disjoint_Q0.resize(Nel*lm_map.size());
-        disjoint_Q2.resize(Nel*lm_map.size());
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic,1)
 #endif
-        for(size_t ilm=0;ilm<lm_map.size();ilm++) {
+        for(size_t itask=0;itask<tasks.size();itask++) {
+          const tei_task_t & task(tasks[itask]);
+          size_t ilm(task.ilm);
+          size_t iel(task.iel);
           int L(lm_map[ilm].first);
           int M(lm_map[ilm].second);
-          for(size_t iel=0;iel<Nel;iel++) {
+
+          switch(task.kind) {
+          case(TASK_DISJOINT):
             disjoint_P0[ilm*Nel+iel]=radial.Plm_integral(0,iel,L,M,legtab);
             disjoint_P2[ilm*Nel+iel]=radial.Plm_integral(2,iel,L,M,legtab);
             disjoint_Q0[ilm*Nel+iel]=radial.Qlm_integral(0,iel,L,M,legtab);
             disjoint_Q2[ilm*Nel+iel]=radial.Qlm_integral(2,iel,L,M,legtab);
-          }
-        }
+            break;
 
-        // Form primitive two-electron integrals
-        prim_tei00.resize(Nel*Nel*lm_map.size());
-        prim_tei02.resize(Nel*Nel*lm_map.size());
-        prim_tei20.resize(Nel*Nel*lm_map.size());
-        prim_tei22.resize(Nel*Nel*lm_map.size());
-
-        for(size_t ilm=0;ilm<lm_map.size();ilm++) {
-          int L(lm_map[ilm].first);
-          int M(lm_map[ilm].second);
+          case(TASK_TEI00):
+            prim_tei00.set_block(ilm,iel,radial.twoe_integral(0,0,iel,L,M,legtab));
+            break;
 
-          for(size_t iel=0;iel<Nel;iel++) {
-            // Index in array
+          case(TASK_TEI02):
             {
-              const size_t idx(Nel*Nel*ilm + iel*Nel + iel);
-
-              // In-element integrals
-              prim_tei00[idx]=radial.twoe_integral(0,0,iel,L,M,legtab);
-              prim_tei02[idx]=radial.twoe_integral(0,2,iel,L,M,legtab);
-              prim_tei20[idx]=radial.twoe_integral(2,0,iel,L,M,legtab);
-              prim_tei22[idx]=radial.twoe_integral(2,2,iel,L,M,legtab);
+              arma::mat tei(radial.twoe_integral(0,2,iel,L,M,legtab));
+              prim_tei02.set_block(ilm,iel,tei);
+              prim_tei20.set_block(ilm,iel,arma::trans(tei));
             }
+            break;
 
-            /*
-            for(size_t jel=0;jel<Nel;jel++) {
-              // Index in disjoint array
-              const size_t iidx(ilm*Nel+iel);
-              const size_t jidx(ilm*Nel+jel);
-
-              // when r(iel)>r(jel), iel gets Q
-              const arma::mat & i0=(iel>jel) ? disjoint_Q0[iidx] : disjoint_P0[iidx];
-              const arma::mat & i2=(iel>jel) ? disjoint_Q2[iidx] : disjoint_P2[iidx];
-              // and jel gets P
-              const arma::mat & j0=(iel>jel) ? disjoint_P0[jidx] : disjoint_Q0[jidx];
-              const arma::mat & j2=(iel>jel) ? disjoint_P2[jidx] : disjoint_Q2[jidx];
-
-              // Store integrals
-              prim_tei00[idx]=utils::product_tei(i0,j0);
-              prim_tei02[idx]=utils::product_tei(i0,j2);
-              prim_tei20[idx]=utils::product_tei(i2,j0);
-              prim_tei22[idx]=utils::product_tei(i2,j2);
-            }
-            */
+          case(TASK_TEI22):
+            prim_tei22.set_block(ilm,iel,radial.twoe_integral(2,2,iel,L,M,legtab));
+            break;
           }
         }
 
-        // Make sure teis are symmetric
-        /*
-        for(size_t ilm=0;ilm<lm_map.size();ilm++)
-          for(size_t iel=0;iel<Nel;iel++)
-            for(size_t jel=0;jel<Nel;jel++) {
-              size_t idx=Nel*Nel*ilm + iel*Nel + jel;
-              size_t Ni(radial.Nprim(iel));
-              size_t Nj(radial.Nprim(jel));
-              printf("ilm = %i, iel = %i, jel = %i\n",(int) ilm, (int) iel, (int) jel);
-              utils::check_tei_symmetry(prim_tei00[idx],Ni,Ni,Nj,Nj);
-              utils::check_tei_symmetry(prim_tei02[idx],Ni,Ni,Nj,Nj);
-              utils::check_tei_symmetry(prim_tei20[idx],Ni,Ni,Nj,Nj);
-              utils::check_tei_symmetry(prim_tei22[idx],Ni,Ni,Nj,Nj);
-            }
-        */
-
-        /*
-          The exchange matrix is given by
-          K(jk) = (ij|kl) P(il)
-          i.e. the complex conjugation hits i and l as
-          in the density matrix.
-
-          To get this in the proper order, we permute the integrals
-          K(jk) = (jk;il) P(il)
-          so we don't have to reform the permutations in the exchange routine.
-        */
-        if(exchange) {
-          prim_ktei00.resize(prim_tei00.size());
-          prim_ktei02.resize(prim_tei02.size());
-          prim_ktei20.resize(prim_tei20.size());
-          prim_ktei22.resize(prim_tei22.size());
-          for(size_t ilm=0;ilm<lm_map.size();ilm++)
-            for(size_t iel=0;iel<Nel;iel++) {
-              // Diagonal integrals
-              {
-                size_t idx=Nel*Nel*ilm + iel*Nel + iel;
-                size_t Ni(radial.Nprim(iel));
-                size_t Nj(radial.Nprim(iel));
-                prim_ktei00[idx]=utils::exchange_tei(prim_tei00[idx],Ni,Ni,Nj,Nj);
-                prim_ktei02[idx]=utils::exchange_tei(prim_tei02[idx],Ni,Ni,Nj,Nj);
-                prim_ktei20[idx]=utils::exchange_tei(prim_tei20[idx],Ni,Ni,Nj,Nj);
-                prim_ktei22[idx]=utils::exchange_tei(prim_tei22[idx],Ni,Ni,Nj,Nj);
-              }
-
-              // Off-diagonal integrals (not used since faster to
-              // contract the integrals in factorized form)
-              /*
-                for(size_t jel=0;jel<iel;jel++) {
-                size_t idx=Nel*Nel*ilm + iel*Nel + jel;
-                size_t Ni(radial.Nprim(iel));
-                size_t Nj(radial.Nprim(jel));
-                prim_ktei00[idx]=utils::exchange_tei(prim_tei00[idx],Ni,Ni,Nj,Nj);
-                prim_ktei02[idx]=utils::exchange_tei(prim_tei02[idx],Ni,Ni,Nj,Nj);
-                prim_ktei20[idx]=utils::exchange_tei(prim_tei20[idx],Ni,Ni,Nj,Nj);
-                prim_ktei22[idx]=utils::exchange_tei(prim_tei22[idx],Ni,Ni,Nj,Nj);
-                }
-                for(size_t jel=iel+1;jel<Nel;jel++) {
-                size_t idx=Nel*Nel*ilm + iel*Nel + jel;
-                size_t Ni(radial.Nprim(iel));
-                size_t Nj(radial.Nprim(jel));
-                prim_ktei00[idx]=utils::exchange_tei(prim_tei00[idx],Ni,Ni,Nj,Nj);
-                prim_ktei02[idx]=utils::exchange_tei(prim_tei02[idx],Ni,Ni,Nj,Nj);
-                prim_ktei20[idx]=utils::exchange_tei(prim_tei20[idx],Ni,Ni,Nj,Nj);
-                prim_ktei22[idx]=utils::exchange_tei(prim_tei22[idx],Ni,Ni,Nj,Nj);
-                }
-              */
-            }
+        // Switch to single precision storage
+        if(single_tei) {
+          prim_tei00.convert_to_single();
+          prim_tei02.convert_to_single();
+          prim_tei20.convert_to_single();
+          prim_tei22.convert_to_single();
         }
       }
 
@@ -1462,7 +1454,7 @@ namespace helfem {
       }
 
       arma::mat TwoDBasis::coulomb(const arma::mat & P0) const {
-        if(!prim_tei00.size())
+        if(prim_tei00.empty())
           throw std::logic_error("Primitive teis have not been computed!\n");
 
         // Extend to boundaries
@@ -1583,11 +1575,10 @@ namespace helfem {
               Psub0.reshape(Nj*Nj,1);
               Psub2.reshape(Nj*Nj,1);
 
-              const size_t idx(Nel*Nel*ilm + iel*Nel + jel);
-              Jsub0+=LMfac*(prim_tei00[idx]*Psub0);
-              Jsub0-=LMfac*(prim_tei02[idx]*Psub2);
-              Jsub2-=LMfac*(prim_tei20[idx]*Psub0);
-              Jsub2+=LMfac*(prim_tei22[idx]*Psub2);
+              prim_tei00.gemv(ilm,iel,Psub0,LMfac,Jsub0);
+              prim_tei02.gemv(ilm,iel,Psub2,-LMfac,Jsub0);
+              prim_tei20.gemv(ilm,iel,Psub0,-LMfac,Jsub2);
+              prim_tei22.gemv(ilm,iel,Psub2,LMfac,Jsub2);
 
               Jsub0.reshape(Ni,Ni);
               Jsub2.reshape(Ni,Ni);
@@ -1635,7 +1626,7 @@ namespace helfem {
       }
 
       arma::mat TwoDBasis::exchange(const arma::mat & P0) const {
-        if(!prim_ktei00.size())
+        if(prim_tei00.empty())
           throw std::logic_error("Primitive teis have not been computed!\n");
 
         // Extend to boundaries
@@ -1787,12 +1778,10 @@ namespace helfem {
                     for(size_t ilm=0;ilm<lm_map.size();ilm++) {
                       if(!couple[ilm])
                         continue;
-                      // Index in tei array
-                      size_t idx=Nel*Nel*ilm + iel*Nel + jel;
-                      Ksub+=prim_ktei00[idx]*arma::vectorise(Rmat00[ilm].submat(ifirst,jfirst,ilast,jlast));
-                      Ksub+=prim_ktei02[idx]*arma::vectorise(Rmat02[ilm].submat(ifirst,jfirst,ilast,jlast));
-                      Ksub+=prim_ktei20[idx]*arma::vectorise(Rmat20[ilm].submat(ifirst,jfirst,ilast,jlast));
-                      Ksub+=prim_ktei22[idx]*arma::vectorise(Rmat22[ilm].submat(ifirst,jfirst,ilast,jlast));
+                      prim_tei00.exchange_gemv(ilm,iel,arma::vectorise(Rmat00[ilm].submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
+                      prim_tei02.exchange_gemv(ilm,iel,arma::vectorise(Rmat02[ilm].submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
+                      prim_tei20.exchange_gemv(ilm,iel,arma::vectorise(Rmat20[ilm].submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
+                      prim_tei22.exchange_gemv(ilm,iel,arma::vectorise(Rmat22[ilm].submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
                     }
 
                     Ksub.reshape(Ni,Nj);
@@ -1895,22 +1884,27 @@ namespace helfem {
         M=remove_boundaries(M);
       }
 
-      arma::cx_mat TwoDBasis::eval_bf(size_t iel, size_t irad, double cth, double phi) const {
-        // Evaluate spherical harmonics
-        arma::cx_vec sph(lval.n_elem);
-        for(size_t i=0;i<lval.n_elem;i++)
-          sph(i)=::spherical_harmonics(lval(i),mval(i),cth,phi);
-
+      void TwoDBasis::eval_bf(size_t iel, size_t irad, size_t nrad, double cth, double phi, arma::mat & cf, arma::mat & sf) const {
         // Evaluate radial functions
-        arma::mat rad(radial.get_bf(iel));
-        rad=rad.rows(irad,irad);
+        arma::mat rad(radial.get_bf(iel).rows(irad,irad+nrad-1));
 
-        // Form supermatrix
-        arma::cx_mat bf(rad.n_rows,lval.n_elem*rad.n_cols);
-        for(size_t i=0;i<lval.n_elem;i++)
-          bf.cols(i*rad.n_cols,(i+1)*rad.n_cols-1)=sph(i)*rad;
+        // Number of angular functions with m != 0
+        size_t Nsin(sin_ang.n_elem);
 
-        return bf;
+        // Form supermatrices. Y_lm(cth,phi) = Y_lm(cth,0) exp(i m phi)
+        // where Y_lm(cth,0) is real, so the real and imaginary parts
+        // of the functions are the cos(m phi) and sin(m phi) parts.
+        cf.zeros(rad.n_rows,lval.n_elem*rad.n_cols);
+        sf.zeros(rad.n_rows,Nsin*rad.n_cols);
+        size_t is=0;
+        for(size_t i=0;i<lval.n_elem;i++) {
+          double ang(std::real(::spherical_harmonics(lval(i),mval(i),cth,0.0)));
+          cf.cols(i*rad.n_cols,(i+1)*rad.n_cols-1)=ang*std::cos(mval(i)*phi)*rad;
+          if(mval(i)!=0) {
+            sf.cols(is*rad.n_cols,(is+1)*rad.n_cols-1)=ang*std::sin(mval(i)*phi)*rad;
+            is++;
+          }
+        }
       }
 
       arma::cx_mat TwoDBasis::eval_bf(size_t iel, const arma::vec & x, double cth, double phi) const {
@@ -1943,8 +1937,7 @@ namespace helfem {
           sph(i)=std::real(::spherical_harmonics(lval(flist[i]),mval(flist[i]),cth,0.0));
 
         // Evaluate radial functions
-        arma::mat rad(radial.get_bf(iel));
-        rad=rad.rows(irad,irad);
+        arma::mat rad(radial.get_bf(iel).rows(irad,irad));
 
         // Form supermatrix
         arma::mat bf(rad.n_rows,flist.size()*rad.n_cols);
@@ -1992,43 +1985,49 @@ namespace helfem {
 	return bf(pure_indices());
       }
 
-      void TwoDBasis::eval_df(size_t iel, size_t irad, double cth, double phi, arma::cx_mat & dr, arma::cx_mat & dth, arma::cx_mat & dphi) const {
-        // Evaluate spherical harmonics
-        arma::cx_vec sph(lval.n_elem);
-        for(size_t i=0;i<lval.n_elem;i++)
-          sph(i)=::spherical_harmonics(lval(i),mval(i),cth,phi);
-
+      void TwoDBasis::eval_df(size_t iel, size_t irad, size_t nrad, double cth, double phi, arma::mat & cdr, arma::mat & cdth, arma::mat & cdphi, arma::mat & sdr, arma::mat & sdth, arma::mat & sdphi) const {
         // Evaluate radial functions
-        arma::mat frad(radial.get_bf(iel));
-        arma::mat drad(radial.get_df(iel));
-        frad=frad.rows(irad,irad);
-        drad=drad.rows(irad,irad);
+        arma::mat frad(radial.get_bf(iel).rows(irad,irad+nrad-1));
+        arma::mat drad(radial.get_df(iel).rows(irad,irad+nrad-1));
+
+        // Number of angular functions with m != 0
+        size_t Nsin(sin_ang.n_elem);
 
         // Form supermatrices
-        dr.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
-        dth.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
-        dphi.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
+        cdr.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
+        cdth.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
+        cdphi.zeros(frad.n_rows,lval.n_elem*frad.n_cols);
+        sdr.zeros(frad.n_rows,Nsin*frad.n_cols);
+        sdth.zeros(frad.n_rows,Nsin*frad.n_cols);
+        sdphi.zeros(frad.n_rows,Nsin*frad.n_cols);
 
-        // Radial one is easy
-        for(size_t i=0;i<lval.n_elem;i++)
-          dr.cols(i*frad.n_cols,(i+1)*frad.n_cols-1)=sph(i)*drad;
-        // and so is phi
-        for(size_t i=0;i<lval.n_elem;i++)
-          dphi.cols(i*frad.n_cols,(i+1)*frad.n_cols-1)=std::complex<double>(0.0,mval(i))*sph(i)*frad;
-        // but theta is nastier
-        for(size_t i=0;i<lval.n_elem;i++) {
-          // cot th = 1/tan th = cos th / sin th
-          double cotth=cth/sqrt(1.0-cth*cth);
+        // cot th = 1/tan th = cos th / sin th
+        double cotth=cth/sqrt(1.0-cth*cth);
 
+        size_t is=0;
+        for(size_t i=0;i<lval.n_elem;i++) {
           int l(lval(i));
           int m(mval(i));
 
-          // Angular factor
-          std::complex<double> angfac(m*cotth*sph(i));
-          if(mval(i)<lval(i))
-            angfac+=sqrt((l-m)*(l+m+1))*std::exp(std::complex<double>(0,-phi))*::spherical_harmonics(lval(i),mval(i)+1,cth,phi);
-
-          dth.cols(i*frad.n_cols,(i+1)*frad.n_cols-1)=angfac*frad;
+          // Angular factor and its theta derivative at phi=0
+          double ang(std::real(::spherical_harmonics(l,m,cth,0.0)));
+          double dang(m*cotth*ang);
+          if(m<l)
+            dang+=sqrt((l-m)*(l+m+1))*std::real(::spherical_harmonics(l,m+1,cth,0.0));
+
+          double cosm(std::cos(m*phi));
+          double sinm(std::sin(m*phi));
+
+          // The phi derivative mixes the cos and sin parts
+          cdr.cols(i*frad.n_cols,(i+1)*frad.n_cols-1)=ang*cosm*drad;
+          cdth.cols(i*frad.n_cols,(i+1)*frad.n_cols-1)=dang*cosm*frad;
+          cdphi.cols(i*frad.n_cols,(i+1)*frad.n_cols-1)=-m*ang*sinm*frad;
+          if(m!=0) {
+            sdr.cols(is*frad.n_cols,(is+1)*frad.n_cols-1)=ang*sinm*drad;
+            sdth.cols(is*frad.n_cols,(is+1)*frad.n_cols-1)=dang*sinm*frad;
+            sdphi.cols(is*frad.n_cols,(is+1)*frad.n_cols-1)=m*ang*cosm*frad;
+            is++;
+          }
         }
       }
 
@@ -2054,6 +2053,10 @@ namespace helfem {
         return idx;
       }
 
+      const arma::uvec & TwoDBasis::sin_list(size_t iel) const {
+        return sin_el[iel];
+      }
+
       arma::uvec TwoDBasis::bf_list(size_t iel, int m) const {
         // Radial functions in element
         size_t ifirst, ilast;
@@ -2078,11 +2081,11 @@ namespace helfem {
         return radial.Nel();
       }
 
-      arma::vec TwoDBasis::get_wrad(size_t iel) const {
+      const arma::vec & TwoDBasis::get_wrad(size_t iel) const {
         return radial.get_wrad(iel);
       }
 
-      arma::vec TwoDBasis::get_r(size_t iel) const {
+      const arma::vec & TwoDBasis::get_r(size_t iel) const {
         return radial.get_r(iel);
       }
 
@@ -17,8 +17,10 @@
 #define DIATOMIC_BASIS_H
 
 #include <armadillo>
+#include <memory>
 #include "../general/gaunt.h"
 #include "../general/legendretable.h"
+#include "../general/elementtei.h"
 #include "polynomial_basis.h"
 
 namespace helfem {
@@ -31,8 +33,10 @@ namespace helfem {
         /// Quadrature weights
         arma::vec wq;
 
-        /// Polynomial basis
-        const polynomial_basis::PolynomialBasis * poly;
+        /// Polynomial basis, shared between copies
+        std::shared_ptr<const polynomial_basis::PolynomialBasis> poly;
+        /// Element variants of the polynomial basis: interior and last
+        std::vector< std::shared_ptr<const polynomial_basis::PolynomialBasis> > poly_variants;
         /// Primitive polynomial basis functions evaluated on the quadrature grid
         arma::mat bf;
         /// Primitive polynomial basis function derivatives evaluated on the quadrature grid
@@ -41,12 +45,23 @@ namespace helfem {
         /// Element boundary values
         arma::vec bval;
 
+        /// Basis function values at the quadrature points of each element
+        std::vector<arma::mat> el_bf;
+        /// Basis function derivatives at the quadrature points of each element
+        std::vector<arma::mat> el_df;
+        /// Radial quadrature weights of each element
+        std::vector<arma::vec> el_wrad;
+        /// Radial quadrature points of each element
+        std::vector<arma::vec> el_r;
+        /// Tabulate the element basis function tables
+        void form_element_tables();
+
 	/// Used basis function indices in element
 	arma::uvec basis_indices(size_t iel) const;
         /// Get basis functions in element
         arma::mat get_basis(const arma::mat & b, size_t iel) const;
         /// Get basis functions in element
-        polynomial_basis::PolynomialBasis * get_basis(const polynomial_basis::PolynomialBasis * poly, size_t iel) const;
+        const polynomial_basis::PolynomialBasis & element_poly(size_t iel) const;
 
       public:
         /// Dummy constructor
@@ -54,13 +69,6 @@ namespace helfem {
         /// Construct radial basis
         RadialBasis(const polynomial_basis::PolynomialBasis * poly, int n_quad, const arma::vec & bval);
 
-        /// Explicit copy constructor because of shared pointer
-        RadialBasis(const RadialBasis & rh);
-        /// Explicit assignment operator because of shared pointer
-        RadialBasis & operator=(const RadialBasis & rh);
-        /// Explicit destructor because of shared pointer
-        ~RadialBasis();
-
         /// Get number of quadrature points
         int get_nquad() const;
         /// Get boundary values
@@ -108,20 +116,22 @@ namespace helfem {
         /// Compute primitive two-electron integral
         arma::mat twoe_integral(int alpha, int beta, size_t iel, int L, int M, const legendretable::LegendreTable & legtab) const;
 
-        /// Get quadrature points
+        /// Get quadrature points for the Legendre function table: for every element, the element points followed by the points of its sub-intervals
         arma::vec get_chmu_quad() const;
-        /// Evaluate basis functions at quadrature points
-        arma::mat get_bf(size_t iel) const;
+        /// Index of the first point of element iel in the above
+        size_t chmu_quad_offset(size_t iel) const;
+        /// Basis functions at quadrature points (tabulated, no copy)
+        const arma::mat & get_bf(size_t iel) const;
         /// Evaluate basis functions at wanted point in [-1,1]
         arma::mat get_bf(size_t iel, const arma::vec & x) const;
         /// Evaluate all basis functions at given value of mu
         arma::mat get_bf(double mu) const;
-        /// Evaluate derivatives of basis functions at quadrature points
-        arma::mat get_df(size_t iel) const;
-        /// Get quadrature weights
-        arma::vec get_wrad(size_t iel) const;
-        /// Get r values
-        arma::vec get_r(size_t iel) const;
+        /// Derivatives of basis functions at quadrature points (tabulated, no copy)
+        const arma::mat & get_df(size_t iel) const;
+        /// Get quadrature weights (tabulated, no copy)
+        const arma::vec & get_wrad(size_t iel) const;
+        /// Get r values (tabulated, no copy)
+        const arma::vec & get_r(size_t iel) const;
       };
 
       /// L, |M| index type
@@ -147,6 +157,10 @@ namespace helfem {
         arma::ivec lval;
         /// Angular basis set: function m values
         arma::ivec mval;
+        /// Indices of the angular functions with m != 0
+        arma::uvec sin_ang;
+        /// Positions of the functions with m != 0 among bf_list(iel), for every element
+        std::vector<arma::uvec> sin_el;
 
         /// Gaunt coefficient table
         gaunt::Gaunt gaunt;
@@ -161,10 +175,10 @@ namespace helfem {
         std::vector<arma::mat> disjoint_P0, disjoint_P2;
         /// Auxiliary integrals, Qlm
         std::vector<arma::mat> disjoint_Q0, disjoint_Q2;
-        /// Primitive two-electron integrals: <Nel^2 * N_L>
-        std::vector<arma::mat> prim_tei00, prim_tei02, prim_tei20, prim_tei22;
-        /// Primitive two-electron integrals: <Nel^2 * N_L> sorted for exchange
-        std::vector<arma::mat> prim_ktei00, prim_ktei02, prim_ktei20, prim_ktei22;
+        /// Primitive in-element two-electron integrals: <N_LM x Nel>, used for both Coulomb and exchange
+        elementtei::ElementTEI prim_tei00, prim_tei02, prim_tei20, prim_tei22;
+        /// Store the primitive two-electron integrals in single precision?
+        bool single_tei;
 
         /// Add to radial submatrix
         void add_sub(arma::mat & M, size_t iang, size_t jang, const arma::mat & Msub) const;
@@ -223,7 +237,9 @@ namespace helfem {
         /// Memory for auxiliary two-electron integrals
         size_t mem_2el_aux() const;
 
-        /// Compute two-electron integrals
+        /// Store primitive two-electron integrals in single precision (default off); applies to integrals computed afterwards
+        void set_single_precision_tei(bool single);
+        /// Compute two-electron integrals; exchange reads the same integrals, so the flag no longer changes what is stored
         void compute_tei(bool exchange);
 
         /// Number of basis functions
@@ -287,8 +303,8 @@ namespace helfem {
         /// Get indices for wanted symmetry
         std::vector<arma::uvec> get_sym_idx(int isym) const;
 
-        /// Evaluate basis functions at quadrature points
-        arma::cx_mat eval_bf(size_t iel, size_t irad, double cth, double phi) const;
+        /// Evaluate the cos(m phi) and sin(m phi) parts of the basis functions at radial quadrature points irad, ..., irad+nrad-1: <nrad x Nbf>; the sin parts are only formed for the functions with m != 0
+        void eval_bf(size_t iel, size_t irad, size_t nrad, double cth, double phi, arma::mat & cf, arma::mat & sf) const;
         /// Evaluate basis functions at wanted x value
         arma::cx_mat eval_bf(size_t iel, const arma::vec & x, double cth, double phi) const;
         /// Evaluate basis functions with m=m at quadrature point
@@ -297,19 +313,21 @@ namespace helfem {
 	/// Evaluate basis functions at wanted point
 	arma::cx_vec eval_bf(double mu, double cth, double phi) const;
 
-        /// Evaluate basis functions derivatives at quadrature points
-        void eval_df(size_t iel, size_t irad, double cth, double phi, arma::cx_mat & dr, arma::cx_mat & dth, arma::cx_mat & dphi) const;
+        /// Evaluate the cos(m phi) and sin(m phi) parts of the basis function derivatives at radial quadrature points irad, ..., irad+nrad-1
+        void eval_df(size_t iel, size_t irad, size_t nrad, double cth, double phi, arma::mat & cdr, arma::mat & cdth, arma::mat & cdphi, arma::mat & sdr, arma::mat & sdth, arma::mat & sdphi) const;
         /// Get list of basis function indices in element
         arma::uvec bf_list(size_t iel) const;
         /// Get list of basis function indices in element with m=m
         arma::uvec bf_list(size_t iel, int m) const;
+        /// Get the positions of the functions with m != 0, which have a sin(m phi) part, among bf_list(iel)
+        const arma::uvec & sin_list(size_t iel) const;
 
         /// Get number of radial elements
         size_t get_rad_Nel() const;
         /// Get radial quadrature weights
-        arma::vec get_wrad(size_t iel) const;
+        const arma::vec & get_wrad(size_t iel) const;
         /// Get r values
-        arma::vec get_r(size_t iel) const;
+        const arma::vec & get_r(size_t iel) const;
 
         /// Electron density at nuclei
         arma::vec nuclear_density(const arma::mat & P) const;
@@ -0,0 +1,393 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "../general/cmdline.h"
+#include "../general/dftfuncs.h"
+#include "../general/spherical_harmonics.h"
+#include "utils.h"
+#include "../atomic/basis.h"
+#include "basis.h"
+#include "dftgrid.h"
+#include <helfem.h>
+#include <cstdio>
+
+using namespace helfem;
+
+/**
+ * Reference worker that evaluates the density and the Fock matrix
+ * with the complex basis functions chi_u = Y_lm R, as the DFT code
+ * did before the split into the real cos(m phi) and sin(m phi)
+ * parts. The quadrature weights and the scale factors are the same
+ * as in the real code, and the exchange-correlation functional is
+ * evaluated by the parent class.
+ */
+class ComplexWorker : public diatomic::dftgrid::DFTGridWorker {
+  /// Radial basis
+  const diatomic::basis::RadialBasis * radp;
+  /// Angular basis
+  arma::ivec lval, mval;
+
+  /// Values of the basis functions in the grid points, Nbf * Ngrid
+  arma::cx_mat cbf;
+  /// Radial, theta and phi gradients
+  arma::cx_mat cbf_rho, cbf_theta, cbf_phi;
+
+public:
+  /// Constructor
+  ComplexWorker(const diatomic::basis::TwoDBasis * basp_, const diatomic::basis::RadialBasis * radp_, int lang, int mang) : DFTGridWorker(basp_,lang,mang), radp(radp_) {
+    lval=basp_->get_lval();
+    mval=basp_->get_mval();
+  }
+
+  /// Compute the complex basis functions on the grid points of radial points irad, ..., irad+nrad-1 in element iel
+  void compute_bf(size_t iel, size_t irad, size_t nrad) {
+    if(do_tau || do_lapl)
+      throw std::logic_error("The complex reference is only implemented for LDA and GGA.\n");
+
+    // Function list, weights and scale factors
+    DFTGridWorker::compute_bf(iel,irad,nrad);
+
+    arma::mat frad(radp->get_bf(iel).rows(irad,irad+nrad-1));
+    arma::mat drad(radp->get_df(iel).rows(irad,irad+nrad-1));
+    size_t Nr(frad.n_cols);
+    if(lval.n_elem*Nr != bf_ind.n_elem) {
+      std::ostringstream oss;
+      oss << "Mismatch! Have " << bf_ind.n_elem << " basis function indices but " << lval.n_elem*Nr << " basis functions!\n";
+      throw std::logic_error(oss.str());
+    }
+
+    cbf.zeros(bf_ind.n_elem,wtot.n_elem);
+    if(do_grad) {
+      cbf_rho.zeros(bf_ind.n_elem,wtot.n_elem);
+      cbf_theta.zeros(bf_ind.n_elem,wtot.n_elem);
+      cbf_phi.zeros(bf_ind.n_elem,wtot.n_elem);
+    }
+
+    for(size_t ia=0;ia<cth.n_elem;ia++) {
+      // cot th = cos th / sin th
+      double cotth=cth(ia)/sqrt(1.0-cth(ia)*cth(ia));
+
+      for(size_t i=0;i<lval.n_elem;i++) {
+        int l(lval(i));
+        int m(mval(i));
+        std::complex<double> sph(::spherical_harmonics(l,m,cth(ia),phi(ia)));
+
+        arma::span rows(i*Nr,(i+1)*Nr-1);
+        arma::span cols(ia*nrad,(ia+1)*nrad-1);
+        cbf(rows,cols)=sph*arma::strans(frad);
+        if(do_grad) {
+          cbf_rho(rows,cols)=sph*arma::strans(drad);
+          cbf_phi(rows,cols)=std::complex<double>(0.0,m)*sph*arma::strans(frad);
+
+          std::complex<double> angfac(m*cotth*sph);
+          if(m<l)
+            angfac+=std::sqrt((double) ((l-m)*(l+m+1)))*std::exp(std::complex<double>(0.0,-phi(ia)))*::spherical_harmonics(l,m+1,cth(ia),phi(ia));
+          cbf_theta(rows,cols)=angfac*arma::strans(frad);
+        }
+      }
+    }
+  }
+
+  /// Update values of density, restricted calculation
+  void update_density(const arma::mat & P0) {
+    arma::mat P(basp->expand_boundaries(P0)(bf_ind,bf_ind));
+    polarized=false;
+
+    arma::cx_mat cPv(P*cbf);
+    rho.zeros(1,wtot.n_elem);
+    for(size_t ip=0;ip<wtot.n_elem;ip++)
+      rho(0,ip)=std::real(arma::cdot(cbf.col(ip),cPv.col(ip)));
+
+    if(do_grad) {
+      grho.zeros(3,wtot.n_elem);
+      sigma.zeros(1,wtot.n_elem);
+      for(size_t ip=0;ip<wtot.n_elem;ip++) {
+        double g_rad=grho(0,ip)=2.0*std::real(arma::cdot(cbf_rho.col(ip),cPv.col(ip)))/scale_r(ip);
+        double g_th=grho(1,ip)=2.0*std::real(arma::cdot(cbf_theta.col(ip),cPv.col(ip)))/scale_theta(ip);
+        double g_phi=grho(2,ip)=2.0*std::real(arma::cdot(cbf_phi.col(ip),cPv.col(ip)))/scale_phi(ip);
+        sigma(0,ip)=g_rad*g_rad + g_th*g_th + g_phi*g_phi;
+      }
+    }
+  }
+
+  /// Update values of density, unrestricted calculation
+  void update_density(const arma::mat & Pa0, const arma::mat & Pb0) {
+    arma::mat Pa(basp->expand_boundaries(Pa0)(bf_ind,bf_ind));
+    arma::mat Pb(basp->expand_boundaries(Pb0)(bf_ind,bf_ind));
+    polarized=true;
+
+    arma::cx_mat cPav(Pa*cbf);
+    arma::cx_mat cPbv(Pb*cbf);
+    rho.zeros(2,wtot.n_elem);
+    for(size_t ip=0;ip<wtot.n_elem;ip++) {
+      rho(0,ip)=std::real(arma::cdot(cbf.col(ip),cPav.col(ip)));
+      rho(1,ip)=std::real(arma::cdot(cbf.col(ip),cPbv.col(ip)));
+    }
+
+    if(do_grad) {
+      grho.zeros(6,wtot.n_elem);
+      sigma.zeros(3,wtot.n_elem);
+      for(size_t ip=0;ip<wtot.n_elem;ip++) {
+        double ga_rad=grho(0,ip)=2.0*std::real(arma::cdot(cbf_rho.col(ip),cPav.col(ip)))/scale_r(ip);
+        double ga_th=grho(1,ip)=2.0*std::real(arma::cdot(cbf_theta.col(ip),cPav.col(ip)))/scale_theta(ip);
+        double ga_phi=grho(2,ip)=2.0*std::real(arma::cdot(cbf_phi.col(ip),cPav.col(ip)))/scale_phi(ip);
+
+        double gb_rad=grho(3,ip)=2.0*std::real(arma::cdot(cbf_rho.col(ip),cPbv.col(ip)))/scale_r(ip);
+        double gb_th=grho(4,ip)=2.0*std::real(arma::cdot(cbf_theta.col(ip),cPbv.col(ip)))/scale_theta(ip);
+        double gb_phi=grho(5,ip)=2.0*std::real(arma::cdot(cbf_phi.col(ip),cPbv.col(ip)))/scale_phi(ip);
+
+        sigma(0,ip)=ga_rad*ga_rad + ga_th*ga_th + ga_phi*ga_phi;
+        sigma(1,ip)=ga_rad*gb_rad + ga_th*gb_th + ga_phi*gb_phi;
+        sigma(2,ip)=gb_rad*gb_rad + gb_th*gb_th + gb_phi*gb_phi;
+      }
+    }
+  }
+
+  /// Evaluate Fock matrix of the element, restricted calculation
+  void eval_Fxc(arma::mat & H) const {
+    arma::rowvec vrho(vxc.row(0));
+    vrho%=wtot;
+    diatomic::dftgrid::increment_lda< std::complex<double> >(H,vrho,cbf);
+
+    if(do_gga) {
+      arma::rowvec vs(vsigma.row(0));
+      arma::mat gr(arma::trans(grho.rows(0,2)));
+      for(size_t i=0;i<gr.n_rows;i++) {
+        gr(i,0)*=2.0*wtot(i)*vs(i)/scale_r(i);
+        gr(i,1)*=2.0*wtot(i)*vs(i)/scale_theta(i);
+        gr(i,2)*=2.0*wtot(i)*vs(i)/scale_phi(i);
+      }
+      diatomic::dftgrid::increment_gga< std::complex<double> >(H,gr,cbf,cbf_rho,cbf_theta,cbf_phi);
+    }
+  }
+
+  /// Evaluate Fock matrices of the element, unrestricted calculation
+  void eval_Fxc(arma::mat & Ha, arma::mat & Hb) const {
+    arma::rowvec vrhoa(vxc.row(0));
+    vrhoa%=wtot;
+    diatomic::dftgrid::increment_lda< std::complex<double> >(Ha,vrhoa,cbf);
+    arma::rowvec vrhob(vxc.row(1));
+    vrhob%=wtot;
+    diatomic::dftgrid::increment_lda< std::complex<double> >(Hb,vrhob,cbf);
+
+    if(do_gga) {
+      arma::rowvec vs_aa(vsigma.row(0));
+      arma::rowvec vs_ab(vsigma.row(1));
+      arma::rowvec vs_bb(vsigma.row(2));
+      arma::mat gr_a0(arma::trans(grho.rows(0,2)));
+      arma::mat gr_b0(arma::trans(grho.rows(3,5)));
+
+      arma::mat gr_a(gr_a0), gr_b(gr_b0);
+      for(size_t i=0;i<gr_a.n_rows;i++) {
+        gr_a(i,0)=wtot(i)*(2.0*vs_aa(i)*gr_a0(i,0) + vs_ab(i)*gr_b0(i,0))/scale_r(i);
+        gr_a(i,1)=wtot(i)*(2.0*vs_aa(i)*gr_a0(i,1) + vs_ab(i)*gr_b0(i,1))/scale_theta(i);
+        gr_a(i,2)=wtot(i)*(2.0*vs_aa(i)*gr_a0(i,2) + vs_ab(i)*gr_b0(i,2))/scale_phi(i);
+
+        gr_b(i,0)=wtot(i)*(2.0*vs_bb(i)*gr_b0(i,0) + vs_ab(i)*gr_a0(i,0))/scale_r(i);
+        gr_b(i,1)=wtot(i)*(2.0*vs_bb(i)*gr_b0(i,1) + vs_ab(i)*gr_a0(i,1))/scale_theta(i);
+        gr_b(i,2)=wtot(i)*(2.0*vs_bb(i)*gr_b0(i,2) + vs_ab(i)*gr_a0(i,2))/scale_phi(i);
+      }
+      diatomic::dftgrid::increment_gga< std::complex<double> >(Ha,gr_a,cbf,cbf_rho,cbf_theta,cbf_phi);
+      diatomic::dftgrid::increment_gga< std::complex<double> >(Hb,gr_b,cbf,cbf_rho,cbf_theta,cbf_phi);
+    }
+  }
+};
+
+/// Exchange-correlation energy, number of electrons and Fock matrices with the complex basis functions; Pb is ignored and Hb is not formed if restricted
+void complex_Fxc(const diatomic::basis::TwoDBasis & basis, const diatomic::basis::RadialBasis & radial, int lang, int mang, int x_func, int c_func, bool restricted, const arma::mat & Pa, const arma::mat & Pb, arma::mat & Ha, arma::mat & Hb, double & Exc, double & Nel, double thr) {
+  ComplexWorker grid(&basis,&radial,lang,mang);
+  grid.check_grad_tau_lapl(x_func,c_func);
+
+  arma::vec x_pars, c_pars;
+  Ha.zeros(basis.Ndummy(),basis.Ndummy());
+  Hb.zeros(basis.Ndummy(),basis.Ndummy());
+  Exc=0.0;
+  Nel=0.0;
+  for(size_t iel=0;iel<basis.get_rad_Nel();iel++) {
+    arma::uvec idx(basis.bf_list(iel));
+    arma::mat Hael(idx.n_elem,idx.n_elem,arma::fill::zeros);
+    arma::mat Hbel(idx.n_elem,idx.n_elem,arma::fill::zeros);
+
+    grid.compute_bf(iel,0,basis.get_r(iel).n_elem);
+    if(restricted)
+      grid.update_density(Pa);
+    else
+      grid.update_density(Pa,Pb);
+    Nel+=grid.compute_Nel();
+
+    grid.init_xc();
+    if(thr>0.0)
+      grid.screen_density(thr);
+    if(x_func>0)
+      grid.compute_xc(x_func, x_pars);
+    if(c_func>0)
+      grid.compute_xc(c_func, c_pars);
+    Exc+=grid.eval_Exc();
+
+    if(restricted)
+      grid.eval_Fxc(Hael);
+    else
+      grid.eval_Fxc(Hael,Hbel);
+    Ha(idx,idx)+=Hael;
+    Hb(idx,idx)+=Hbel;
+  }
+
+  Ha=basis.remove_boundaries(Ha);
+  Hb=basis.remove_boundaries(Hb);
+}
+
+/// Lowest eigenvectors of the core Hamiltonian in the subspace of the wanted functions
+arma::mat core_orbitals(const arma::mat & H0, const arma::mat & S, const arma::uvec & idx, size_t norb) {
+  arma::vec sval;
+  arma::mat svec;
+  arma::eig_sym(sval,svec,S(idx,idx));
+  arma::mat X(svec*arma::diagmat(arma::pow(sval,-0.5)));
+
+  arma::vec E;
+  arma::mat V;
+  arma::eig_sym(E,V,arma::trans(X)*H0(idx,idx)*X);
+
+  arma::mat C(S.n_rows,norb,arma::fill::zeros);
+  C.rows(idx)=X*V.cols(0,norb-1);
+  return C;
+}
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("Z1", 0, "first nuclear charge", false, 3);
+  parser.add<int>("Z2", 0, "second nuclear charge", false, 1);
+  parser.add<double>("Rbond", 0, "internuclear distance", false, 3.0);
+  parser.add<int>("lmax", 0, "maximum l quantum number", false, 4);
+  parser.add<int>("mmax", 0, "maximum m quantum number", false, 2);
+  parser.add<double>("Rmax", 0, "practical infinity in au", false, 40.0);
+  parser.add<int>("grid", 0, "type of grid: 1 for linear, 2 for quadratic, 3 for polynomial, 4 for exponential", false, 4);
+  parser.add<double>("zexp", 0, "parameter in radial grid", false, 1.0);
+  parser.add<int>("nelem", 0, "number of elements", false, 5);
+  parser.add<int>("nnodes", 0, "number of nodes per element", false, 8);
+  parser.add<int>("nquad", 0, "number of quadrature points", false, 0);
+  parser.add<int>("primbas", 0, "primitive radial basis", false, 4);
+  parser.add<int>("nsigma", 0, "number of alpha sigma orbitals, one less for beta", false, 2);
+  parser.add<int>("mocc", 0, "m value of the singly occupied alpha orbital", false, 1);
+  parser.add<std::string>("lda", 0, "LDA functional", false, "lda_x-lda_c_vwn");
+  parser.add<std::string>("gga", 0, "GGA functional", false, "gga_x_pbe-gga_c_pbe");
+  parser.add<int>("ldft", 0, "theta rule for dft quadrature (0 for auto)", false, 0);
+  parser.add<int>("mdft", 0, "phi rule for dft quadrature (0 for auto)", false, 0);
+  parser.add<double>("dftthr", 0, "density threshold for dft", false, 1e-12);
+  parser.add<double>("thr", 0, "threshold for real vs complex", false, 1e-10);
+  parser.parse_check(argc, argv);
+
+  int Z1(parser.get<int>("Z1"));
+  int Z2(parser.get<int>("Z2"));
+  double Rbond(parser.get<double>("Rbond"));
+  int lmax(parser.get<int>("lmax"));
+  int mmax(parser.get<int>("mmax"));
+  double Rmax(parser.get<double>("Rmax"));
+  int igrid(parser.get<int>("grid"));
+  double zexp(parser.get<double>("zexp"));
+  int Nelem(parser.get<int>("nelem"));
+  int Nnodes(parser.get<int>("nnodes"));
+  int Nquad(parser.get<int>("nquad"));
+  int primbas(parser.get<int>("primbas"));
+  int nsigma(parser.get<int>("nsigma"));
+  int mocc(parser.get<int>("mocc"));
+  int ldft(parser.get<int>("ldft"));
+  int mdft(parser.get<int>("mdft"));
+  double dftthr(parser.get<double>("dftthr"));
+  double thr(parser.get<double>("thr"));
+
+  if(mocc==0 || std::abs(mocc)>mmax)
+    throw std::logic_error("The open-shell orbital must have 0 < |m| <= mmax.\n");
+  if(nsigma<1)
+    throw std::logic_error("Need at least one sigma orbital.\n");
+
+  polynomial_basis::PolynomialBasis *poly(polynomial_basis::get_basis(primbas,Nnodes,false));
+  if(Nquad==0)
+    Nquad=5*poly->get_nbf();
+
+  arma::ivec lmmax(mmax+1);
+  lmmax.fill(lmax);
+  arma::ivec lval, mval;
+  diatomic::basis::lm_to_l_m(lmmax,lval,mval);
+
+  double mumax(utils::arcosh(Rmax/(0.5*Rbond)));
+  arma::vec bval(atomic::basis::normal_grid(Nelem, mumax, igrid, zexp));
+
+  diatomic::basis::TwoDBasis basis(Z1, Z2, Rbond, poly, Nquad, bval, lval, mval, 0, false);
+  // The same radial basis for the complex reference
+  diatomic::basis::RadialBasis radial(poly, Nquad, bval);
+  delete poly;
+  printf("Basis set consists of %i angular shells composed of %i radial functions, totaling %i basis functions\n",(int) basis.Nang(), (int) basis.Nrad(), (int) basis.Nbf());
+
+  if(ldft==0)
+    ldft=4*lmax+12;
+  if(mdft==0)
+    mdft=4*lmmax.n_elem+5;
+
+  // Open-shell density from the core Hamiltonian: nsigma alpha and
+  // nsigma-1 beta sigma orbitals, and one alpha orbital with m=mocc
+  arma::mat S(basis.overlap());
+  arma::mat H0(basis.kinetic()+basis.nuclear());
+  arma::mat Csigma(core_orbitals(H0,S,basis.m_indices(0),nsigma));
+  arma::mat Cm(core_orbitals(H0,S,basis.m_indices(mocc),1));
+  arma::mat Ca(arma::join_rows(Csigma,Cm));
+  arma::mat Pa(Ca*arma::trans(Ca));
+  arma::mat Pb(S.n_rows,S.n_cols,arma::fill::zeros);
+  if(nsigma>1)
+    Pb=Csigma.cols(0,nsigma-2)*arma::trans(Csigma.cols(0,nsigma-2));
+  arma::mat P(Pa+Pb);
+  printf("Density has %i alpha and %i beta electrons, the last alpha one with m = %i\n",nsigma+1,nsigma-1,mocc);
+
+  diatomic::dftgrid::DFTGrid grid(&basis,ldft,mdft);
+
+  std::string methods[]={parser.get<std::string>("lda"),parser.get<std::string>("gga")};
+  const char * labels[]={"LDA","GGA"};
+
+  double maxdiff=0.0;
+  for(int im=0;im<2;im++) {
+    int x_func, c_func;
+    ::parse_xc_func(x_func, c_func, methods[im]);
+    arma::vec x_pars, c_pars;
+
+    for(int irestr=0;irestr<2;irestr++) {
+      bool restricted(irestr==1);
+
+      arma::mat Ha, Hb;
+      double Exc, Nel, Ekin;
+      if(restricted)
+        grid.eval_Fxc(x_func, x_pars, c_func, c_pars, P, Ha, Exc, Nel, Ekin, dftthr);
+      else
+        grid.eval_Fxc(x_func, x_pars, c_func, c_pars, Pa, Pb, Ha, Hb, Exc, Nel, Ekin, true, dftthr);
+
+      arma::mat Haref, Hbref;
+      double Excref, Nelref;
+      complex_Fxc(basis, radial, ldft, mdft, x_func, c_func, restricted, restricted ? P : Pa, Pb, Haref, Hbref, Excref, Nelref, dftthr);
+
+      double dE(std::abs(Exc-Excref));
+      double dN(std::abs(Nel-Nelref));
+      double dHa(utils::max_rel_diff(Haref,Ha));
+      double dHb(restricted ? 0.0 : utils::max_rel_diff(Hbref,Hb));
+
+      printf("%s %s: Exc % .12f real, % .12f complex, difference %e\n",labels[im],restricted ? "restricted" : "unrestricted",Exc,Excref,dE);
+      printf("%s %s: Nel difference %e, relative Fock matrix differences %e %e\n",labels[im],restricted ? "restricted" : "unrestricted",dN,dHa,dHb);
+      maxdiff=std::max(maxdiff,std::max(std::max(dE,dN),std::max(dHa,dHb)));
+    }
+  }
+
+  printf("Maximum difference of real vs complex evaluation %e\n",maxdiff);
+
+  return utils::test_status(maxdiff>thr);
+}
@@ -14,6 +14,7 @@
  * of the License, or (at your option) any later version.
  */
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include <cstdio>
@@ -54,33 +55,36 @@ namespace helfem {
           throw std::runtime_error("Error - density matrix is empty!\n");
         }
         arma::mat P(basp->expand_boundaries(P0)(bf_ind,bf_ind));
+        // The sin parts only couple to each other
+        arma::mat Ps(P(sin_ind,sin_ind));
 
         // Non-polarized calculation.
         polarized=false;
 
         // Update density vector
-        Pv=P*arma::conj(bf);
+        Pv=P*bf;
+        Psv=Ps*bfs;
 
         // Calculate density
         rho.zeros(1,wtot.n_elem);
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
         for(size_t ip=0;ip<wtot.n_elem;ip++)
-          rho(0,ip)=std::real(arma::dot(Pv.col(ip),bf.col(ip)));
+          rho(0,ip)=arma::dot(Pv.col(ip),bf.col(ip))+arma::dot(Psv.col(ip),bfs.col(ip));
 
         // Calculate gradient
         if(do_grad) {
           grho.zeros(3,wtot.n_elem);
           sigma.zeros(1,wtot.n_elem);
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ip=0;ip<wtot.n_elem;ip++) {
             // Calculate values
-            double g_rad=grho(0,ip)=2.0*std::real(arma::dot(Pv.col(ip),bf_rho.col(ip)))/scale_r(ip);
-            double g_th=grho(1,ip)=2.0*std::real(arma::dot(Pv.col(ip),bf_theta.col(ip)))/scale_theta(ip);
-            double g_phi=grho(2,ip)=2.0*std::real(arma::dot(Pv.col(ip),bf_phi.col(ip)))/scale_phi(ip);
+            double g_rad=grho(0,ip)=2.0*(arma::dot(Pv.col(ip),bf_rho.col(ip))+arma::dot(Psv.col(ip),bfs_rho.col(ip)))/scale_r(ip);
+            double g_th=grho(1,ip)=2.0*(arma::dot(Pv.col(ip),bf_theta.col(ip))+arma::dot(Psv.col(ip),bfs_theta.col(ip)))/scale_theta(ip);
+            double g_phi=grho(2,ip)=2.0*(arma::dot(Pv.col(ip),bf_phi.col(ip))+arma::dot(Psv.col(ip),bfs_phi.col(ip)))/scale_phi(ip);
             // Compute sigma as well
             sigma(0,ip)=g_rad*g_rad + g_th*g_th + g_phi*g_phi;
           }
@@ -92,19 +96,22 @@ namespace helfem {
           tau.zeros(1,wtot.n_elem);
 
           // Update helpers
-          Pv_rho=P*arma::conj(bf_rho);
-          Pv_theta=P*arma::conj(bf_theta);
-          Pv_phi=P*arma::conj(bf_phi);
+          Pv_rho=P*bf_rho;
+          Pv_theta=P*bf_theta;
+          Pv_phi=P*bf_phi;
+          Psv_rho=Ps*bfs_rho;
+          Psv_theta=Ps*bfs_theta;
+          Psv_phi=Ps*bfs_phi;
 
           // Calculate values
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ip=0;ip<wtot.n_elem;ip++) {
             // Gradient term
-            double kinrho(std::real(arma::dot(Pv_rho.col(ip),bf_rho.col(ip)))/std::pow(scale_r(ip),2));
-            double kintheta(std::real(arma::dot(Pv_theta.col(ip),bf_theta.col(ip)))/std::pow(scale_theta(ip),2));
-            double kinphi(std::real(arma::dot(Pv_phi.col(ip),bf_phi.col(ip)))/std::pow(scale_phi(ip),2));
+            double kinrho((arma::dot(Pv_rho.col(ip),bf_rho.col(ip))+arma::dot(Psv_rho.col(ip),bfs_rho.col(ip)))/std::pow(scale_r(ip),2));
+            double kintheta((arma::dot(Pv_theta.col(ip),bf_theta.col(ip))+arma::dot(Psv_theta.col(ip),bfs_theta.col(ip)))/std::pow(scale_theta(ip),2));
+            double kinphi((arma::dot(Pv_phi.col(ip),bf_phi.col(ip))+arma::dot(Psv_phi.col(ip),bfs_phi.col(ip)))/std::pow(scale_phi(ip),2));
             double kin(kinrho + kintheta + kinphi);
 
             // Store values
@@ -127,18 +134,23 @@ namespace helfem {
         // Update density vector
         arma::mat Pa(basp->expand_boundaries(Pa0)(bf_ind,bf_ind));
         arma::mat Pb(basp->expand_boundaries(Pb0)(bf_ind,bf_ind));
+        // The sin parts only couple to each other
+        arma::mat Pas(Pa(sin_ind,sin_ind));
+        arma::mat Pbs(Pb(sin_ind,sin_ind));
 
-        Pav=Pa*arma::conj(bf);
-        Pbv=Pb*arma::conj(bf);
+        Pav=Pa*bf;
+        Pbv=Pb*bf;
+        Pasv=Pas*bfs;
+        Pbsv=Pbs*bfs;
 
         // Calculate density
         rho.zeros(2,wtot.n_elem);
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
         for(size_t ip=0;ip<wtot.n_elem;ip++) {
-          rho(0,ip)=std::real(arma::dot(Pav.col(ip),bf.col(ip)));
-          rho(1,ip)=std::real(arma::dot(Pbv.col(ip),bf.col(ip)));
+          rho(0,ip)=arma::dot(Pav.col(ip),bf.col(ip))+arma::dot(Pasv.col(ip),bfs.col(ip));
+          rho(1,ip)=arma::dot(Pbv.col(ip),bf.col(ip))+arma::dot(Pbsv.col(ip),bfs.col(ip));
 
           /*
             double na=compute_density(Pa0,*basp,grid[ip].r);
@@ -154,16 +166,16 @@ namespace helfem {
           grho.zeros(6,wtot.n_elem);
           sigma.zeros(3,wtot.n_elem);
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ip=0;ip<wtot.n_elem;ip++) {
-            double ga_rad=grho(0,ip)=2.0*std::real(arma::dot(Pav.col(ip),bf_rho.col(ip)))/scale_r(ip);
-            double ga_th=grho(1,ip)=2.0*std::real(arma::dot(Pav.col(ip),bf_theta.col(ip)))/scale_theta(ip);
-            double ga_phi=grho(2,ip)=2.0*std::real(arma::dot(Pav.col(ip),bf_phi.col(ip)))/scale_phi(ip);
+            double ga_rad=grho(0,ip)=2.0*(arma::dot(Pav.col(ip),bf_rho.col(ip))+arma::dot(Pasv.col(ip),bfs_rho.col(ip)))/scale_r(ip);
+            double ga_th=grho(1,ip)=2.0*(arma::dot(Pav.col(ip),bf_theta.col(ip))+arma::dot(Pasv.col(ip),bfs_theta.col(ip)))/scale_theta(ip);
+            double ga_phi=grho(2,ip)=2.0*(arma::dot(Pav.col(ip),bf_phi.col(ip))+arma::dot(Pasv.col(ip),bfs_phi.col(ip)))/scale_phi(ip);
 
-            double gb_rad=grho(3,ip)=2.0*std::real(arma::dot(Pbv.col(ip),bf_rho.col(ip)))/scale_r(ip);
-            double gb_th=grho(4,ip)=2.0*std::real(arma::dot(Pbv.col(ip),bf_theta.col(ip)))/scale_theta(ip);
-            double gb_phi=grho(5,ip)=2.0*std::real(arma::dot(Pbv.col(ip),bf_phi.col(ip)))/scale_phi(ip);
+            double gb_rad=grho(3,ip)=2.0*(arma::dot(Pbv.col(ip),bf_rho.col(ip))+arma::dot(Pbsv.col(ip),bfs_rho.col(ip)))/scale_r(ip);
+            double gb_th=grho(4,ip)=2.0*(arma::dot(Pbv.col(ip),bf_theta.col(ip))+arma::dot(Pbsv.col(ip),bfs_theta.col(ip)))/scale_theta(ip);
+            double gb_phi=grho(5,ip)=2.0*(arma::dot(Pbv.col(ip),bf_phi.col(ip))+arma::dot(Pbsv.col(ip),bfs_phi.col(ip)))/scale_phi(ip);
 
             // Compute sigma as well
             sigma(0,ip)=ga_rad*ga_rad + ga_th*ga_th + ga_phi*ga_phi;
@@ -178,28 +190,34 @@ namespace helfem {
           tau.resize(2,wtot.n_elem);
 
           // Update helpers
-          Pav_rho=Pa*arma::conj(bf_rho);
-          Pav_theta=Pa*arma::conj(bf_theta);
-          Pav_phi=Pa*arma::conj(bf_phi);
-
-          Pbv_rho=Pb*arma::conj(bf_rho);
-          Pbv_theta=Pb*arma::conj(bf_theta);
-          Pbv_phi=Pb*arma::conj(bf_phi);
+          Pav_rho=Pa*bf_rho;
+          Pav_theta=Pa*bf_theta;
+          Pav_phi=Pa*bf_phi;
+          Pasv_rho=Pas*bfs_rho;
+          Pasv_theta=Pas*bfs_theta;
+          Pasv_phi=Pas*bfs_phi;
+
+          Pbv_rho=Pb*bf_rho;
+          Pbv_theta=Pb*bf_theta;
+          Pbv_phi=Pb*bf_phi;
+          Pbsv_rho=Pbs*bfs_rho;
+          Pbsv_theta=Pbs*bfs_theta;
+          Pbsv_phi=Pbs*bfs_phi;
 
           // Calculate values
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ip=0;ip<wtot.n_elem;ip++) {
             // Gradient term
-            double kinar=std::real(arma::dot(Pav_rho.col(ip),bf_rho.col(ip)))/std::pow(scale_r(ip),2);
-            double kinath=std::real(arma::dot(Pav_theta.col(ip),bf_theta.col(ip)))/std::pow(scale_theta(ip),2);
-            double kinaphi=std::real(arma::dot(Pav_phi.col(ip),bf_phi.col(ip)))/std::pow(scale_phi(ip),2);
+            double kinar=(arma::dot(Pav_rho.col(ip),bf_rho.col(ip))+arma::dot(Pasv_rho.col(ip),bfs_rho.col(ip)))/std::pow(scale_r(ip),2);
+            double kinath=(arma::dot(Pav_theta.col(ip),bf_theta.col(ip))+arma::dot(Pasv_theta.col(ip),bfs_theta.col(ip)))/std::pow(scale_theta(ip),2);
+            double kinaphi=(arma::dot(Pav_phi.col(ip),bf_phi.col(ip))+arma::dot(Pasv_phi.col(ip),bfs_phi.col(ip)))/std::pow(scale_phi(ip),2);
             double kina(kinar + kinath + kinaphi);
 
-            double kinbr=std::real(arma::dot(Pbv_rho.col(ip),bf_rho.col(ip)))/std::pow(scale_r(ip),2);
-            double kinbth=std::real(arma::dot(Pbv_theta.col(ip),bf_theta.col(ip)))/std::pow(scale_theta(ip),2);
-            double kinbphi=std::real(arma::dot(Pbv_phi.col(ip),bf_phi.col(ip)))/std::pow(scale_phi(ip),2);
+            double kinbr=(arma::dot(Pbv_rho.col(ip),bf_rho.col(ip))+arma::dot(Pbsv_rho.col(ip),bfs_rho.col(ip)))/std::pow(scale_r(ip),2);
+            double kinbth=(arma::dot(Pbv_theta.col(ip),bf_theta.col(ip))+arma::dot(Pbsv_theta.col(ip),bfs_theta.col(ip)))/std::pow(scale_theta(ip),2);
+            double kinbphi=(arma::dot(Pbv_phi.col(ip),bf_phi.col(ip))+arma::dot(Pbsv_phi.col(ip),bfs_phi.col(ip)))/std::pow(scale_phi(ip),2);
             double kinb(kinbr + kinbth + kinbphi);
 
             // Store values
@@ -214,7 +232,7 @@ namespace helfem {
       void DFTGridWorker::screen_density(double thr) {
         if(polarized) {
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ip=0;ip<wtot.n_elem;ip++) {
             if(rho(0,ip)+rho(1,ip) <= thr) {
@@ -235,7 +253,7 @@ namespace helfem {
           }
         } else {
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ip=0;ip<wtot.n_elem;ip++) {
             if(rho(0,ip) <= thr) {
@@ -518,7 +536,11 @@ namespace helfem {
         // Calculate in subspace
         arma::mat S(bf_ind.n_elem,bf_ind.n_elem);
         S.zeros();
-        increment_lda< std::complex<double> >(S,wtot,bf);
+        increment_lda<double>(S,wtot,bf);
+        arma::mat Ss(sin_ind.n_elem,sin_ind.n_elem);
+        Ss.zeros();
+        increment_lda<double>(Ss,wtot,bfs);
+        S(sin_ind,sin_ind)+=Ss;
         // Increment
         So.submat(bf_ind,bf_ind)+=S;
       }
@@ -527,9 +549,15 @@ namespace helfem {
         // Calculate in subspace
         arma::mat T(bf_ind.n_elem,bf_ind.n_elem);
         T.zeros();
-        increment_lda< std::complex<double> >(T,wtot/(scale_r%scale_r),bf_rho);
-        increment_lda< std::complex<double> >(T,wtot/(scale_theta%scale_theta),bf_theta);
-        increment_lda< std::complex<double> >(T,wtot/(scale_phi%scale_phi),bf_phi);
+        increment_lda<double>(T,wtot/(scale_r%scale_r),bf_rho);
+        increment_lda<double>(T,wtot/(scale_theta%scale_theta),bf_theta);
+        increment_lda<double>(T,wtot/(scale_phi%scale_phi),bf_phi);
+        arma::mat Ts(sin_ind.n_elem,sin_ind.n_elem);
+        Ts.zeros();
+        increment_lda<double>(Ts,wtot/(scale_r%scale_r),bfs_rho);
+        increment_lda<double>(Ts,wtot/(scale_theta%scale_theta),bfs_theta);
+        increment_lda<double>(Ts,wtot/(scale_phi%scale_phi),bfs_phi);
+        T(sin_ind,sin_ind)+=Ts;
         // Increment
         To.submat(bf_ind,bf_ind)+=0.5*T;
       }
@@ -539,9 +567,11 @@ namespace helfem {
           throw std::runtime_error("Refusing to compute restricted Fock matrix with unrestricted density.\n");
         }
 
-        // Work matrix
+        // Work matrices for the cos and sin parts
         arma::mat H(bf_ind.n_elem,bf_ind.n_elem);
         H.zeros();
+        arma::mat Hs(sin_ind.n_elem,sin_ind.n_elem);
+        Hs.zeros();
 
         {
           // LDA potential
@@ -549,7 +579,8 @@ namespace helfem {
           // Multiply weights into potential
           vrho%=wtot;
           // Increment matrix
-          increment_lda< std::complex<double> >(H,vrho,bf);
+          increment_lda<double>(H,vrho,bf);
+          increment_lda<double>(Hs,vrho,bfs);
         }
 
         if(do_gga) {
@@ -565,21 +596,26 @@ namespace helfem {
             gr(i,2)*=2.0*wtot(i)*vs(i)/scale_phi(i);
           }
           // Increment matrix
-          increment_gga< std::complex<double> >(H,gr,bf,bf_rho,bf_theta,bf_phi);
+          increment_gga<double>(H,gr,bf,bf_rho,bf_theta,bf_phi);
+          increment_gga<double>(Hs,gr,bfs,bfs_rho,bfs_theta,bfs_phi);
         }
 
         if(do_mgga_t) {
           arma::rowvec vt(vtau.row(0));
           vt%=0.5*wtot;
 
-          increment_lda< std::complex<double> >(H,vt/arma::square(scale_r),bf_rho);
-          increment_lda< std::complex<double> >(H,vt/arma::square(scale_theta),bf_theta);
-          increment_lda< std::complex<double> >(H,vt/arma::square(scale_phi),bf_phi);
+          increment_lda<double>(H,vt/arma::square(scale_r),bf_rho);
+          increment_lda<double>(H,vt/arma::square(scale_theta),bf_theta);
+          increment_lda<double>(H,vt/arma::square(scale_phi),bf_phi);
+          increment_lda<double>(Hs,vt/arma::square(scale_r),bfs_rho);
+          increment_lda<double>(Hs,vt/arma::square(scale_theta),bfs_theta);
+          increment_lda<double>(Hs,vt/arma::square(scale_phi),bfs_phi);
         }
         if(do_mgga_l)
           throw std::logic_error("Laplacian not implemented!\n");
 
-        Ho(bf_ind,bf_ind)+=H;
+        H(sin_ind,sin_ind)+=Hs;
+        Ho+=H;
       }
 
       void DFTGridWorker::eval_Fxc(arma::mat & Hao, arma::mat & Hbo, bool beta) const {
@@ -587,10 +623,14 @@ namespace helfem {
           throw std::runtime_error("Refusing to compute unrestricted Fock matrix with restricted density.\n");
         }
 
-        arma::mat Ha, Hb;
+        // Work matrices for the cos and sin parts
+        arma::mat Ha, Hb, Has, Hbs;
         Ha.zeros(bf_ind.n_elem,bf_ind.n_elem);
-        if(beta)
+        Has.zeros(sin_ind.n_elem,sin_ind.n_elem);
+        if(beta) {
           Hb.zeros(bf_ind.n_elem,bf_ind.n_elem);
+          Hbs.zeros(sin_ind.n_elem,sin_ind.n_elem);
+        }
 
         {
           // LDA potential
@@ -598,12 +638,14 @@ namespace helfem {
           // Multiply weights into potential
           vrhoa%=wtot;
           // Increment matrix
-          increment_lda< std::complex<double> >(Ha,vrhoa,bf);
+          increment_lda<double>(Ha,vrhoa,bf);
+          increment_lda<double>(Has,vrhoa,bfs);
 
           if(beta) {
             arma::rowvec vrhob(vxc.row(1));
             vrhob%=wtot;
-            increment_lda< std::complex<double> >(Hb,vrhob,bf);
+            increment_lda<double>(Hb,vrhob,bf);
+            increment_lda<double>(Hbs,vrhob,bfs);
           }
         }
         if(Ha.has_nan() || (beta && Hb.has_nan()))
@@ -629,7 +671,8 @@ namespace helfem {
             gr_a(i,2)=wtot(i)*(2.0*vs_aa(i)*gr_a0(i,2) + vs_ab(i)*gr_b0(i,2))/scale_phi(i);
           }
           // Increment matrix
-          increment_gga< std::complex<double> >(Ha,gr_a,bf,bf_rho,bf_theta,bf_phi);
+          increment_gga<double>(Ha,gr_a,bf,bf_rho,bf_theta,bf_phi);
+          increment_gga<double>(Has,gr_a,bfs,bfs_rho,bfs_theta,bfs_phi);
 
           if(beta) {
             arma::rowvec vs_bb(vsigma.row(2));
@@ -639,7 +682,8 @@ namespace helfem {
               gr_b(i,1)=wtot(i)*(2.0*vs_bb(i)*gr_b0(i,1) + vs_ab(i)*gr_a0(i,1))/scale_theta(i);
               gr_b(i,2)=wtot(i)*(2.0*vs_bb(i)*gr_b0(i,2) + vs_ab(i)*gr_a0(i,2))/scale_phi(i);
             }
-            increment_gga< std::complex<double> >(Hb,gr_b,bf,bf_rho,bf_theta,bf_phi);
+            increment_gga<double>(Hb,gr_b,bf,bf_rho,bf_theta,bf_phi);
+            increment_gga<double>(Hbs,gr_b,bfs,bfs_rho,bfs_theta,bfs_phi);
           }
         }
 
@@ -648,25 +692,34 @@ namespace helfem {
           arma::rowvec vt_a(vtau.row(0));
           vt_a%=0.5*wtot;
 
-          increment_lda< std::complex<double> >(Ha,vt_a/arma::square(scale_r),bf_rho);
-          increment_lda< std::complex<double> >(Ha,vt_a/arma::square(scale_theta),bf_theta);
-          increment_lda< std::complex<double> >(Ha,vt_a/arma::square(scale_phi),bf_phi);
+          increment_lda<double>(Ha,vt_a/arma::square(scale_r),bf_rho);
+          increment_lda<double>(Ha,vt_a/arma::square(scale_theta),bf_theta);
+          increment_lda<double>(Ha,vt_a/arma::square(scale_phi),bf_phi);
+          increment_lda<double>(Has,vt_a/arma::square(scale_r),bfs_rho);
+          increment_lda<double>(Has,vt_a/arma::square(scale_theta),bfs_theta);
+          increment_lda<double>(Has,vt_a/arma::square(scale_phi),bfs_phi);
           if(beta) {
             arma::rowvec vt_b(vtau.row(1));
             vt_b%=0.5*wtot;
 
-            increment_lda< std::complex<double> >(Hb,vt_b/arma::square(scale_r),bf_rho);
-            increment_lda< std::complex<double> >(Hb,vt_b/arma::square(scale_theta),bf_theta);
-            increment_lda< std::complex<double> >(Hb,vt_b/arma::square(scale_phi),bf_phi);
+            increment_lda<double>(Hb,vt_b/arma::square(scale_r),bf_rho);
+            increment_lda<double>(Hb,vt_b/arma::square(scale_theta),bf_theta);
+            increment_lda<double>(Hb,vt_b/arma::square(scale_phi),bf_phi);
+            increment_lda<double>(Hbs,vt_b/arma::square(scale_r),bfs_rho);
+            increment_lda<double>(Hbs,vt_b/arma::square(scale_theta),bfs_theta);
+            increment_lda<double>(Hbs,vt_b/arma::square(scale_phi),bfs_phi);
           }
         }
         if(do_mgga_l) {
           throw std::logic_error("Laplacian not implemented!\n");
         }
 
-        Hao(bf_ind,bf_ind)+=Ha;
-        if(beta)
-          Hbo(bf_ind,bf_ind)+=Hb;
+        Ha(sin_ind,sin_ind)+=Has;
+        Hao+=Ha;
+        if(beta) {
+          Hb(sin_ind,sin_ind)+=Hbs;
+          Hbo+=Hb;
+        }
       }
 
       void DFTGridWorker::check_grad_tau_lapl(int x_func, int c_func) {
@@ -704,15 +757,16 @@ namespace helfem {
         do_lapl=lap_;
       }
 
-      void DFTGridWorker::compute_bf(size_t iel, size_t irad) {
+      void DFTGridWorker::compute_bf(size_t iel, size_t irad, size_t nrad) {
         // Update function list
         bf_ind=basp->bf_list(iel);
+        // The functions with m != 0 also have a sin(m phi) part
+        sin_ind=basp->sin_list(iel);
 
-        // Get radial weights. Only do one radial quadrature point at a
-        // time, since this is an easy way to save a lot of memory.
-        arma::vec wrad(1), r(1);
-        wrad(0)=basp->get_wrad(iel)(irad);
-        r(0)=basp->get_r(iel)(irad);
+        // Get radial weights. Only do a few radial quadrature points at
+        // a time, since this is an easy way to save a lot of memory.
+        arma::vec wrad(basp->get_wrad(iel).subvec(irad,irad+nrad-1));
+        arma::vec r(basp->get_r(iel).subvec(irad,irad+nrad-1));
 
         double Rhalf(basp->get_Rhalf());
 
@@ -747,43 +801,52 @@ namespace helfem {
 
         // Compute basis function values
         bf.zeros(bf_ind.n_elem,wtot.n_elem);
+        bfs.zeros(sin_ind.n_elem,wtot.n_elem);
         // Loop over angular grid
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
         for(size_t ia=0;ia<cth.n_elem;ia++) {
           // Evaluate basis functions at angular point
-          arma::cx_mat abf(basp->eval_bf(iel, irad, cth(ia), phi(ia)));
-          if(abf.n_cols != bf_ind.n_elem) {
+          arma::mat cf, sf;
+          basp->eval_bf(iel, irad, nrad, cth(ia), phi(ia), cf, sf);
+          if(cf.n_cols != bf_ind.n_elem || sf.n_cols != sin_ind.n_elem) {
             std::ostringstream oss;
-            oss << "Mismatch! Have " << bf_ind.n_elem << " basis function indices but " << abf.n_cols << " basis functions!\n";
+            oss << "Mismatch! Have " << bf_ind.n_elem << " and " << sin_ind.n_elem << " basis function indices but " << cf.n_cols << " and " << sf.n_cols << " basis functions!\n";
             throw std::logic_error(oss.str());
           }
           // Store functions
-          bf.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(abf);
+          bf.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(cf);
+          bfs.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(sf);
         }
 
         if(do_grad) {
           bf_rho.zeros(bf_ind.n_elem,wtot.n_elem);
           bf_theta.zeros(bf_ind.n_elem,wtot.n_elem);
           bf_phi.zeros(bf_ind.n_elem,wtot.n_elem);
+          bfs_rho.zeros(sin_ind.n_elem,wtot.n_elem);
+          bfs_theta.zeros(sin_ind.n_elem,wtot.n_elem);
+          bfs_phi.zeros(sin_ind.n_elem,wtot.n_elem);
 
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for if(!omp_in_parallel())
 #endif
           for(size_t ia=0;ia<cth.n_elem;ia++) {
             // Evaluate basis functions at angular point
-            arma::cx_mat dr, dth, dphi;
-            basp->eval_df(iel, irad, cth(ia), phi(ia), dr, dth, dphi);
-            if(dr.n_cols != bf_ind.n_elem) {
+            arma::mat cdr, cdth, cdphi, sdr, sdth, sdphi;
+            basp->eval_df(iel, irad, nrad, cth(ia), phi(ia), cdr, cdth, cdphi, sdr, sdth, sdphi);
+            if(cdr.n_cols != bf_ind.n_elem || sdr.n_cols != sin_ind.n_elem) {
               std::ostringstream oss;
-              oss << "Mismatch! Have " << bf_ind.n_elem << " basis function indices but " << dr.n_cols << " basis functions!\n";
+              oss << "Mismatch! Have " << bf_ind.n_elem << " and " << sin_ind.n_elem << " basis function indices but " << cdr.n_cols << " and " << sdr.n_cols << " basis functions!\n";
               throw std::logic_error(oss.str());
             }
             // Store functions
-            bf_rho.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(dr);
-            bf_theta.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(dth);
-            bf_phi.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(dphi);
+            bf_rho.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(cdr);
+            bf_theta.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(cdth);
+            bf_phi.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(cdphi);
+            bfs_rho.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(sdr);
+            bfs_theta.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(sdth);
+            bfs_phi.cols(ia*wrad.n_elem,(ia+1)*wrad.n_elem-1)=arma::trans(sdphi);
           }
         }
 
@@ -792,53 +855,112 @@ namespace helfem {
         }
       }
 
+      /// Adds the Fock matrix Hel of the element with functions idx to H; adjacent elements share functions, so this is done one thread at a time
+      static void add_element_block(arma::mat & H, const arma::uvec & idx, const arma::mat & Hel) {
+        if(!Hel.n_elem)
+          return;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        H(idx,idx)+=Hel;
+      }
+
       DFTGrid::DFTGrid() {
       }
 
       DFTGrid::DFTGrid(const helfem::diatomic::basis::TwoDBasis * basp_, int lang_, int mang_) : basp(basp_), lang(lang_), mang(mang_) {
         arma::vec cth, phi, wang;
         helfem::angular::angular_chebyshev(lang,mang,cth,phi,wang);
+        Nang=wang.n_elem;
         printf("DFT angular grid of order l=%i m=%i has %i points\n",lang,mang,(int) wang.n_elem);
       }
 
       DFTGrid::~DFTGrid() {
       }
 
+      std::vector<radial_batch_t> DFTGrid::radial_batches() const {
+        // Radial points in a batch share the basis functions, so
+        // several points are combined to give libxc and BLAS larger
+        // blocks, as long as the basis function values of a batch
+        // stay below this many entries
+        const size_t maxentries=1<<20;
+
+        std::vector<radial_batch_t> batches;
+        for(size_t iel=0;iel<basp->get_rad_Nel();iel++) {
+          size_t Nrad(basp->get_r(iel).n_elem);
+          size_t Nbf(basp->bf_list(iel).n_elem);
+          size_t nrad(std::max((size_t) 1, std::min(Nrad, maxentries/std::max((size_t) 1, Nbf*Nang))));
+
+          radial_batch_t batch;
+          batch.iel=iel;
+          for(size_t irad=0;irad<Nrad;irad+=nrad) {
+            batch.irad=irad;
+            batch.nrad=std::min(nrad,Nrad-irad);
+            batches.push_back(batch);
+          }
+        }
+
+        return batches;
+      }
+
       void DFTGrid::eval_Fxc(int x_func, const arma::vec & x_pars, int c_func, const arma::vec & c_pars, const arma::mat & P, arma::mat & H, double & Exc, double & Nel, double & Ekin, double thr) {
         H.zeros(basp->Ndummy(),basp->Ndummy());
 
+        // The batches are distributed over the threads
+        std::vector<radial_batch_t> batches(radial_batches());
+
         double exc=0.0;
         double ekin=0.0;
         double nel=0.0;
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:exc,ekin,nel)
+#endif
         {
           DFTGridWorker grid(basp,lang,mang);
           grid.check_grad_tau_lapl(x_func,c_func);
 
-          for(size_t iel=0;iel<basp->get_rad_Nel();iel++) {
-            for(size_t irad=0;irad<basp->get_r(iel).n_elem;irad++) {
-              grid.compute_bf(iel,irad);
-              grid.update_density(P);
-              nel+=grid.compute_Nel();
-              ekin+=grid.compute_Ekin();
+          // Every thread accumulates the Fock matrix of the element
+          // it is working on, which is added to H when the thread
+          // moves on to another element
+          size_t iel=0;
+          arma::uvec idx;
+          arma::mat Hel;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+          for(size_t ib=0;ib<batches.size();ib++) {
+            if(!Hel.n_elem || batches[ib].iel != iel) {
+              add_element_block(H,idx,Hel);
+              iel=batches[ib].iel;
+              idx=basp->bf_list(iel);
+              Hel.zeros(idx.n_elem,idx.n_elem);
+            }
+
+            grid.compute_bf(batches[ib].iel,batches[ib].irad,batches[ib].nrad);
+            grid.update_density(P);
+            nel+=grid.compute_Nel();
+            ekin+=grid.compute_Ekin();
 
-              grid.init_xc();
-              if(thr>0.0)
-                grid.screen_density(thr);
-              if(x_func>0)
-                grid.compute_xc(x_func, x_pars);
-              if(c_func>0)
-                grid.compute_xc(c_func, c_pars);
+            grid.init_xc();
+            if(thr>0.0)
+              grid.screen_density(thr);
+            if(x_func>0)
+              grid.compute_xc(x_func, x_pars);
+            if(c_func>0)
+              grid.compute_xc(c_func, c_pars);
 
-              exc+=grid.eval_Exc();
-              grid.eval_Fxc(H);
+            exc+=grid.eval_Exc();
+            grid.eval_Fxc(Hel);
 
 #if 0
-              std::ostringstream oss;
-              oss << "_" << iel << "_" << irad;
-              grid.save(oss.str());
+            std::ostringstream oss;
+            oss << "_" << batches[ib].iel << "_" << batches[ib].irad;
+            grid.save(oss.str());
 #endif
-            }
           }
+
+          add_element_block(H,idx,Hel);
         }
 
         // Save outputs
@@ -853,38 +975,65 @@ namespace helfem {
         Ha.zeros(basp->Ndummy(),basp->Ndummy());
         Hb.zeros(basp->Ndummy(),basp->Ndummy());
 
+        // The batches are distributed over the threads
+        std::vector<radial_batch_t> batches(radial_batches());
+
         double exc=0.0;
         double nel=0.0;
         double ekin=0.0;
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:exc,nel,ekin)
+#endif
         {
           DFTGridWorker grid(basp,lang,mang);
           grid.check_grad_tau_lapl(x_func,c_func);
 
-          for(size_t iel=0;iel<basp->get_rad_Nel();iel++) {
-            for(size_t irad=0;irad<basp->get_r(iel).n_elem;irad++) {
-              grid.compute_bf(iel,irad);
-              grid.update_density(Pa,Pb);
-              nel+=grid.compute_Nel();
-              ekin+=grid.compute_Ekin();
+          // Every thread accumulates the Fock matrices of the
+          // element it is working on, which are added to Ha and Hb
+          // when the thread moves on to another element
+          size_t iel=0;
+          arma::uvec idx;
+          arma::mat Hael, Hbel;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,1)
+#endif
+          for(size_t ib=0;ib<batches.size();ib++) {
+            if(!Hael.n_elem || batches[ib].iel != iel) {
+              add_element_block(Ha,idx,Hael);
+              add_element_block(Hb,idx,Hbel);
+              iel=batches[ib].iel;
+              idx=basp->bf_list(iel);
+              Hael.zeros(idx.n_elem,idx.n_elem);
+              if(beta)
+                Hbel.zeros(idx.n_elem,idx.n_elem);
+            }
 
-              grid.init_xc();
-              if(thr>0.0)
-                grid.screen_density(thr);
-              if(x_func>0)
-                grid.compute_xc(x_func, x_pars);
-              if(c_func>0)
-                grid.compute_xc(c_func, c_pars);
+            grid.compute_bf(batches[ib].iel,batches[ib].irad,batches[ib].nrad);
+            grid.update_density(Pa,Pb);
+            nel+=grid.compute_Nel();
+            ekin+=grid.compute_Ekin();
 
-              exc+=grid.eval_Exc();
-              grid.eval_Fxc(Ha,Hb,beta);
+            grid.init_xc();
+            if(thr>0.0)
+              grid.screen_density(thr);
+            if(x_func>0)
+              grid.compute_xc(x_func, x_pars);
+            if(c_func>0)
+              grid.compute_xc(c_func, c_pars);
+
+            exc+=grid.eval_Exc();
+            grid.eval_Fxc(Hael,Hbel,beta);
 
 #if 0
-              std::ostringstream oss;
-              oss << "_" << iel << "_" << irad;
-              grid.save(oss.str());
+            std::ostringstream oss;
+            oss << "_" << batches[ib].iel << "_" << batches[ib].irad;
+            grid.save(oss.str());
 #endif
-            }
           }
+
+          add_element_block(Ha,idx,Hael);
+          add_element_block(Hb,idx,Hbel);
         }
 
         // Save outputs
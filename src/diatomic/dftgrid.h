@@ -23,7 +23,16 @@ namespace helfem {
   namespace diatomic {
     namespace dftgrid {
 
-      /// Worker class
+      /**
+       * Worker class. The basis functions are split into their real
+       * cos(m phi) and sin(m phi) parts as chi_u = c_u + i s_u. Since
+       * the density matrix is real and symmetric, the density is
+       * rho = sum_uv P_uv Re(chi_u chi_v^*) = sum_uv P_uv (c_u c_v + s_u s_v),
+       * and the Fock matrix elements are likewise sums of cos-cos
+       * and sin-sin integrals, so everything is done in real
+       * arithmetic. The sin parts vanish for m=0, and are only
+       * stored for the functions with m != 0.
+       */
       class DFTGridWorker {
       protected:
         /// Basis set
@@ -39,22 +48,36 @@ namespace helfem {
 
         /// List of basis functions in element
         arma::uvec bf_ind;
-        /// Values of important functions in grid points, Nbf * Ngrid
-        arma::cx_mat bf;
+        /// Indices of the functions with m != 0 in the above list
+        arma::uvec sin_ind;
+        /// Values of the cos parts of important functions in grid points, Nbf * Ngrid
+        arma::mat bf;
         /// Radial gradient
-        arma::cx_mat bf_rho;
+        arma::mat bf_rho;
         /// Theta gradient
-        arma::cx_mat bf_theta;
+        arma::mat bf_theta;
         /// Phi gradient
-        arma::cx_mat bf_phi;
+        arma::mat bf_phi;
+        /// Values of the sin parts of the functions with m != 0 in grid points, Nsin * Ngrid
+        arma::mat bfs;
+        /// Radial gradient
+        arma::mat bfs_rho;
+        /// Theta gradient
+        arma::mat bfs_theta;
+        /// Phi gradient
+        arma::mat bfs_phi;
         /// Values of laplacians in grid points, (3*Nbf) * Ngrid
-        arma::cx_mat bf_lapl;
+        arma::mat bf_lapl;
 
-        /// Density helper matrices: P_{uv} chi_v, and P_{uv} nabla(chi_v)
-        arma::cx_mat Pv, Pv_rho, Pv_theta, Pv_phi;
+        /// Density helper matrices: P_{uv} c_v, and P_{uv} nabla(c_v)
+        arma::mat Pv, Pv_rho, Pv_theta, Pv_phi;
+        /// Same for the sin parts
+        arma::mat Psv, Psv_rho, Psv_theta, Psv_phi;
         /// Same for spin-polarized
-        arma::cx_mat Pav, Pav_rho, Pav_theta, Pav_phi;
-        arma::cx_mat Pbv, Pbv_rho, Pbv_theta, Pbv_phi;
+        arma::mat Pav, Pav_rho, Pav_theta, Pav_phi;
+        arma::mat Pbv, Pbv_rho, Pbv_theta, Pbv_phi;
+        arma::mat Pasv, Pasv_rho, Pasv_theta, Pasv_phi;
+        arma::mat Pbsv, Pbsv_rho, Pbsv_theta, Pbsv_phi;
 
         /// Is gradient needed?
         bool do_grad;
@@ -118,8 +141,8 @@ namespace helfem {
         /// Set necessity of computing gradient and laplacians, necessary for compute_bf!
         void set_grad_tau_lapl(bool grad, bool tau, bool lapl);
 
-        /// Compute basis functions on grid points
-        void compute_bf(size_t iel, size_t irad);
+        /// Compute basis functions on the grid points of radial points irad, ..., irad+nrad-1 in element iel
+        void compute_bf(size_t iel, size_t irad, size_t nrad=1);
         /// Free memory
         void free();
         /// Save data
@@ -154,12 +177,22 @@ namespace helfem {
         /// Evaluate kinetic energy matrix
         void eval_kinetic(arma::mat & T) const;
 
-        /// Evaluate Fock matrix, restricted calculation
+        /// Evaluate Fock matrix, restricted calculation; the contribution is added to the bf_ind x bf_ind block of the current element
         void eval_Fxc(arma::mat & H) const;
-        /// Evaluate Fock matrix, unrestricted calculation
+        /// Evaluate Fock matrix, unrestricted calculation; the contributions are added to the bf_ind x bf_ind blocks of the current element
         void eval_Fxc(arma::mat & Ha, arma::mat & Hb, bool beta=true) const;
       };
 
+      /// Batch of consecutive radial points in an element
+      typedef struct {
+        /// Element
+        size_t iel;
+        /// First radial point
+        size_t irad;
+        /// Number of radial points
+        size_t nrad;
+      } radial_batch_t;
+
       /// Wrapper routine
       class DFTGrid {
       private:
@@ -167,6 +200,11 @@ namespace helfem {
         const helfem::diatomic::basis::TwoDBasis * basp;
         /// Angular rule
         int lang, mang;
+        /// Number of angular points
+        size_t Nang;
+
+        /// Divide the radial points into batches that are processed by one worker at a time
+        std::vector<radial_batch_t> radial_batches() const;
 
       public:
         /// Dummy constructor
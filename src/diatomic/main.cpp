@@ -116,6 +116,8 @@ int main(int argc, char **argv) {
   parser.add<int>("ldft", 0, "theta rule for dft quadrature (0 for auto)", false, 0);
   parser.add<int>("mdft", 0, "phi rule for dft quadrature (0 for auto)", false, 0);
   parser.add<double>("dftthr", 0, "density threshold for dft", false, 1e-12);
+  parser.add<int>("incfock", 0, "build J and K from density differences, with a full rebuild every n iterations (0 for full builds only)", false, 0);
+  parser.add<int>("singletei", 0, "store primitive two-electron integrals in single precision", false, 0);
   parser.add<int>("restricted", 0, "spin-restricted orbitals", false, -1);
   parser.add<int>("symmetry", 0, "force orbital symmetry", false, 1);
   parser.add<int>("primbas", 0, "primitive radial basis", false, 4);
@@ -164,6 +166,8 @@ int main(int argc, char **argv) {
   int ldft(parser.get<int>("ldft"));
   int mdft(parser.get<int>("mdft"));
   double dftthr(parser.get<double>("dftthr"));
+  int incfock(parser.get<int>("incfock"));
+  int singletei(parser.get<int>("singletei"));
 
   // Nuclear charge
   int Z1(get_Z(parser.get<std::string>("Z1")));
@@ -275,6 +279,7 @@ int main(int argc, char **argv) {
   arma::vec bval(atomic::basis::normal_grid(Nelem, mumax, igrid, zexp));
 
   diatomic::basis::TwoDBasis basis(Z1, Z2, Rbond, poly, Nquad, bval, lval, mval, lpad);
+  basis.set_single_precision_tei(singletei);
   chkpt.write(basis);
   printf("Basis set consists of %i angular shells composed of %i radial functions, totaling %i basis functions\n",(int) basis.Nang(), (int) basis.Nrad(), (int) basis.Nbf());
 
@@ -762,6 +767,8 @@ int main(int argc, char **argv) {
 
   // Density matrices
   arma::mat P, Pa, Pb;
+  // Density and Coulomb and exchange matrices of the previous iteration for incremental builds
+  arma::mat Pold, Paold, Pbold, Jold, Kaold, Kbold;
 
   for(int i=1;i<=maxit;i++) {
     printf("\n**** Iteration %i ****\n\n",i);
@@ -787,9 +794,25 @@ int main(int argc, char **argv) {
     Eefield=arma::trace(P*Vel);
     Emfield=arma::trace(P*Vmag)-Bz/2.0*(nela-nelb);
 
+    // Full build, or incremental build from the density difference?
+    bool fullfock=(incfock<=0 || (i-1)%incfock==0);
+    arma::mat dP, dPa, dPb;
+    if(fullfock) {
+      dP=P;
+      dPa=Pa;
+      dPb=Pb;
+    } else {
+      printf("Incremental Fock build\n");
+      dP=P-Pold;
+      dPa=Pa-Paold;
+      dPb=Pb-Pbold;
+    }
+
     // Form Coulomb matrix
     timer.set();
-    arma::mat J(basis.coulomb(P));
+    arma::mat J(basis.coulomb(dP));
+    if(!fullfock)
+      J+=Jold;
     double tJ(timer.get());
     Ecoul=0.5*arma::trace(P*J);
     printf("Coulomb energy %.10e % .6f\n",Ecoul,tJ);
@@ -800,13 +823,18 @@ int main(int argc, char **argv) {
     timer.set();
     arma::mat Ka, Kb;
     if(kfrac!=0.0) {
-      Ka=kfrac*basis.exchange(Pa);
+      Ka=kfrac*basis.exchange(dPa);
+      if(!fullfock)
+        Ka+=Kaold;
 
       if(nelb) {
         if(restr && nela==nelb)
           Kb=Ka;
-        else
-          Kb=kfrac*basis.exchange(Pb);
+        else {
+          Kb=kfrac*basis.exchange(dPb);
+          if(!fullfock)
+            Kb+=Kbold;
+        }
       } else
         Kb.zeros(Cbocc.n_rows,Cbocc.n_rows);
       double tK(timer.get());
@@ -822,6 +850,14 @@ int main(int argc, char **argv) {
     chkpt.write("Ka",Ka);
     chkpt.write("Kb",Kb);
 
+    // Store for incremental builds
+    Pold=P;
+    Paold=Pa;
+    Pbold=Pb;
+    Jold=J;
+    Kaold=Ka;
+    Kbold=Kb;
+
     // Exchange-correlation
     Exc=0.0;
     arma::mat XCa, XCb;
@@ -20,6 +20,22 @@
 namespace helfem {
   namespace diatomic {
     namespace quadrature {
+      /// Check that the Legendre function table has been computed at the given points
+      static void check_table(const legendretable::LegendreTable & tab, size_t ioff, const arma::vec & chmu) {
+#ifndef ARMA_NO_DEBUG
+        arma::vec tabxi(tab.get_xi(ioff,chmu.n_elem));
+        if(arma::max(arma::abs(tabxi-chmu)) > 1e-12*arma::max(chmu)) {
+          std::ostringstream oss;
+          oss << "Legendre function table mismatch at points " << ioff << " to " << ioff+chmu.n_elem << "!\n";
+          throw std::logic_error(oss.str());
+        }
+#else
+        (void) tab;
+        (void) ioff;
+        (void) chmu;
+#endif
+      }
+
       arma::mat radial_integral(double mumin, double mumax, int m, int n, const arma::vec & x, const arma::vec & wx, const arma::mat & bf) {
 #ifndef ARMA_NO_DEBUG
         if(x.n_elem != wx.n_elem) {
@@ -57,7 +73,7 @@ namespace helfem {
         return arma::trans(wbf)*bf;
       }
 
-      arma::mat Plm_radial_integral(double mumin, double mumax, int k, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab) {
+      arma::mat Plm_radial_integral(double mumin, double mumax, int k, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab, size_t ioff) {
 #ifndef ARMA_NO_DEBUG
         if(x.n_elem != wx.n_elem) {
           std::ostringstream oss;
@@ -84,7 +100,8 @@ namespace helfem {
         wp%=arma::sinh(mu);
         if(k!=0)
           wp%=arma::pow(chmu,k);
-        wp%=tab.get_Plm(L,M,chmu);
+        check_table(tab,ioff,chmu);
+        wp%=tab.get_Plm(L,M,ioff,chmu.n_elem);
 
         // Put in weight
         arma::mat wbf(bf);
@@ -95,7 +112,7 @@ namespace helfem {
         return arma::trans(wbf)*bf;
       }
 
-      arma::mat Qlm_radial_integral(double mumin, double mumax, int l, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab) {
+      arma::mat Qlm_radial_integral(double mumin, double mumax, int l, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab, size_t ioff) {
 #ifndef ARMA_NO_DEBUG
         if(x.n_elem != wx.n_elem) {
           std::ostringstream oss;
@@ -122,8 +139,9 @@ namespace helfem {
         if(l!=0)
           // cosh term
           wp%=arma::pow(chmu,l);
+        check_table(tab,ioff,chmu);
         // Legendre polynomial
-        wp%=tab.get_Qlm(L,M,chmu);
+        wp%=tab.get_Qlm(L,M,ioff,chmu.n_elem);
 
         // Put in weight
         arma::mat wbf(bf);
@@ -134,7 +152,7 @@ namespace helfem {
         return arma::trans(wbf)*bf;
       }
 
-      static arma::vec twoe_inner_integral_wrk(double mumin, double mumax, double mumin0, double mumax0, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab) {
+      static arma::vec twoe_inner_integral_wrk(double mumin, double mumax, double mumin0, double mumax0, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab, size_t ioff) {
         // Midpoint is at
         double mumid(0.5*(mumax+mumin));
         // and half-length of interval is
@@ -154,8 +172,9 @@ namespace helfem {
         if(l!=0)
           // cosh term
           wp%=arma::pow(chmu,l);
+        check_table(tab,ioff,chmu);
         // Legendre polynomial
-        wp%=tab.get_Plm(L,M,chmu);
+        wp%=tab.get_Plm(L,M,ioff,chmu.n_elem);
 
         // Calculate x values the polynomials should be evaluated at
         arma::vec xpoly((mu-mumid0*arma::ones<arma::vec>(x.n_elem))/mulen0);
@@ -173,7 +192,7 @@ namespace helfem {
         return inner;
       }
 
-      arma::mat twoe_inner_integral(double mumin, double mumax, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab) {
+      arma::mat twoe_inner_integral(double mumin, double mumax, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab, size_t ioff) {
         // Midpoint is at
         double mumid(0.5*(mumax+mumin));
         // and half-length of interval is
@@ -183,15 +202,15 @@ namespace helfem {
 
         // Compute the "inner" integrals as function of r.
         arma::mat inner(x.n_elem,std::pow(poly->get_nbf(),2));
-        inner.row(0)=arma::trans(twoe_inner_integral_wrk(mumin, mu(0), mumin, mumax, l, x, wx, poly, L, M, tab));
+        inner.row(0)=arma::trans(twoe_inner_integral_wrk(mumin, mu(0), mumin, mumax, l, x, wx, poly, L, M, tab, ioff));
         // Every subinterval uses a fresh nquad points!
         for(size_t ip=1;ip<x.n_elem;ip++)
-          inner.row(ip)=inner.row(ip-1)+arma::trans(twoe_inner_integral_wrk(mu(ip-1), mu(ip), mumin, mumax, l, x, wx, poly, L, M, tab));
+          inner.row(ip)=inner.row(ip-1)+arma::trans(twoe_inner_integral_wrk(mu(ip-1), mu(ip), mumin, mumax, l, x, wx, poly, L, M, tab, ioff+ip*x.n_elem));
 
         return inner;
       }
 
-      static arma::mat twoe_integral_wrk(double mumin, double mumax, int k, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab) {
+      static arma::mat twoe_integral_wrk(double mumin, double mumax, int k, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab, size_t ioff) {
 #ifndef ARMA_NO_DEBUG
         if(x.n_elem != wx.n_elem) {
           std::ostringstream oss;
@@ -208,7 +227,8 @@ namespace helfem {
         arma::vec chmu(arma::cosh(mu));
 
         // Compute the inner integrals
-        arma::mat inner(twoe_inner_integral(mumin, mumax, l, x, wx, poly, L, M, tab));
+        // The sub-interval points follow the element points in the table
+        arma::mat inner(twoe_inner_integral(mumin, mumax, l, x, wx, poly, L, M, tab, ioff+x.n_elem));
 
         // Evaluate basis functions at quadrature points
         arma::mat bf(poly->eval(x));
@@ -223,7 +243,8 @@ namespace helfem {
         wp%=arma::sinh(mu);
         if(k!=0)
           wp%=arma::pow(chmu,k);
-        wp%=tab.get_Qlm(L,M,chmu);
+        check_table(tab,ioff,chmu);
+        wp%=tab.get_Qlm(L,M,ioff,chmu.n_elem);
 
         for(size_t i=0;i<bfprod.n_cols;i++)
           bfprod.col(i)%=wp;
@@ -234,8 +255,8 @@ namespace helfem {
         return ints;
       }
 
-      arma::mat twoe_integral(double mumin, double mumax, int k, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab) {
-        return twoe_integral_wrk(mumin,mumax,k,l,x,wx,poly,L,M,tab) + arma::trans(twoe_integral_wrk(mumin,mumax,l,k,x,wx,poly,L,M,tab));
+      arma::mat twoe_integral(double mumin, double mumax, int k, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab, size_t ioff) {
+        return twoe_integral_wrk(mumin,mumax,k,l,x,wx,poly,L,M,tab,ioff) + arma::trans(twoe_integral_wrk(mumin,mumax,l,k,x,wx,poly,L,M,tab,ioff));
       }
     }
   }
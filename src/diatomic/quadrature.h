@@ -44,8 +44,10 @@ namespace helfem {
        *       x: integration nodes
        *      wx: integration weights
        *      bf: basis functions evaluated at integration nodes.
+       *     tab: table of Legendre functions
+       *    ioff: index of the first integration node in the table
        */
-      arma::mat Plm_radial_integral(double mumin, double mumax, int m, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab);
+      arma::mat Plm_radial_integral(double mumin, double mumax, int m, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab, size_t ioff);
 
       /**
        * Computes a radial integral of the type \f$ \int_0^\infty B_1 (\mu) B_2(\mu) \cosh^m (\mu) Q_L^M (\mu) d\mu \f$.
@@ -56,21 +58,26 @@ namespace helfem {
        *       x: integration nodes
        *      wx: integration weights
        *      bf: basis functions evaluated at integration nodes.
+       *     tab: table of Legendre functions
+       *    ioff: index of the first integration node in the table
        */
-      arma::mat Qlm_radial_integral(double mumin, double mumax, int m, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab);
+      arma::mat Qlm_radial_integral(double mumin, double mumax, int m, const arma::vec & x, const arma::vec & wx, const arma::mat & bf, int L, int M, const legendretable::LegendreTable & tab, size_t ioff);
 
       /**
        * Computes the inner in-element two-electron integral:
        * \f$ \phi^{l,LM}(\mu) = \int_{0}^{\mu}d\mu'\cosh^{l}\mu'\sinh\mu'B_{\gamma}(\mu')B_{\delta}(\mu')P_{L,|M|}(\cosh\mu') \f$
+       * The nodes of the ip:th sub-interval are at ioff+ip*x.n_elem in the Legendre function table.
        */
-      arma::mat twoe_inner_integral(double mumin, double mumax, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab);
+      arma::mat twoe_inner_integral(double mumin, double mumax, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab, size_t ioff);
 
       /**
        * Computes a primitive two-electron in-element integral.
        * Cross-element integrals reduce to products of radial integrals.
        * Note that the routine needs the polynomial representation.
+       * The element nodes are at ioff in the Legendre function table,
+       * followed by the sub-interval nodes of twoe_inner_integral.
        */
-      arma::mat twoe_integral(double rmin, double rmax, int k, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab);
+      arma::mat twoe_integral(double rmin, double rmax, int k, int l, const arma::vec & x, const arma::vec & wx, const polynomial_basis::PolynomialBasis * poly, int L, int M, const legendretable::LegendreTable & tab, size_t ioff);
     }
   }
 }
@@ -0,0 +1,164 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "assoc_legendre.h"
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace helfem {
+  namespace assoc_legendre {
+    /// Maximum number of terms in the continued fraction; it is only used away from xi=1, where it converges in O(ltop) terms
+    static const size_t cf_maxiter=1000000;
+    /// Upward recursion is used for m=0,1 when mu*ltop is below this value, where mu = acosh(xi)
+    static const double upward_mul=2.0;
+
+    size_t lm_index(int l, int m, int lmax) {
+      return l+(lmax+1)*m;
+    }
+
+    /// Check that the points are in the range of validity
+    static void check_xi(const arma::vec & xi, bool strict) {
+      for(size_t i=0;i<xi.n_elem;i++)
+        if(xi(i)<1.0 || (strict && xi(i)==1.0)) {
+          std::ostringstream oss;
+          oss << "Legendre functions requested at xi = " << xi(i) << " outside the supported range xi " << (strict ? ">" : ">=") << " 1!\n";
+          throw std::logic_error(oss.str());
+        }
+    }
+
+    arma::mat Plm(int lmax, int mmax, const arma::vec & xi) {
+      check_xi(xi,false);
+
+      arma::mat P(xi.n_elem,(lmax+1)*(mmax+1),arma::fill::zeros);
+      // sqrt(xi^2-1), written in a form that is accurate close to xi=1
+      arma::vec s(arma::sqrt((xi-1.0)%(xi+1.0)));
+
+      // P_m^m = (2m-1)!! (xi^2-1)^(m/2); P_l^m vanishes for l<m
+      arma::vec Pmm(arma::ones<arma::vec>(xi.n_elem));
+      for(int m=0;m<=std::min(lmax,mmax);m++) {
+        if(m>0)
+          Pmm%=(2*m-1)*s;
+        P.col(lm_index(m,m,lmax))=Pmm;
+        if(m<lmax)
+          P.col(lm_index(m+1,m,lmax))=(2*m+1)*(xi%Pmm);
+        // (l-m) P_l^m = (2l-1) xi P_{l-1}^m - (l+m-1) P_{l-2}^m
+        for(int l=m+2;l<=lmax;l++)
+          P.col(lm_index(l,m,lmax))=((2*l-1)*(xi%P.col(lm_index(l-1,m,lmax))) - (l+m-1)*P.col(lm_index(l-2,m,lmax)))/(l-m);
+      }
+
+      return P;
+    }
+
+    double Qlm_ratio(int nu, int m, double xi) {
+      /*
+        Dividing the recursion
+        (l-m+1) Q_{l+1}^m = (2l+1) xi Q_l^m - (l+m) Q_{l-1}^m
+        by Q_l^m gives r_l = Q_l^m/Q_{l-1}^m = 1/(b_l + a_l r_{l+1})
+        with b_l = (2l+1) xi/(l+m) and a_l = -(l-m+1)/(l+m), which
+        is evaluated with the modified Lentz algorithm.
+      */
+      const double tiny=1e4*DBL_MIN;
+      double f=tiny;
+      double C=f;
+      double D=0.0;
+      double a=1.0;
+      for(size_t iter=0;iter<cf_maxiter;iter++) {
+        int n=nu+(int) iter;
+        double b=((2*n+1)*xi)/(n+m);
+        D=b+a*D;
+        if(D==0.0)
+          D=tiny;
+        C=b+a/C;
+        if(C==0.0)
+          C=tiny;
+        D=1.0/D;
+        double delta(C*D);
+        f*=delta;
+        if(std::abs(delta-1.0)<2*DBL_EPSILON)
+          return f;
+        a=-((double) (n-m+1))/(n+m);
+      }
+
+      std::ostringstream oss;
+      oss << "Continued fraction for Q_" << nu << "^" << m << "(" << xi << ") did not converge!\n";
+      throw std::logic_error(oss.str());
+    }
+
+    arma::mat Qlm(int lmax, int mmax, const arma::vec & xi) {
+      check_xi(xi,true);
+
+      arma::mat Q(xi.n_elem,(lmax+1)*(mmax+1),arma::fill::zeros);
+      arma::vec s(arma::sqrt((xi-1.0)%(xi+1.0)));
+
+      // Q_0^0 = 1/2 ln((xi+1)/(xi-1)), written in a form that is accurate also for large xi
+      arma::vec Q00(xi.n_elem);
+      for(size_t i=0;i<xi.n_elem;i++)
+        Q00(i)=0.5*std::log1p(2.0/(xi(i)-1.0));
+      // Q_0^1 = -1/sqrt(xi^2-1)
+      arma::vec Q01(-1.0/s);
+
+      /*
+        Upward recursion in l is unstable for Q, since errors grow
+        like P_l/Q_l ~ exp(2 l mu) with xi = cosh(mu). Away from
+        xi=1 the ratios r_l = Q_l^m/Q_{l-1}^m for m=0,1 are therefore
+        recursed downward from the continued fraction at the top, and
+        the functions are then built up from the known Q_0^m. This is
+        Miller's algorithm without the overflow-prone unnormalized
+        intermediates.
+
+        Close to xi=1 the continued fraction converges in O(1/mu)
+        terms, and its convergence test is met long before the value
+        is accurate. There the growth factor exp(2 l mu) is small, so
+        the upward recursion is used instead, started from
+        Q_1^0 = xi Q_0^0 - 1 and Q_1^1 = sqrt(xi^2-1) Q_0^0 - xi/sqrt(xi^2-1).
+      */
+      int ltop(std::max(lmax,1));
+      arma::vec r(ltop+1);
+      for(size_t i=0;i<xi.n_elem;i++) {
+        // mu = acosh(xi), written in a form that is accurate close to xi=1
+        double mu(std::log1p((xi(i)-1.0)+s(i)));
+        bool upward(mu*ltop<upward_mul);
+
+        for(int m=0;m<=std::min(mmax,1);m++) {
+          Q(i,lm_index(0,m,lmax)) = (m==0) ? Q00(i) : Q01(i);
+          if(lmax==0)
+            continue;
+
+          if(upward) {
+            Q(i,lm_index(1,m,lmax)) = (m==0) ? xi(i)*Q00(i)-1.0 : s(i)*Q00(i)-xi(i)/s(i);
+            for(int l=1;l<lmax;l++)
+              Q(i,lm_index(l+1,m,lmax))=((2*l+1)*xi(i)*Q(i,lm_index(l,m,lmax)) - (l+m)*Q(i,lm_index(l-1,m,lmax)))/(l-m+1);
+          } else {
+            r(ltop)=Qlm_ratio(ltop,m,xi(i));
+            for(int l=ltop-1;l>=1;l--)
+              r(l)=(l+m)/((2*l+1)*xi(i) - (l-m+1)*r(l+1));
+            for(int l=1;l<=lmax;l++)
+              Q(i,lm_index(l,m,lmax))=r(l)*Q(i,lm_index(l-1,m,lmax));
+          }
+        }
+      }
+
+      // Q_l^m = -2(m-1) xi/sqrt(xi^2-1) Q_l^{m-1} + (l+m-1)(l-m+2) Q_l^{m-2}
+      arma::vec xs(xi/s);
+      for(int m=2;m<=mmax;m++)
+        for(int l=0;l<=lmax;l++)
+          Q.col(lm_index(l,m,lmax))=(-2.0*(m-1))*(xs%Q.col(lm_index(l,m-1,lmax))) + ((double) (l+m-1)*(l-m+2))*Q.col(lm_index(l,m-2,lmax));
+
+      return Q;
+    }
+  }
+}
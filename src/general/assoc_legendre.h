@@ -0,0 +1,48 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#ifndef ASSOC_LEGENDRE_H
+#define ASSOC_LEGENDRE_H
+
+#include <armadillo>
+
+namespace helfem {
+  namespace assoc_legendre {
+    /**
+     * Associated Legendre functions outside the cut, xi >= 1, as
+     * needed in prolate spheroidal coordinates. The conventions are
+     * those of the Fortran library in src/legendre: P_l^m carries no
+     * Condon-Shortley phase, and Q_0^1 = -1/sqrt(xi^2-1).
+     *
+     * The routines work on whole batches of points and keep no
+     * state, so they can be called concurrently. The values of
+     * (l,m) are returned in column l+(lmax+1)*m of a
+     * <Npoints x (lmax+1)(mmax+1)> matrix.
+     */
+
+    /// Column of (l,m) in the output
+    size_t lm_index(int l, int m, int lmax);
+
+    /// Regular functions P_l^m(xi) for xi >= 1 by upward recursion in l
+    arma::mat Plm(int lmax, int mmax, const arma::vec & xi);
+    /// Irregular functions Q_l^m(xi) for xi > 1 by downward recursion in l for m=0,1 (upward close to xi=1, where it is stable), followed by upward recursion in m
+    arma::mat Qlm(int lmax, int mmax, const arma::vec & xi);
+
+    /// Ratio Q_nu^m(xi) / Q_{nu-1}^m(xi) for m=0,1 from the Lentz-Thompson continued fraction
+    double Qlm_ratio(int nu, int m, double xi);
+  }
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "elementtei.h"
+#include "utils.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace helfem {
+  namespace elementtei {
+    /// Blocks are padded to a multiple of this many entries, so every block starts at the alignment of the buffer itself
+    static const size_t block_padding=16;
+
+    ElementTEI::ElementTEI() : Nch(0) {
+    }
+
+    ElementTEI::ElementTEI(size_t Nch_, const std::vector<size_t> & Nprim_) : Nch(Nch_), Nprim(Nprim_) {
+      size_t Nel(Nprim.size());
+      offset.resize(Nch*Nel+1);
+      size_t ofs=0;
+      for(size_t ich=0;ich<Nch;ich++)
+        for(size_t iel=0;iel<Nel;iel++) {
+          offset[ich*Nel+iel]=ofs;
+          ofs+=padded_pair_size(Nprim[iel]);
+        }
+      offset[Nch*Nel]=ofs;
+      buf.zeros(ofs);
+    }
+
+    ElementTEI::~ElementTEI() {
+    }
+
+    size_t ElementTEI::index(size_t ich, size_t iel) const {
+#ifndef ARMA_NO_DEBUG
+      if(ich>=Nch || iel>=Nprim.size()) {
+        std::ostringstream oss;
+        oss << "Block (" << ich << "," << iel << ") requested but there are only " << Nch << " channels and " << Nprim.size() << " elements!\n";
+        throw std::logic_error(oss.str());
+      }
+#endif
+      return ich*Nprim.size()+iel;
+    }
+
+    size_t ElementTEI::padded_pair_size(size_t N) {
+      // The block is N^2 x N^2
+      size_t N4(N*N*N*N);
+      return ((N4+block_padding-1)/block_padding)*block_padding;
+    }
+
+    size_t ElementTEI::get_Nch() const {
+      return Nch;
+    }
+
+    size_t ElementTEI::get_Nel() const {
+      return Nprim.size();
+    }
+
+    bool ElementTEI::empty() const {
+      return !buf.n_elem && !fbuf.n_elem;
+    }
+
+    bool ElementTEI::single() const {
+      return fbuf.n_elem>0;
+    }
+
+    void ElementTEI::set_block(size_t ich, size_t iel, const arma::mat & M) {
+      size_t N(Nprim[iel]*Nprim[iel]);
+      if(M.n_rows != N || M.n_cols != N) {
+        std::ostringstream oss;
+        oss << "Block is " << M.n_rows << " x " << M.n_cols << " but expected " << N << " x " << N << "!\n";
+        throw std::logic_error(oss.str());
+      }
+      if(single())
+        throw std::logic_error("Cannot set blocks in single precision storage!\n");
+
+      std::copy(M.memptr(),M.memptr()+M.n_elem,buf.memptr()+offset[index(ich,iel)]);
+    }
+
+    const arma::mat ElementTEI::block(size_t ich, size_t iel) const {
+      size_t idx(index(ich,iel));
+      size_t N(Nprim[iel]*Nprim[iel]);
+      if(single())
+        return arma::conv_to<arma::mat>::from(arma::fmat(const_cast<float *>(fbuf.memptr())+offset[idx],N,N,false,true));
+      return arma::mat(const_cast<double *>(buf.memptr())+offset[idx],N,N,false,true);
+    }
+
+    void ElementTEI::gemv(size_t ich, size_t iel, const arma::mat & x, double fac, arma::mat & y) const {
+      size_t idx(index(ich,iel));
+      size_t N(Nprim[iel]*Nprim[iel]);
+      if(single()) {
+        const arma::fmat A(const_cast<float *>(fbuf.memptr())+offset[idx],N,N,false,true);
+        utils::mixed_gemv(A,x,fac,y);
+      } else {
+        const arma::mat A(const_cast<double *>(buf.memptr())+offset[idx],N,N,false,true);
+        y+=fac*(A*x);
+      }
+    }
+
+    void ElementTEI::exchange_gemv(size_t ich, size_t iel, const arma::mat & x, double fac, arma::mat & y) const {
+      size_t idx(index(ich,iel));
+      size_t N(Nprim[iel]);
+      size_t N2(N*N);
+      if(x.n_elem != N2 || y.n_elem != N2) {
+        std::ostringstream oss;
+        oss << "Exchange contraction of a " << N2 << " x " << N2 << " block with " << x.n_elem << " element input and " << y.n_elem << " element output!\n";
+        throw std::logic_error(oss.str());
+      }
+
+      /*
+        In storage order the block is (ii,jj,kk,ll) with ii running
+        fastest, and the exchange contraction is
+        K(jj,kk) = sum_{ii,ll} (ii jj|kk ll) X(ii,ll).
+        The ll:th term is a transposed product with the contiguous
+        N x N^2 slab of fixed ll, so the block is read once in
+        storage order and no permuted copy is needed.
+      */
+      for(size_t ll=0;ll<N;ll++) {
+        const arma::mat xl(const_cast<double *>(x.memptr())+ll*N,N,1,false,true);
+        if(single()) {
+          const arma::fmat A(const_cast<float *>(fbuf.memptr())+offset[idx]+ll*N*N2,N,N2,false,true);
+          utils::mixed_gemv_t(A,xl,fac,y);
+        } else {
+          const arma::mat A(const_cast<double *>(buf.memptr())+offset[idx]+ll*N*N2,N,N2,false,true);
+          y+=fac*(arma::trans(A)*xl);
+        }
+      }
+    }
+
+    void ElementTEI::convert_to_single() {
+      if(single())
+        return;
+      fbuf=arma::conv_to<arma::fvec>::from(buf);
+      buf.reset();
+    }
+
+    arma::mat ElementTEI::norms() const {
+      arma::mat n(Nprim.size(),Nch,arma::fill::zeros);
+      for(size_t ich=0;ich<Nch;ich++)
+        for(size_t iel=0;iel<Nprim.size();iel++)
+          n(iel,ich)=arma::norm(block(ich,iel),"fro");
+      return n;
+    }
+
+    size_t ElementTEI::memory() const {
+      return buf.n_elem*sizeof(double) + fbuf.n_elem*sizeof(float);
+    }
+
+    size_t ElementTEI::required_memory(size_t Nch, const std::vector<size_t> & Nprim, bool single) {
+      size_t n=0;
+      for(size_t iel=0;iel<Nprim.size();iel++)
+        n+=padded_pair_size(Nprim[iel]);
+      return Nch*n*(single ? sizeof(float) : sizeof(double));
+    }
+
+    std::vector<arma::mat> ElementTEI::get_blocks() const {
+      std::vector<arma::mat> blocks(Nch*Nprim.size());
+      for(size_t ich=0;ich<Nch;ich++)
+        for(size_t iel=0;iel<Nprim.size();iel++)
+          // Deep copy
+          blocks[index(ich,iel)]=arma::mat(block(ich,iel));
+      return blocks;
+    }
+
+    void ElementTEI::set_blocks(const std::vector<arma::mat> & blocks) {
+      if(blocks.size() != Nch*Nprim.size()) {
+        std::ostringstream oss;
+        oss << "Got " << blocks.size() << " blocks but expected " << Nch*Nprim.size() << "!\n";
+        throw std::logic_error(oss.str());
+      }
+      for(size_t ich=0;ich<Nch;ich++)
+        for(size_t iel=0;iel<Nprim.size();iel++)
+          set_block(ich,iel,blocks[index(ich,iel)]);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#ifndef ELEMENTTEI_H
+#define ELEMENTTEI_H
+
+#include <armadillo>
+#include <vector>
+
+namespace helfem {
+  namespace elementtei {
+    /**
+     * In-element primitive two-electron integrals. Only the blocks
+     * with both electrons in the same element are stored, since the
+     * integrals between different elements are contracted in
+     * factorized form. The block of coupling channel ich (L or LM)
+     * and element iel is Nprim(iel)^2 x Nprim(iel)^2, and all blocks
+     * live in a single contiguous buffer, each padded to a multiple
+     * of 16 entries.
+     */
+    class ElementTEI {
+      /// Number of coupling channels
+      size_t Nch;
+      /// Number of primitive functions in each element
+      std::vector<size_t> Nprim;
+      /// Offsets of the blocks in the buffer: (ich,iel) is at ich*Nel+iel
+      std::vector<size_t> offset;
+      /// Double precision storage
+      arma::vec buf;
+      /// Single precision storage, used instead of the above when nonempty
+      arma::fvec fbuf;
+
+      /// Index of block
+      size_t index(size_t ich, size_t iel) const;
+      /// Storage size of the N^2 x N^2 block of an element with N primitive functions, including the padding
+      static size_t padded_pair_size(size_t N);
+
+    public:
+      /// Dummy constructor
+      ElementTEI();
+      /// Constructor for zero integrals, given the number of channels and of primitive functions in each element
+      ElementTEI(size_t Nch, const std::vector<size_t> & Nprim);
+      /// Destructor
+      ~ElementTEI();
+
+      /// Number of coupling channels
+      size_t get_Nch() const;
+      /// Number of elements
+      size_t get_Nel() const;
+      /// Have integrals been stored?
+      bool empty() const;
+      /// Are the integrals stored in single precision?
+      bool single() const;
+
+      /// Set block
+      void set_block(size_t ich, size_t iel, const arma::mat & M);
+      /// Get block; in double precision the matrix uses the stored memory, in single precision it is a converted copy
+      const arma::mat block(size_t ich, size_t iel) const;
+      /// Contract y += fac * block(ich,iel) * x in the storage precision
+      void gemv(size_t ich, size_t iel, const arma::mat & x, double fac, arma::mat & y) const;
+      /// Contract y += fac * K * x in the storage precision, where K is block(ich,iel) permuted (ij|kl) -> (jk|il) for exchange
+      void exchange_gemv(size_t ich, size_t iel, const arma::mat & x, double fac, arma::mat & y) const;
+
+      /// Switch to single precision storage
+      void convert_to_single();
+      /// Frobenius norms of the blocks: <Nel x Nch>
+      arma::mat norms() const;
+      /// Memory used by the integrals
+      size_t memory() const;
+      /// Memory needed by the integrals of Nch channels in the given precision
+      static size_t required_memory(size_t Nch, const std::vector<size_t> & Nprim, bool single);
+
+      /// Get all blocks, stored at ich*Nel+iel
+      std::vector<arma::mat> get_blocks() const;
+      /// Set all blocks from the above layout
+      void set_blocks(const std::vector<arma::mat> & blocks);
+    };
+  }
+}
+
+#endif
@@ -24,8 +24,7 @@ extern "C" {
 
 /// Index of (l,m) in tables: l^2 + l + m
 #define genind(l,m) ( ((size_t) (l))*(size_t (l)) + (size_t) (l) + (size_t) (m))
-/// Index of (l,m) in m limited table
-#define LMind(L,M) ( ((size_t) (L))*(size_t (2*Mmax+1)) + (size_t) (Mmax) + (size_t) (M))
+/// Index of (l,m) in m limited tables
 #define lmind(L,M) ( ((size_t) (L))*(size_t (2*mmax+1)) + (size_t) (mmax) + (size_t) (M))
 #define lpmpind(L,M) ( ((size_t) (L))*(size_t (2*mpmax+1)) + (size_t) (mpmax) + (size_t) (M))
 
@@ -70,43 +69,66 @@ namespace helfem {
     Gaunt::Gaunt() {
     }
 
-    Gaunt::Gaunt(int Lmax, int lmax, int lpmax) {
-      // Allocate storage
+    Gaunt::Gaunt(int Lmax_, int lmax_, int lpmax_) : Lmax(Lmax_), lmax(lmax_), lpmax(lpmax_) {
       mlimit=false;
-      table=arma::cube(genind(Lmax,Lmax)+1,genind(lmax,lmax)+1,genind(lpmax,lpmax)+1);
+      Mmax=Lmax;
+      mmax=lmax;
+      mpmax=lpmax;
+      compute();
+    }
 
-      // Compute coefficients
-#ifdef _OPENMP
-#pragma omp parallel for collapse(3)
-#endif
-      for(int L=0;L<=Lmax;L++)
-	  for(int l=0;l<=lmax;l++)
-            for(int lp=0;lp<=lpmax;lp++)
-              for(int M=-L;M<=L;M++)
-                for(int m=-l;m<=l;m++)
-                  for(int mp=-lp;mp<=lp;mp++)
-                    table(genind(L,M),genind(l,m),genind(lp,mp))=gaunt_coefficient(L,M,l,m,lp,mp);
+    Gaunt::Gaunt(int Lmax_, int Mmax_, int lmax_, int mmax_, int lpmax_, int mpmax_) : Lmax(Lmax_), lmax(lmax_), lpmax(lpmax_), Mmax(Mmax_), mmax(mmax_), mpmax(mpmax_) {
+      mlimit=true;
+      compute();
     }
 
-    Gaunt::Gaunt(int Lmax, int Mmax_, int lmax, int mmax_, int lpmax, int mpmax_) : Mmax(Mmax_), mmax(mmax_), mpmax(mpmax_) {
+    Gaunt::~Gaunt() {
+    }
+
+    size_t Gaunt::pair_index(int l, int m, int lp, int mp) const {
+      if(mlimit)
+        return lmind(l,m)*nlpmp + lpmpind(lp,mp);
+      else
+        return genind(l,m)*nlpmp + genind(lp,mp);
+    }
+
+    void Gaunt::compute() {
+      // Number of (l,m) and (lp,mp) indices
+      size_t nlm(mlimit ? lmind(lmax,mmax)+1 : genind(lmax,lmax)+1);
+      nlpmp=(mlimit ? lpmpind(lpmax,mpmax)+1 : genind(lpmax,lpmax)+1);
+
+      // Count the allowed couplings
+      offset.assign(nlm*nlpmp+1,0);
+      for(int l=0;l<=lmax;l++)
+        for(int m=-std::min(l,mmax);m<=std::min(l,mmax);m++)
+          for(int lp=0;lp<=lpmax;lp++)
+            for(int mp=-std::min(lp,mpmax);mp<=std::min(lp,mpmax);mp++) {
+              if(mlimit && std::abs(m+mp)>Mmax)
+                continue;
+              int Lmin(std::abs(l-lp));
+              int Lupp(std::min(l+lp,Lmax));
+              if(Lupp>=Lmin)
+                offset[pair_index(l,m,lp,mp)+1]=(Lupp-Lmin)/2+1;
+            }
+      for(size_t i=1;i<offset.size();i++)
+        offset[i]+=offset[i-1];
+
       // Allocate storage
-      mlimit=true;
-      table=arma::cube(LMind(Lmax,Mmax)+1,lmind(lmax,mmax)+1,lpmpind(lpmax,mpmax)+1);
+      table.zeros(offset[offset.size()-1]);
 
       // Compute coefficients
 #ifdef _OPENMP
-#pragma omp parallel for collapse(3)
+#pragma omp parallel for schedule(dynamic)
 #endif
-      for(int L=0;L<=Lmax;L++)
-	  for(int l=0;l<=lmax;l++)
-            for(int lp=0;lp<=lpmax;lp++)
-              for(int M=-Mmax;M<=Mmax;M++)
-                for(int m=-mmax;m<=mmax;m++)
-                  for(int mp=-mpmax;mp<=mpmax;mp++)
-                    table(LMind(L,M),lmind(l,m),lpmpind(lp,mp))=gaunt_coefficient(L,M,l,m,lp,mp);
-    }
-
-    Gaunt::~Gaunt() {
+      for(int l=0;l<=lmax;l++)
+        for(int m=-std::min(l,mmax);m<=std::min(l,mmax);m++)
+          for(int lp=0;lp<=lpmax;lp++)
+            for(int mp=-std::min(lp,mpmax);mp<=std::min(lp,mpmax);mp++) {
+              size_t ipair(pair_index(l,m,lp,mp));
+              size_t idx(offset[ipair]);
+              for(int L=std::abs(l-lp);idx<offset[ipair+1];L+=2)
+                table(idx++)=gaunt_coefficient(L,m+mp,l,m,lp,mp);
+            }
     }
 
     double Gaunt::coeff(int L, int M, int l, int m, int lp, int mp) const {
@@ -114,41 +136,24 @@ namespace helfem {
       if(std::abs(m)>l) return 0.0;
       if(std::abs(mp)>lp) return 0.0;
 
-      size_t irow, icol, islice;
-      if(mlimit) {
-        irow=LMind(L,M);
-        icol=lmind(l,m);
-        islice=lpmpind(lp,mp);
-      } else {
-        irow=genind(L,M);
-        icol=genind(l,m);
-        islice=genind(lp,mp);
-      }
+      // Selection rules
+      if(M != m+mp) return 0.0;
+      if(L < std::abs(l-lp) || L > l+lp) return 0.0;
+      if((L+l+lp)%2) return 0.0;
 
 #ifndef ARMA_NO_DEBUG
-      if(irow>table.n_rows) {
-        std::ostringstream oss;
-        oss << "Row index overflow for coeff(" << L << "," << M << "," << l << "," << m << "," << lp << "," << mp << ")!\n";
-        oss << "Wanted element at (" << irow << "," << icol << "," << islice << ") but table is " << table.n_rows << " x " << table.n_cols << " x " << table.n_slices << "\n";
-        throw std::logic_error(oss.str());
-      }
-
-      if(icol>table.n_cols) {
-        std::ostringstream oss;
-        oss << "Column index overflow for coeff(" << L << "," << M << "," << l << "," << m << "," << lp << "," << mp << ")!\n";
-        oss << "Wanted element at (" << irow << "," << icol << "," << islice << ") but table is " << table.n_rows << " x " << table.n_cols << " x " << table.n_slices << "\n";
-        throw std::logic_error(oss.str());
-      }
-
-      if(islice>table.n_slices) {
+      if(L>Lmax || l>lmax || lp>lpmax || (mlimit && (std::abs(M)>Mmax || std::abs(m)>mmax || std::abs(mp)>mpmax))) {
         std::ostringstream oss;
-        oss << "Slice index overflow for coeff(" << L << "," << M << "," << l << "," << m << "," << lp << "," << mp << ")!\n";
-        oss << "Wanted element at (" << irow << "," << icol << "," << islice << ") but table is " << table.n_rows << " x " << table.n_cols << " x " << table.n_slices << "\n";
+        oss << "Index overflow for coeff(" << L << "," << M << "," << l << "," << m << "," << lp << "," << mp << ")!\n";
+        oss << "Table has Lmax = " << Lmax << ", lmax = " << lmax << ", lpmax = " << lpmax;
+        if(mlimit)
+          oss << ", Mmax = " << Mmax << ", mmax = " << mmax << ", mpmax = " << mpmax;
+        oss << "\n";
         throw std::logic_error(oss.str());
       }
 #endif
 
-      return table(irow,icol,islice);
+      return table(offset[pair_index(l,m,lp,mp)] + (L-std::abs(l-lp))/2);
     }
 
     double Gaunt::cosine_coupling(int lj, int mj, int li, int mi) const {
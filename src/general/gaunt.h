@@ -17,6 +17,7 @@
 #define GAUNT
 
 #include <armadillo>
+#include <vector>
 
 namespace helfem {
   namespace gaunt {
@@ -29,14 +30,31 @@ namespace helfem {
     /// Get "modified" Gaunt coefficient (interim coupling through cos^2)
     double modified_gaunt_coefficient(int L, int M, int l, int m, int lp, int mp);
 
-    /// Table of Gaunt coefficients
+    /**
+     * Table of Gaunt coefficients.
+     *
+     * Only the couplings allowed by the selection rules are stored:
+     * M=m+mp is implied, and L runs over |l-lp|, |l-lp|+2, ..., l+lp.
+     * The couplings of each (l,m,lp,mp) are stored contiguously.
+     */
     class Gaunt {
       /// Table of coefficients
-      arma::cube table;
+      arma::vec table;
+      /// Offset of the couplings of (l,m,lp,mp) in the table
+      std::vector<size_t> offset;
+      /// Maximum L values
+      int Lmax, lmax, lpmax;
       /// Limited m set
       bool mlimit;
       /// Maximum m values
       int Mmax, mmax, mpmax;
+      /// Number of (lp,mp) indices
+      size_t nlpmp;
+
+      /// Index of (l,m,lp,mp) in the offset table
+      size_t pair_index(int l, int m, int lp, int mp) const;
+      /// Compute the table
+      void compute();
 
     public:
       /// Dummy constructor
@@ -0,0 +1,181 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "integralcache.h"
+#include "checkpoint.h"
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/// Version of the cache format
+#define INTEGRALCACHE_VERSION 2
+
+Fingerprint::Fingerprint() {
+  // FNV-1a offset basis
+  hash=UINT64_C(14695981039346656037);
+}
+
+Fingerprint::~Fingerprint() {
+}
+
+void Fingerprint::add(const void * data, size_t len) {
+  const unsigned char * p((const unsigned char *) data);
+  for(size_t i=0;i<len;i++) {
+    hash^=(uint64_t) p[i];
+    // FNV-1a prime
+    hash*=UINT64_C(1099511628211);
+  }
+}
+
+void Fingerprint::add(int val) {
+  add(&val,sizeof(val));
+}
+
+void Fingerprint::add(double val) {
+  add(&val,sizeof(val));
+}
+
+void Fingerprint::add(const std::string & val) {
+  // Include length so that concatenations don't collide
+  add((int) val.size());
+  add(val.c_str(),val.size());
+}
+
+void Fingerprint::add(const arma::vec & val) {
+  add((int) val.n_elem);
+  add(val.memptr(),val.n_elem*sizeof(double));
+}
+
+void Fingerprint::add(const arma::ivec & val) {
+  add((int) val.n_elem);
+  for(size_t i=0;i<val.n_elem;i++)
+    add((int) val(i));
+}
+
+std::string Fingerprint::hex() const {
+  char str[17];
+  snprintf(str,sizeof(str),"%016llx",(unsigned long long) hash);
+  return std::string(str);
+}
+
+IntegralCache::IntegralCache(const std::string & dir) : directory(dir) {
+  // Create the directory if necessary
+  if(mkdir(directory.c_str(),0755) && errno!=EEXIST) {
+    std::ostringstream oss;
+    oss << "Could not create integral cache directory \"" << directory << "\".\n";
+    throw std::runtime_error(oss.str());
+  }
+}
+
+IntegralCache::~IntegralCache() {
+}
+
+std::string IntegralCache::path(const std::string & key) const {
+  return directory + "/" + key + ".h5";
+}
+
+bool IntegralCache::exists(const std::string & key) const {
+  return file_exists(path(key));
+}
+
+bool IntegralCache::load(const std::string & key, const std::vector<std::string> & names, const std::vector< std::vector<arma::mat> * > & sets) const {
+  if(names.size() != sets.size())
+    throw std::logic_error("Number of names and integral sets does not match!\n");
+  if(!exists(key))
+    return false;
+
+  Checkpoint chk(path(key),false);
+
+  // Check the entry
+  int version;
+  chk.read("version",version);
+  std::string storedkey;
+  chk.read("key",storedkey);
+  if(version != INTEGRALCACHE_VERSION || storedkey != key)
+    return false;
+  for(size_t is=0;is<names.size();is++)
+    if(!chk.exist(names[is]+"_N"))
+      return false;
+
+  for(size_t is=0;is<names.size();is++) {
+    // Number of matrices and the ones that are stored
+    hsize_t N;
+    chk.read(names[is]+"_N",N);
+    std::vector<hsize_t> idx;
+    if(chk.exist(names[is]+"_idx"))
+      chk.read(names[is]+"_idx",idx);
+
+    std::vector<arma::mat> & ints(*sets[is]);
+    ints.clear();
+    ints.resize(N);
+    for(size_t i=0;i<idx.size();i++) {
+      std::ostringstream name;
+      name << names[is] << "_" << idx[i];
+      chk.read(name.str(),ints[idx[i]]);
+    }
+  }
+
+  return true;
+}
+
+void IntegralCache::save(const std::string & key, const std::vector<std::string> & names, const std::vector< const std::vector<arma::mat> * > & sets) const {
+  if(names.size() != sets.size())
+    throw std::logic_error("Number of names and integral sets does not match!\n");
+
+  // Write to a temporary file in the cache directory first
+  std::ostringstream tmpname;
+  tmpname << directory << "/." << key << "." << getpid() << ".tmp";
+  try {
+    Checkpoint chk(tmpname.str(),true);
+    chk.open();
+    chk.write("version",INTEGRALCACHE_VERSION);
+    chk.write("key",key);
+    for(size_t is=0;is<names.size();is++) {
+      const std::vector<arma::mat> & ints(*sets[is]);
+
+      // Only nonempty matrices are stored
+      std::vector<hsize_t> idx;
+      for(size_t i=0;i<ints.size();i++) {
+        if(!ints[i].n_elem)
+          continue;
+        idx.push_back(i);
+
+        std::ostringstream name;
+        name << names[is] << "_" << i;
+        chk.write(name.str(),ints[i]);
+      }
+      chk.write(names[is]+"_N",(hsize_t) ints.size());
+      if(idx.size())
+        chk.write(names[is]+"_idx",idx);
+    }
+    chk.close();
+  } catch(...) {
+    // Don't leave a partial entry behind
+    std::remove(tmpname.str().c_str());
+    throw;
+  }
+
+  // and then atomically move it in place
+  if(std::rename(tmpname.str().c_str(),path(key).c_str())) {
+    std::remove(tmpname.str().c_str());
+    std::ostringstream oss;
+    oss << "Could not move integral cache entry into \"" << path(key) << "\".\n";
+    throw std::runtime_error(oss.str());
+  }
+}
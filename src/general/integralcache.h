@@ -0,0 +1,80 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#ifndef INTEGRALCACHE_H
+#define INTEGRALCACHE_H
+
+#include <armadillo>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/// Fingerprint of data used as an integral cache key (64-bit FNV-1a hash)
+class Fingerprint {
+  /// Hash value
+  uint64_t hash;
+
+ public:
+  /// Constructor
+  Fingerprint();
+  /// Destructor
+  ~Fingerprint();
+
+  /// Add raw data
+  void add(const void * data, size_t len);
+  /// Add integer
+  void add(int val);
+  /// Add double
+  void add(double val);
+  /// Add string
+  void add(const std::string & val);
+  /// Add vector
+  void add(const arma::vec & val);
+  /// Add integer vector
+  void add(const arma::ivec & val);
+
+  /// Get hash as hexadecimal string
+  std::string hex() const;
+};
+
+/**
+ * On-disk cache of primitive integrals. Every entry is a separate HDF5
+ * file in the cache directory, named by its key. Entries are written
+ * to a temporary file that is renamed into place once complete, so
+ * readers never see partially written entries and any number of
+ * concurrent readers is safe.
+ */
+class IntegralCache {
+  /// Cache directory
+  std::string directory;
+
+  /// File name corresponding to key
+  std::string path(const std::string & key) const;
+
+ public:
+  /// Constructor
+  IntegralCache(const std::string & directory);
+  /// Destructor
+  ~IntegralCache();
+
+  /// Is there an entry for the key?
+  bool exists(const std::string & key) const;
+  /// Load the named integral sets; returns false if the entry does not exist
+  bool load(const std::string & key, const std::vector<std::string> & names, const std::vector< std::vector<arma::mat> * > & sets) const;
+  /// Save the named integral sets
+  void save(const std::string & key, const std::vector<std::string> & names, const std::vector< const std::vector<arma::mat> * > & sets) const;
+};
+
+#endif
@@ -14,15 +14,15 @@
  * of the License, or (at your option) any later version.
  */
 #include "legendretable.h"
+#include "assoc_legendre.h"
 #include <algorithm>
-#include "../legendre/Legendre_Wrapper.h"
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace helfem {
   namespace legendretable {
-    bool operator<(const legendre_table_t & lh, const legendre_table_t & rh) {
-      return lh.xi < rh.xi;
-    }
-
     LegendreTable::LegendreTable() {
       Lpad=-1;
       Lmax=-1;
@@ -35,101 +35,112 @@ namespace helfem {
     LegendreTable::~LegendreTable() {
     }
 
-    size_t LegendreTable::get_index(double xi, bool check) const {
-      legendre_table_t p;
-      p.xi=xi;
-
-      std::vector<legendre_table_t>::const_iterator low(std::lower_bound(stor.begin(),stor.end(),p));
-      if(check && low == stor.end()) {
+    size_t LegendreTable::lm_index(int l, int m) const {
+#ifndef ARMA_NO_DEBUG
+      if(l<0 || l>Lmax || m<0 || m>Mmax) {
         std::ostringstream oss;
-        oss << "Could not find xi=" << xi << " on the list!\n";
+        oss << "Requested l=" << l << ", m=" << m << " but table only has Lmax=" << Lmax << ", Mmax=" << Mmax << "!\n";
         throw std::logic_error(oss.str());
       }
+#endif
+      return l+(Lmax+1)*m;
+    }
 
-      // Index is
-      size_t idx(low-stor.begin());
-      if(check && (stor[idx].xi != xi)) {
+    void LegendreTable::check_range(size_t ip, size_t n) const {
+#ifndef ARMA_NO_DEBUG
+      if(ip+n>xi.n_elem) {
         std::ostringstream oss;
-        oss << "Map error: tried to get xi = " << xi << " but got xi = " << stor[idx].xi << "!\n";
+        oss << "Requested points " << ip << " to " << ip+n << " but table only has " << xi.n_elem << " points!\n";
         throw std::logic_error(oss.str());
       }
-
-      return idx;
+#else
+      (void) ip;
+      (void) n;
+#endif
     }
 
-    void LegendreTable::compute(double xi) {
+    void LegendreTable::compute(const arma::vec & xi_) {
+      xi=xi_;
+      Plm.zeros(xi.n_elem,(Lmax+1)*(Mmax+1));
+      Qlm.zeros(xi.n_elem,(Lmax+1)*(Mmax+1));
+
+      // Q is singular at xi=1, where the table is left zero
+      arma::uvec idx(arma::find(xi>1.0));
+      // The points are computed in independent batches. Exceptions
+      // must not escape the parallel region, so the first error is
+      // stored and thrown afterwards
+      const size_t batchsize=64;
+      size_t nbatch((idx.n_elem+batchsize-1)/batchsize);
+      std::string error;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1)
+#endif
+      for(size_t ib=0;ib<nbatch;ib++) {
+        try {
+          arma::uvec bidx(idx.subvec(ib*batchsize,std::min((ib+1)*batchsize,(size_t) idx.n_elem)-1));
+          arma::vec bxi(xi.elem(bidx));
+
+          // The continued fraction for Q is started at Lpad
+          arma::mat P(assoc_legendre::Plm(Lmax,Mmax,bxi));
+          arma::mat Q(assoc_legendre::Qlm(Lpad,Mmax,bxi));
+
+          // Store only 0 to lmax, getting rid of any non-normal entries
+          for(int M=0;M<=Mmax;M++)
+            for(int L=0;L<=Lmax;L++) {
+              size_t ilm(lm_index(L,M));
+              size_t ip(assoc_legendre::lm_index(L,M,Lmax));
+              size_t iq(assoc_legendre::lm_index(L,M,Lpad));
+              for(size_t i=0;i<bidx.n_elem;i++) {
+                if(std::isnormal(P(i,ip)))
+                  Plm(bidx(i),ilm)=P(i,ip);
+                if(std::isnormal(Q(i,iq)))
+                  Qlm(bidx(i),ilm)=Q(i,iq);
+              }
+            }
+        } catch(const std::exception & e) {
 #ifdef _OPENMP
 #pragma omp critical
 #endif
-      {
-        legendre_table_t entry;
-
-        // Allocate memory
-        entry.xi=xi;
-        entry.Plm.zeros(Lpad+1,Lpad+1);
-        entry.Qlm.zeros(Lpad+1,Lpad+1);
-
-        // Compute
-        if(xi!=1.0) {
-          ::calc_Plm_arr(entry.Plm.memptr(),Lpad,Lpad,xi);
-          ::calc_Qlm_arr(entry.Qlm.memptr(),Lpad,Lpad,xi);
+          if(error.empty())
+            error=e.what();
         }
-
-        // Store only 0 to lmax
-        entry.Plm=entry.Plm.submat(0,0,Lmax,Mmax);
-        entry.Qlm=entry.Qlm.submat(0,0,Lmax,Mmax);
-
-        // Get rid of any non-normal entries
-        for(int L=0;L<=Lmax;L++)
-          for(int M=0;M<=Mmax;M++) {
-            if(!std::isnormal(entry.Plm(L,M)))
-              entry.Plm(L,M)=0.0;
-            if(!std::isnormal(entry.Qlm(L,M)))
-              entry.Qlm(L,M)=0.0;
-          }
-
-        if(!stor.size())
-          stor.push_back(entry);
-        else
-          // Insert at lower bound
-          stor.insert(stor.begin()+get_index(xi,false),entry);
       }
+      if(!error.empty())
+        throw std::logic_error(error);
     }
 
-    double LegendreTable::get_Plm(int l, int m, double xi) const {
-#ifndef ARMA_NO_DEBUG
-      if(get_index(xi)>stor.size()) {
-        std::ostringstream oss;
-        oss << "Error in get_Plm(" << l << "," << m << "," << xi << "): index " << get_index(xi) << " greater than array size " << stor.size() << "!\n";
-        throw std::logic_error(oss.str());
-      }
-#endif
-      return stor[get_index(xi)].Plm(l,m);
+    size_t LegendreTable::get_Npoints() const {
+      return xi.n_elem;
     }
 
-    double LegendreTable::get_Qlm(int l, int m, double xi) const {
-#ifndef ARMA_NO_DEBUG
-      if(get_index(xi)>stor.size()) {
-        std::ostringstream oss;
-        oss << "Error in get_Qlm(" << l << "," << m << "," << xi << "): index " << get_index(xi) << " greater than array size " << stor.size() << "!\n";
-        throw std::logic_error(oss.str());
-      }
-#endif
-      return stor[get_index(xi)].Qlm(l,m);
+    double LegendreTable::get_xi(size_t ip) const {
+      check_range(ip,1);
+      return xi(ip);
+    }
+
+    arma::vec LegendreTable::get_xi(size_t ip, size_t n) const {
+      check_range(ip,n);
+      return xi.subvec(ip,ip+n-1);
+    }
+
+    double LegendreTable::get_Plm(int l, int m, size_t ip) const {
+      check_range(ip,1);
+      return Plm(ip,lm_index(l,m));
+    }
+
+    double LegendreTable::get_Qlm(int l, int m, size_t ip) const {
+      check_range(ip,1);
+      return Qlm(ip,lm_index(l,m));
     }
 
-    arma::vec LegendreTable::get_Plm(int l, int m, const arma::vec & xi) const {
-      arma::vec plm(xi.n_elem);
-      for(size_t i=0;i<xi.n_elem;i++)
-        plm(i)=get_Plm(l,m,xi(i));
-      return plm;
+    arma::vec LegendreTable::get_Plm(int l, int m, size_t ip, size_t n) const {
+      check_range(ip,n);
+      return Plm.col(lm_index(l,m)).subvec(ip,ip+n-1);
     }
 
-    arma::vec LegendreTable::get_Qlm(int l, int m, const arma::vec & xi) const {
-      arma::vec qlm(xi.n_elem);
-      for(size_t i=0;i<xi.n_elem;i++)
-        qlm(i)=get_Qlm(l,m,xi(i));
-      return qlm;
+    arma::vec LegendreTable::get_Qlm(int l, int m, size_t ip, size_t n) const {
+      check_range(ip,n);
+      return Qlm.col(lm_index(l,m)).subvec(ip,ip+n-1);
     }
   }
 }
@@ -16,35 +16,36 @@
 #ifndef LEGENDRE_TABLE_H
 #define LEGENDRE_TABLE_H
 
-#include <vector>
 #include <armadillo>
 
 namespace helfem {
   namespace legendretable {
-    typedef struct {
-      /// Value of argument
-      double xi;
-      /// Plm values
-      arma::mat Plm;
-      /// Qlm values
-      arma::mat Qlm;
-    } legendre_table_t;
-
-    bool operator<(const legendre_table_t & lh, const legendre_table_t & rh);
-
+    /**
+     * Table of the Legendre functions Plm(xi) and Qlm(xi) at a fixed
+     * set of points. The points are addressed by their index in the
+     * array given to compute(), so lookups involve no search. The
+     * values of each (l,m) are stored contiguously over the points,
+     * so that a run of consecutive points is a single slab.
+     */
     class LegendreTable {
     private:
-      /// Storage array
-      std::vector<legendre_table_t> stor;
-      /// Maximum L value used in the actual computation
+      /// L value at which the downward recursion for Qlm is started
       int Lpad;
       /// Maximum L value
       int Lmax;
       /// Maximum M value
       int Mmax;
+      /// Tabulated points
+      arma::vec xi;
+      /// Plm values: <Npoints x (Lmax+1)(Mmax+1)>
+      arma::mat Plm;
+      /// Qlm values: <Npoints x (Lmax+1)(Mmax+1)>
+      arma::mat Qlm;
 
-      /// Find index in array
-      size_t get_index(double xi, bool check=true) const;
+      /// Column of (l,m)
+      size_t lm_index(int l, int m) const;
+      /// Check that the points [ip, ip+n) are in the table
+      void check_range(size_t ip, size_t n) const;
 
     public:
       /// Dummy constructor
@@ -53,18 +54,25 @@ namespace helfem {
       LegendreTable(int Lpad, int Lmax, int Mmax);
       /// Destructor
       ~LegendreTable();
-      /// Add value to table
-      void compute(double xi);
+      /// Compute the table at the given points, replacing any earlier contents
+      void compute(const arma::vec & xi);
+
+      /// Number of points in the table
+      size_t get_Npoints() const;
+      /// Get the ip:th point
+      double get_xi(size_t ip) const;
+      /// Get the points [ip, ip+n)
+      arma::vec get_xi(size_t ip, size_t n) const;
 
-      /// Get value from table
-      double get_Plm(int l, int m, double xi) const;
-      /// Get value from table
-      double get_Qlm(int l, int m, double xi) const;
+      /// Get value at the ip:th point
+      double get_Plm(int l, int m, size_t ip) const;
+      /// Get value at the ip:th point
+      double get_Qlm(int l, int m, size_t ip) const;
 
-      /// Get value from table
-      arma::vec get_Plm(int l, int m, const arma::vec & xi) const;
-      /// Get value from table
-      arma::vec get_Qlm(int l, int m, const arma::vec & xi) const;
+      /// Get values at the points [ip, ip+n)
+      arma::vec get_Plm(int l, int m, size_t ip, size_t n) const;
+      /// Get values at the points [ip, ip+n)
+      arma::vec get_Qlm(int l, int m, size_t ip, size_t n) const;
     };
   }
 }
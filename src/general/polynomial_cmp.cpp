@@ -0,0 +1,101 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "lobatto.h"
+#include "polynomial.h"
+#include "polynomial_basis.h"
+#include "polynomial_kernels.h"
+#include "cmdline.h"
+#include <helfem.h>
+#include <cmath>
+#include <cstdio>
+
+using namespace helfem;
+
+/// Compare the kernel values, first and second derivatives to the reference ones
+double compare(const char * name, int n, bool found, const arma::mat * ker, const arma::mat * ref) {
+  if(!found) {
+    printf("%-8s n = %2i: no specialized kernel\n",name,n);
+    return INFINITY;
+  }
+
+  double d[3];
+  for(int der=0;der<3;der++)
+    d[der]=utils::max_rel_diff(ref[der],ker[der]);
+  printf("%-8s n = %2i: relative differences %e %e %e\n",name,n,d[0],d[1],d[2]);
+  return std::max(d[0],std::max(d[1],d[2]));
+}
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("npoints", 0, "number of points", false, 101);
+  parser.add<double>("thr", 0, "threshold for kernel vs reference", false, 1e-9);
+  parser.parse_check(argc, argv);
+
+  int npoints(parser.get<int>("npoints"));
+  double thr(parser.get<double>("thr"));
+
+  // Points cover the whole element
+  arma::vec x(arma::linspace<arma::vec>(-1.0,1.0,npoints));
+
+  double maxdiff=0.0;
+  for(int n=polynomial_kernels::min_nodes;n<=polynomial_kernels::max_nodes;n++) {
+    arma::mat ker[3], ref[3];
+
+    // Lagrange interpolating polynomials on Gauss-Lobatto nodes
+    arma::vec x0, wx0;
+    ::lobatto_compute(n,x0,wx0);
+    arma::vec w0(n,arma::fill::ones);
+    for(int fi=0;fi<n;fi++)
+      for(int fj=0;fj<n;fj++)
+        if(fi!=fj)
+          w0(fi)/=x0(fi)-x0(fj);
+    bool found(polynomial_kernels::lip_eval(x0,w0,x,&ker[0],&ker[1],&ker[2]));
+    for(int der=0;der<3;der++)
+      ref[der]=polynomial_basis::lip_reference(x0,x,der);
+    maxdiff=std::max(maxdiff,compare("LIP",n,found,ker,ref));
+
+    // Legendre polynomials
+    found=polynomial_kernels::legendre_eval(n-1,x,&ker[0],&ker[1],&ker[2]);
+    for(int der=0;der<3;der++)
+      ref[der]=polynomial_basis::legendre_reference(n-1,x,der);
+    maxdiff=std::max(maxdiff,compare("Legendre",n,found,ker,ref));
+  }
+
+  // Hermite polynomials with the supported continuity orders; the
+  // number of coefficients is the number of nodes times der_order+1
+  for(int der_order=0;der_order<=2;der_order++)
+    for(int nnodes=2;nnodes*(der_order+1)<=polynomial_kernels::max_coeffs;nnodes++) {
+      arma::mat C(polynomial::hermite_coeffs(nnodes,der_order));
+      if((int) C.n_rows<polynomial_kernels::min_nodes)
+        continue;
+
+      arma::mat ker[3], ref[3];
+      bool found(polynomial_kernels::horner_eval(C,x,&ker[0],&ker[1],&ker[2]));
+      ref[0]=polynomial::polyval(C,x);
+      for(int der=1;der<3;der++)
+        ref[der]=polynomial::polyval(polynomial::derivative_coeffs(C,der),x);
+
+      char name[16];
+      snprintf(name,sizeof(name),"Hermite%i",der_order);
+      maxdiff=std::max(maxdiff,compare(name,C.n_rows,found,ker,ref));
+    }
+
+  printf("Maximum relative difference of specialized vs reference evaluation %e\n",maxdiff);
+
+  return utils::test_status(maxdiff>thr);
+}
@@ -0,0 +1,131 @@
+/*
+ *                This source code is part of
+ *
+ *                          HelFEM
+ *                             -
+ * Finite element methods for electronic structure calculations on small systems
+ *
+ * Written by Susi Lehtola, 2018-
+ * Copyright (c) 2018- Susi Lehtola
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+#include "Legendre_Wrapper.h"
+#include "../general/assoc_legendre.h"
+#include "../general/cmdline.h"
+#include <helfem.h>
+
+using namespace helfem;
+
+int main(int argc, char **argv) {
+  cmdline::parser parser;
+
+  // full option name, no short option, description, argument required
+  parser.add<int>("Lmax", 0, "maximum l", false, 30);
+  parser.add<int>("Mmax", 0, "maximum m", false, 30);
+  parser.add<int>("lpad", 0, "padding of l in the Fortran calculation", false, 20);
+  parser.add<double>("mumin", 0, "smallest mu", false, 1e-7);
+  parser.add<double>("mumax", 0, "largest mu", false, 10.0);
+  parser.add<int>("npoints", 0, "number of points", false, 200);
+  parser.add<double>("Pthr", 0, "threshold for P vs Fortran", false, 1e-10);
+  parser.add<double>("Qthr", 0, "threshold for Q vs Fortran", false, 1e-7);
+  parser.add<double>("Qfmumin", 0, "smallest mu for Q vs Fortran; the Fortran continued fraction is inaccurate close to xi=1", false, 0.05);
+  parser.add<double>("Qcthr", 0, "threshold for Q vs the closed form close to xi=1", false, 1e-11);
+  parser.add<double>("Wthr", 0, "threshold for the Wronskian", false, 1e-10);
+  parser.parse_check(argc, argv);
+
+  int Lmax(parser.get<int>("Lmax"));
+  int Mmax(parser.get<int>("Mmax"));
+  int lpad(parser.get<int>("lpad"));
+  double mumin(parser.get<double>("mumin"));
+  double mumax(parser.get<double>("mumax"));
+  int npoints(parser.get<int>("npoints"));
+  double Pthr(parser.get<double>("Pthr"));
+  double Qthr(parser.get<double>("Qthr"));
+  double Qfmumin(parser.get<double>("Qfmumin"));
+  double Qcthr(parser.get<double>("Qcthr"));
+  double Wthr(parser.get<double>("Wthr"));
+
+  // Logarithmic grid in mu; xi-1 = 2 sinh^2(mu/2) is accurate also for small mu
+  arma::vec mu(arma::exp(arma::linspace<arma::vec>(std::log(mumin),std::log(mumax),npoints)));
+  arma::vec xi(1.0+2.0*arma::square(arma::sinh(0.5*mu)));
+
+  // All points in one batch
+  arma::mat P(assoc_legendre::Plm(Lmax,Mmax,xi));
+  arma::mat Q(assoc_legendre::Qlm(Lmax,Mmax,xi));
+
+  double Pdiff=0.0, Qdiff=0.0, Wdiff=0.0, Qcdiff=0.0;
+  int Lpad(Lmax+lpad);
+  for(size_t ip=0;ip<xi.n_elem;ip++) {
+    // Fortran reference, computed with the same padding as in the diatomic code
+    arma::mat Pf(Lpad+1,Lpad+1), Qf(Lpad+1,Lpad+1);
+    ::calc_Plm_arr(Pf.memptr(),Lpad,Lpad,xi(ip));
+    ::calc_Qlm_arr(Qf.memptr(),Lpad,Lpad,xi(ip));
+
+    arma::mat Pc(Lmax+1,Mmax+1), Qc(Lmax+1,Mmax+1);
+    for(int m=0;m<=Mmax;m++)
+      for(int l=0;l<=Lmax;l++) {
+        Pc(l,m)=P(ip,assoc_legendre::lm_index(l,m,Lmax));
+        Qc(l,m)=Q(ip,assoc_legendre::lm_index(l,m,Lmax));
+      }
+    double dP(utils::max_pointwise_rel_diff(Pf.submat(0,0,Lmax,Mmax),Pc));
+    double dQ(mu(ip)>=Qfmumin ? utils::max_pointwise_rel_diff(Qf.submat(0,0,Lmax,Mmax),Qc) : 0.0);
+
+    /*
+      Close to xi=1 the Wronskian does not detect an admixture of P
+      in Q, so Q is also checked against the closed form
+      Q_l^0 = P_l^0 Q_0^0 - sum_{k=1}^l P_{k-1}^0 P_{l-k}^0 / k
+      and Q_l^1 = l (xi Q_l^0 - Q_{l-1}^0)/sqrt(xi^2-1), which are
+      free of cancellation when mu*Lmax is small.
+    */
+    double dQc=0.0;
+    if(mu(ip)*Lmax<=1.0 && Mmax>=1) {
+      double s(std::sqrt((xi(ip)-1.0)*(xi(ip)+1.0)));
+      double Q00(0.5*std::log1p(2.0/(xi(ip)-1.0)));
+      arma::mat Qcf(Lmax+1,2);
+      for(int l=0;l<=Lmax;l++) {
+        Qcf(l,0)=Pc(l,0)*Q00;
+        for(int k=1;k<=l;k++)
+          Qcf(l,0)-=Pc(k-1,0)*Pc(l-k,0)/k;
+      }
+      Qcf(0,1)=-1.0/s;
+      for(int l=1;l<=Lmax;l++)
+        Qcf(l,1)=l*(xi(ip)*Qcf(l,0)-Qcf(l-1,0))/s;
+      dQc=utils::max_pointwise_rel_diff(Qcf,Qc.cols(0,1));
+    }
+
+    // Wronskian P_l^m Q_{l-1}^m - P_{l-1}^m Q_l^m = (-1)^m (l+m-1)!/(l-m)!
+    double dW=0.0;
+    for(int m=0;m<=Mmax;m++)
+      for(int l=std::max(m,1);l<=Lmax;l++) {
+        double W(Pc(l,m)*Qc(l-1,m)-Pc(l-1,m)*Qc(l,m));
+        if(!std::isnormal(W))
+          continue;
+        double Wex(1.0);
+        if(m==0)
+          Wex/=l;
+        else
+          for(int k=l-m+1;k<=l+m-1;k++)
+            Wex*=k;
+        if(m%2)
+          Wex=-Wex;
+        dW=std::max(dW,std::abs(W/Wex-1.0));
+      }
+
+    printf("mu = %e: P difference %e, Q difference %e, Q closed form difference %e, Wronskian error %e\n",mu(ip),dP,dQ,dQc,dW);
+    Pdiff=std::max(Pdiff,dP);
+    Qdiff=std::max(Qdiff,dQ);
+    Wdiff=std::max(Wdiff,dW);
+    Qcdiff=std::max(Qcdiff,dQc);
+  }
+
+  printf("Maximum relative difference to Fortran: P %e, Q %e\n",Pdiff,Qdiff);
+  printf("Maximum relative difference of Q to the closed form %e\n",Qcdiff);
+  printf("Maximum relative Wronskian error %e\n",Wdiff);
+
+  bool fail = (Pdiff>Pthr) || (Qdiff>Qthr) || (Qcdiff>Qcthr) || (Wdiff>Wthr);
+  return utils::test_status(fail);
+}
@@ -61,9 +61,14 @@ namespace helfem {
       }
 
       arma::mat TwoDBasis::Sinvh() const {
-        // Form overlap matrix
-        arma::mat S(overlap());
-        return scf::form_Sinvh(S,false);
+        // Cholesky half-inverse from the banded factorization, which
+        // is O(N^2 kd) instead of the O(N^3) dense diagonalization
+        // of the symmetric orthogonalization
+        return banded::invh(radial.overlap(),true);
+      }
+
+      banded::BandedMatrix TwoDBasis::overlap_banded() const {
+        return radial.overlap();
       }
 
       arma::mat TwoDBasis::radial_integral(int Rexp) const {
@@ -161,39 +166,36 @@ namespace helfem {
         // Number of distinct L values is
         size_t N_L(2*arma::max(lval)+1);
         size_t Nel(radial.Nel());
+        // Number of primitive functions in the elements
+        std::vector<size_t> Nprim(Nel);
+        for(size_t iel=0;iel<Nel;iel++)
+          Nprim[iel]=radial.Nprim(iel);
 
         // Compute disjoint integrals
         disjoint_L.resize(Nel*N_L);
         disjoint_m1L.resize(Nel*N_L);
-        for(size_t L=0;L<N_L;L++)
-          for(size_t iel=0;iel<Nel;iel++) {
-            disjoint_L[L*Nel+iel]=radial.radial_integral(L,iel);
-            disjoint_m1L[L*Nel+iel]=radial.radial_integral(-L-1,iel);
-          }
-
-        // Form two-electron integrals
-        prim_tei.resize(Nel*Nel*N_L);
 #ifdef _OPENMP
-#pragma omp parallel for collapse(2)
+#pragma omp parallel for
 #endif
-        for(size_t L=0;L<N_L;L++) {
-          for(size_t iel=0;iel<Nel;iel++) {
-            // In-element integral
-            prim_tei[Nel*Nel*L + iel*Nel + iel]=radial.twoe_integral(L,iel);
+        for(size_t iel=0;iel<Nel;iel++) {
+          // All L values at once
+          std::vector<arma::mat> rL, rm1L;
+          radial.multipole_integrals(N_L-1,iel,rL,rm1L);
+          for(size_t L=0;L<N_L;L++) {
+            disjoint_L[L*Nel+iel]=rL[L];
+            disjoint_m1L[L*Nel+iel]=rm1L[L];
           }
         }
 
-        // Two-electron exchange integrals
-        prim_ktei.resize(Nel*Nel*N_L);
+        // Form in-element two-electron integrals
+        radial.tabulate_twoe(N_L-1);
+        prim_tei=elementtei::ElementTEI(N_L,Nprim);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
 #endif
         for(size_t L=0;L<N_L;L++)
-          for(size_t iel=0;iel<Nel;iel++) {
-            // Diagonal integrals
-            size_t Ni(radial.Nprim(iel));
-            prim_ktei[Nel*Nel*L + iel*Nel + iel]=utils::exchange_tei(prim_tei[Nel*Nel*L + iel*Nel + iel],Ni,Ni,Ni,Ni);
-          }
+          for(size_t iel=0;iel<Nel;iel++)
+            prim_tei.set_block(L,iel,radial.twoe_integral(L,iel));
       }
 
       void TwoDBasis::compute_yukawa(double lambda_) {
@@ -207,11 +209,18 @@ namespace helfem {
         // Compute disjoint integrals
         disjoint_iL.resize(Nel*N_L);
         disjoint_kL.resize(Nel*N_L);
-        for(size_t L=0;L<N_L;L++)
-          for(size_t iel=0;iel<Nel;iel++) {
-            disjoint_iL[L*Nel+iel]=radial.bessel_il_integral(L,lambda,iel);
-            disjoint_kL[L*Nel+iel]=radial.bessel_kl_integral(L,lambda,iel);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for(size_t iel=0;iel<Nel;iel++) {
+          // All L values at once
+          std::vector<arma::mat> iL, kL;
+          radial.bessel_integrals(N_L-1,lambda,iel,iL,kL);
+          for(size_t L=0;L<N_L;L++) {
+            disjoint_iL[L*Nel+iel]=iL[L];
+            disjoint_kL[L*Nel+iel]=kL[L];
           }
+        }
 
         /*
           The exchange matrix is given by
@@ -257,6 +266,9 @@ namespace helfem {
           K(jk) = (jk;il) P(il)
           so we don't have to reform the permutations in the exchange routine.
         */
+        // Tabulate the kernel expansion, shared by all element pairs
+        radial.tabulate_erfc(N_L-1,lambda);
+
         rs_ktei.resize(Nel*Nel*N_L);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
@@ -273,7 +285,7 @@ namespace helfem {
       }
 
       arma::mat TwoDBasis::coulomb(const arma::mat & P) const {
-        if(!prim_tei.size())
+        if(prim_tei.empty())
           throw std::logic_error("Primitive teis have not been computed!\n");
 
         // Number of radial elements
@@ -324,8 +336,8 @@ namespace helfem {
               // Contract integrals
               Psub.reshape(Nj*Nj,1);
 
-              const size_t idx(Nel*Nel*L + iel*Nel + jel);
-              arma::mat Jsub(Lfac*(prim_tei[idx]*Psub));
+              arma::mat Jsub(Ni*Ni,1,arma::fill::zeros);
+              prim_tei.gemv(L,iel,Psub,Lfac,Jsub);
               Jsub.reshape(Ni,Ni);
 
               J.submat(ifirst,ifirst,ilast,ilast)+=Jsub;
@@ -337,7 +349,7 @@ namespace helfem {
       }
 
       arma::cube TwoDBasis::exchange(const arma::cube & P) const {
-        if(!prim_ktei.size())
+        if(prim_tei.empty())
           throw std::logic_error("Primitive teis have not been computed!\n");
 
         // Gaunt coefficient table
@@ -469,7 +481,8 @@ namespace helfem {
 
                     // Exchange submatrix
                     arma::mat Ksub(mem_Ksub[ith].memptr(),Ni*Nj,1,false,true);
-                    Ksub=prim_ktei[Nel*Nel*L + iel*Nel + jel]*arma::vectorise(P_L.submat(ifirst,jfirst,ilast,jlast));
+                    Ksub.zeros();
+                    prim_tei.exchange_gemv(L,iel,arma::vectorise(P_L.submat(ifirst,jfirst,ilast,jlast)),1.0,Ksub);
                     Ksub.reshape(Ni,Nj);
 
                     // Increment global exchange matrix
@@ -673,12 +686,12 @@ namespace helfem {
       }
 
       std::vector<arma::mat> TwoDBasis::get_prim_tei() const {
-        return prim_tei;
+        return prim_tei.get_blocks();
       }
 
       arma::mat TwoDBasis::eval_bf(size_t iel) const {
         // Evaluate radial functions
-        arma::mat rad(radial.get_bf(iel));
+        const arma::mat & rad(radial.get_bf(iel));
 
         // Spherical harmonics contribution
         //rad/=sqrt(4.0*M_PI);
@@ -688,7 +701,7 @@ namespace helfem {
 
       arma::mat TwoDBasis::eval_df(size_t iel) const {
         // Evaluate radial functions
-        arma::mat drad(radial.get_df(iel));
+        const arma::mat & drad(radial.get_df(iel));
 
         // Form supermatrices
         //drad/=sqrt(4.0*M_PI);
@@ -718,11 +731,11 @@ namespace helfem {
         return radial.Nel();
       }
 
-      arma::vec TwoDBasis::get_wrad(size_t iel) const {
+      const arma::vec & TwoDBasis::get_wrad(size_t iel) const {
         return radial.get_wrad(iel);
       }
 
-      arma::vec TwoDBasis::get_r(size_t iel) const {
+      const arma::vec & TwoDBasis::get_r(size_t iel) const {
         return radial.get_r(iel);
       }
 
@@ -837,7 +850,7 @@ namespace helfem {
           radial.get_idx(iel,ifirst,ilast);
           // Density matrix
           arma::mat Csub(C.rows(ifirst,ilast));
-          arma::mat bf(radial.get_bf(iel));
+          const arma::mat & bf(radial.get_bf(iel));
 
           c[iel]=bf*Csub;
         }
@@ -865,7 +878,7 @@ namespace helfem {
           radial.get_idx(iel,ifirst,ilast);
           // Density matrix
           arma::mat Psub(Prad.submat(ifirst,ifirst,ilast,ilast));
-          arma::mat bf(radial.get_bf(iel));
+          const arma::mat & bf(radial.get_bf(iel));
 
           d[iel]=arma::diagvec(bf*Psub*bf.t());
         }
@@ -889,8 +902,8 @@ namespace helfem {
           radial.get_idx(iel,ifirst,ilast);
           // Density matrix
           arma::mat Psub(Prad.submat(ifirst,ifirst,ilast,ilast));
-          arma::mat bf(radial.get_bf(iel));
-          arma::mat df(radial.get_df(iel));
+          const arma::mat & bf(radial.get_bf(iel));
+          const arma::mat & df(radial.get_df(iel));
 
           d[iel]=2.0*arma::diagvec(bf*Psub*df.t());
         }
@@ -918,9 +931,9 @@ namespace helfem {
           radial.get_idx(iel,ifirst,ilast);
           // Density matrix
           arma::mat Psub(Prad.submat(ifirst,ifirst,ilast,ilast));
-          arma::mat bf(radial.get_bf(iel));
-          arma::mat df(radial.get_df(iel));
-          arma::mat lf(radial.get_lf(iel));
+          const arma::mat & bf(radial.get_bf(iel));
+          const arma::mat & df(radial.get_df(iel));
+          const arma::mat & lf(radial.get_lf(iel));
 
           l[iel]=2.0*(arma::diagvec(df*Psub*df.t()) + arma::diagvec(bf*Psub*lf.t()));
         }
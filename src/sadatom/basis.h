@@ -19,6 +19,7 @@
 #include <armadillo>
 #include "polynomial_basis.h"
 #include "../atomic/basis.h"
+#include "../general/elementtei.h"
 
 namespace helfem {
   namespace sadatom {
@@ -46,10 +47,8 @@ namespace helfem {
         std::vector<arma::mat> disjoint_L, disjoint_m1L;
         /// Auxiliary integrals, Yukawa
         std::vector<arma::mat> disjoint_iL, disjoint_kL;
-        /// Primitive two-electron integrals: <Nel^2 * (2L+1)>
-        std::vector<arma::mat> prim_tei;
-        /// Primitive two-electron exchange integrals
-        std::vector<arma::mat> prim_ktei;
+        /// Primitive in-element two-electron integrals: <(2L+1) x Nel>, used for both Coulomb and exchange
+        elementtei::ElementTEI prim_tei;
         /// Primitive two-electron exchange integrals, range separation
         std::vector<arma::mat> rs_ktei;
 
@@ -74,6 +73,8 @@ namespace helfem {
 
         /// Form half-inverse overlap matrix
         arma::mat Sinvh() const;
+        /// Form overlap matrix in banded storage
+        banded::BandedMatrix overlap_banded() const;
         /// Form radial integral
         arma::mat radial_integral(int n) const;
         /// Form overlap matrix
@@ -103,11 +104,11 @@ namespace helfem {
         /// Get number of radial elements
         size_t get_rad_Nel() const;
         /// Get radial quadrature weights
-        arma::vec get_wrad(size_t iel) const;
+        const arma::vec & get_wrad(size_t iel) const;
         /// Get r values
-        arma::vec get_r(size_t iel) const;
+        const arma::vec & get_r(size_t iel) const;
 
-        /// Get primitive integrals
+        /// Get primitive in-element integrals, stored at L*Nel+iel
         std::vector<arma::mat> get_prim_tei() const;
 
         /// Electron density at nucleus
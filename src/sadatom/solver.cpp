@@ -285,12 +285,29 @@ namespace helfem {
         return nsh;
       }
 
-      void OrbitalChannel::UpdateOrbitals(const arma::cube & F, const arma::mat & Sinvh) {
+      /// Is the matrix zero outside the band?
+      static bool within_band(const arma::mat & F, size_t kd) {
+        for(size_t j=0;j<F.n_cols;j++)
+          for(size_t i=j+kd+1;i<F.n_rows;i++)
+            if(F(i,j)!=0.0)
+              return false;
+        return true;
+      }
+
+      /// Solve the radial eigenproblem; local Fock matrices (no exact exchange or level shift) share the band of the overlap and are solved with the banded Cholesky reduction
+      static void radial_eig_gsym(arma::vec & E, arma::mat & C, const arma::mat & F, const arma::mat & Sinvh, const banded::BandedMatrix & Sband) {
+        if(within_band(F,Sband.get_kd()))
+          banded::eig_gsym(E,C,banded::BandedMatrix(F,Sband.get_kd()),Sband);
+        else
+          helfem::scf::eig_gsym(E,C,F,Sinvh);
+      }
+
+      void OrbitalChannel::UpdateOrbitals(const arma::cube & F, const arma::mat & Sinvh, const banded::BandedMatrix & Sband) {
         E.resize(F.n_rows,lmax+1);
         C.resize(F.n_rows,F.n_rows,lmax+1);
         for(int l=0;l<=lmax;l++) {
           arma::vec El;
-          helfem::scf::eig_gsym(El,C.slice(l),F.slice(l),Sinvh);
+          radial_eig_gsym(El,C.slice(l),F.slice(l),Sinvh,Sband);
           E.col(l)=El;
         }
       }
@@ -323,7 +340,7 @@ namespace helfem {
         }
       }
 
-      void OrbitalChannel::UpdateOrbitalsShifted(const arma::cube & F, const arma::mat & Sinvh, const arma::mat & S, double shift) {
+      void OrbitalChannel::UpdateOrbitalsShifted(const arma::cube & F, const arma::mat & Sinvh, const banded::BandedMatrix & Sband, const arma::mat & S, double shift) {
         E.resize(F.n_rows,lmax+1);
         C.resize(F.n_rows,F.n_rows,lmax+1);
         for(int l=0;l<=lmax;l++) {
@@ -344,7 +361,7 @@ namespace helfem {
             E.col(l)=El;
           } else {
             arma::vec El;
-            helfem::scf::eig_gsym(El,C.slice(l),Fl,Sinvh);
+            radial_eig_gsym(El,C.slice(l),Fl,Sinvh,Sband);
             E.col(l)=El;
           }
 
@@ -609,6 +626,8 @@ namespace helfem {
         S=basis.overlap();
         // Get half-inverse
         Sinvh=basis.Sinvh();
+        // and the banded overlap for the radial eigenproblems
+        Sband=basis.overlap_banded();
         // Form kinetic energy matrix
         T=basis.kinetic();
         // Form kinetic energy matrix
@@ -672,7 +691,7 @@ namespace helfem {
 
       void SCFSolver::Initialize(OrbitalChannel & orbs) const {
         orbs.SetLmax(lmax);
-        orbs.UpdateOrbitals(ReplicateCube(H0)+KineticCube(),Sinvh);
+        orbs.UpdateOrbitals(ReplicateCube(H0)+KineticCube(),Sinvh,Sband);
       }
 
       bool is_meta(int x_func, int c_func) {
@@ -982,9 +1001,9 @@ namespace helfem {
           // Update orbitals and density
           if(diiserr > diisthr) {
             // Since ADIIS is unreliable, we also use a level shift.
-            conf.orbs.UpdateOrbitalsShifted(conf.Fl,Sinvh,S,shift);
+            conf.orbs.UpdateOrbitalsShifted(conf.Fl,Sinvh,Sband,S,shift);
           } else {
-            conf.orbs.UpdateOrbitals(conf.Fl,Sinvh);
+            conf.orbs.UpdateOrbitals(conf.Fl,Sinvh,Sband);
           }
 
           if(conf.converged)
@@ -1089,11 +1108,11 @@ namespace helfem {
           // Update orbitals and density
           if(diiserr > diisthr) {
             // Since ADIIS is unreliable, we also use a level shift
-            conf.orbsa.UpdateOrbitalsShifted(conf.Fal,Sinvh,S,shift);
-            conf.orbsb.UpdateOrbitalsShifted(conf.Fbl,Sinvh,S,shift);
+            conf.orbsa.UpdateOrbitalsShifted(conf.Fal,Sinvh,Sband,S,shift);
+            conf.orbsb.UpdateOrbitalsShifted(conf.Fbl,Sinvh,Sband,S,shift);
           } else {
-            conf.orbsa.UpdateOrbitals(conf.Fal,Sinvh);
-            conf.orbsb.UpdateOrbitals(conf.Fbl,Sinvh);
+            conf.orbsa.UpdateOrbitals(conf.Fal,Sinvh,Sband);
+            conf.orbsb.UpdateOrbitals(conf.Fbl,Sinvh,Sband);
           }
           if(conf.converged)
             break;
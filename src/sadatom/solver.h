@@ -18,6 +18,7 @@
 #define SAD_SOLVER_H
 
 #include <armadillo>
+#include <helfem/BandedMatrix.h>
 #include "dftgrid.h"
 #include "../atomic/basis.h"
 #include "../atomic/dftgrid.h"
@@ -101,12 +102,12 @@ namespace helfem {
         /// Checks if the occupations are the same
         bool operator==(const OrbitalChannel & rh) const;
 
-        /// Updates the orbitals by diagonalization
-        void UpdateOrbitals(const arma::cube & Fl, const arma::mat & Sinvh);
+        /// Updates the orbitals by diagonalization; Fock matrices that are banded like the overlap are diagonalized in banded form
+        void UpdateOrbitals(const arma::cube & Fl, const arma::mat & Sinvh, const banded::BandedMatrix & Sband);
         /// Updates the orbitals by a damped diagonalization (ov and vo blocks scaled)
         void UpdateOrbitalsDamped(const arma::cube & Fl, const arma::mat & Sinvh, const arma::mat & S, double dampov);
         /// Updates the orbitals by diagonalization with a level shift
-        void UpdateOrbitalsShifted(const arma::cube & Fl, const arma::mat & Sinvh, const arma::mat & S, double shift);
+        void UpdateOrbitalsShifted(const arma::cube & Fl, const arma::mat & Sinvh, const banded::BandedMatrix & Sband, const arma::mat & S, double shift);
         /// Computes a new density matrix
         void UpdateDensity(arma::cube & Pl) const;
         /// Computes a full atomic density matrix
@@ -200,6 +201,8 @@ namespace helfem {
         arma::mat S;
         /// Half-inverse overlap
         arma::mat Sinvh;
+        /// Overlap matrix in banded storage
+        banded::BandedMatrix Sband;
 
         /// Kinetic energy, l-independent part
         arma::mat T;